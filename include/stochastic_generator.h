@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include <opencv2/opencv.hpp>
+
+enum class StochasticMode {
+    SpherePacking,   // непересекающиеся сферические поры в сплошном теле
+    EllipsoidPores,  // эллипсоидальные поры случайной ориентации
+    FloatingStones,  // полости с висячим камнем внутри
+    FracturedSlabs   // тело, разрезанное наклонными трещинами на плиты
+};
+
+bool parseStochasticMode(const std::string& text, StochasticMode& mode);
+const char* stochasticModeName(StochasticMode mode);
+
+struct StochasticOptions {
+    StochasticMode mode = StochasticMode::SpherePacking;
+    int depth = 128, height = 128, width = 128;
+    uint64_t seed = 1;
+    double density = 0.2;       // доля объёма, занятая порами (полостями)
+    double min_radius = 2.0;    // полуоси пор и радиусы полостей
+    double max_radius = 6.0;
+    int fractures = 3;          // число трещин для FracturedSlabs
+    int fracture_thickness = 2;
+};
+
+// Точные метрики объёма для связности тела 6 и пор 26 (параметры анализатора по умолчанию)
+struct GroundTruth {
+    bool connected = true;
+    uint64_t pore_voxels = 0;
+    double porosity = 0.0;
+    int internal_pores = 0;
+    int floating_parts = 0; // висячие тела не меньше 10 вокселей
+    size_t objects = 0;
+    double seconds = 0.0;
+};
+
+struct StochasticVolume {
+    std::vector<cv::Mat> slices;
+    GroundTruth truth;
+};
+
+/**
+ * @brief Генерирует случайный объём с заранее известными метриками
+ *
+ * Результат полностью определяется зерном: объём делится на ячейки, у каждой
+ * ячейки свой генератор случайных чисел, и ячейки одного цвета шахматной
+ * раскраски заполняются параллельно. Поры не касаются друг друга (даже по
+ * 26-соседству) и границы объёма, поэтому метрики складываются из метрик
+ * отдельных объектов, которые считаются при генерации по их вокселям.
+ * Срезы растеризуются параллельно.
+ *
+ * @throw std::invalid_argument при некорректных параметрах
+ */
+StochasticVolume generateStochasticVolume(const StochasticOptions& options);
+
+nlohmann::json groundTruthToJson(const GroundTruth& truth, const StochasticOptions& options);
@@ -0,0 +1,358 @@
+#include "analysis_pipeline.h"
+#include "analysis_progress.h"
+#include "connectivity_checker.h"
+#include "island_tracker.h"
+#include "project_paths.h"
+#include "result_cache.h"
+#include "scratch_arena.h"
+#include "task_graph.h"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Объёмов, одновременно находящихся в анализе, и загруженных объёмов в очереди
+constexpr size_t kSamplesInFlight = 2;
+constexpr size_t kLoadedQueueCapacity = 2;
+
+struct Sample {
+    std::string folder;
+    std::string name;
+    std::string cache_key;
+    std::vector<cv::Mat> slices;
+    BrickVolume bricks; // вместо slices при --bricks
+    bool load_failed = false;
+    bool from_cache = false;
+    double load_seconds = 0.0;
+
+    // Результаты этапов; каждое поле пишет один этап, читают только зависящие от него
+    CachedMetrics metrics;
+    size_t islands_2d = 0;
+    cv::Mat collage;
+};
+
+struct SampleRun {
+    std::shared_ptr<Sample> sample;
+    TaskGraph graph;
+};
+
+// Общие для всех наборов отмена и печать прогресса
+struct PipelineControl {
+    CancellationToken token;
+    std::unique_ptr<ProgressPrinter> printer; // только с --progress
+
+    AnalysisControl forSample(const std::string& name) const {
+        AnalysisControl control;
+        control.token = &token;
+        if (printer) control.progress = printer->callback(name);
+        return control;
+    }
+
+    void event(const std::string& name, const std::string& what, const std::string& detail = "") const {
+        if (printer) printer->event(name, what, detail);
+    }
+};
+
+std::string resultCacheKey(const AnalyzerOptions& options, const std::string& folder) {
+    uint64_t stack_hash = 0;
+    std::vector<std::string> stack_files = listStackFiles(folder);
+    if (options.no_cache || stack_files.empty() || !hashSliceStack(stack_files, stack_hash)) {
+        return {};
+    }
+    std::string parameters = "body=" + std::to_string(options.body_value) +
+                             ";connectivity=" + std::to_string(static_cast<int>(options.connectivity)) +
+                             ";pore_connectivity=" + std::to_string(static_cast<int>(options.pore_connectivity)) +
+                             ";threshold=" + std::to_string(static_cast<int>(options.load.threshold_mode)) +
+                             ":" + std::to_string(options.load.threshold) +
+                             ";min_voxels=" + std::to_string(kFloatingMinVoxels) + ";min_area=30";
+    return makeResultCacheKey(stack_hash, parameters);
+}
+
+// Этап загрузки: неизменённый набор данных с теми же параметрами не анализируется повторно
+std::shared_ptr<Sample> loadSample(const AnalyzerOptions& options, const std::string& folder) {
+    auto sample = std::make_shared<Sample>();
+    sample->folder = folder;
+    sample->name = fs::path(folder).filename().string();
+    sample->cache_key = resultCacheKey(options, folder);
+
+    if (!sample->cache_key.empty() && lookupCachedResult(sample->name, sample->cache_key, sample->metrics)) {
+        sample->from_cache = true;
+        return sample;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (options.bricks) {
+        sample->bricks = loadStackBricked(folder, options.load);
+        sample->load_failed = sample->bricks.depth == 0;
+    } else {
+        sample->slices = loadStack(folder, options.load);
+        sample->load_failed = sample->slices.empty();
+    }
+    sample->load_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return sample;
+}
+
+// Этапы проверяют отмену до начала работы: после отмены оставшиеся этапы завершаются сразу.
+// Без record граф не строит коллаж и не пишет в хранилище и кэш результатов
+void buildSampleGraph(const AnalyzerOptions& options, const std::string& project_root,
+                      const AnalysisControl& control, int min_voxels, bool record, SampleRun& run) {
+    std::shared_ptr<Sample> sample = run.sample;
+    const uchar body_value = options.body_value;
+    const Connectivity connectivity = options.connectivity;
+    const Connectivity pore_connectivity = options.pore_connectivity;
+    TaskGraph& graph = run.graph;
+
+    const bool bricked = options.bricks;
+
+    size_t connected = graph.add("связность", [sample, body_value, connectivity, control, bricked](std::ostream& log) {
+        control.check();
+        log << "\nПроверка 3D-связности объекта (" << static_cast<int>(connectivity) << "-связность):" << std::endl;
+        sample->metrics.connected = bricked ? is3DConnected(sample->bricks, body_value, connectivity, control)
+                                            : is3DConnected(sample->slices, body_value, connectivity, control);
+        log << "Объём " << (sample->metrics.connected ? "является" : "НЕ является") << " связным (3D)." << std::endl;
+    });
+
+    size_t porosity = graph.add("пористость", [sample, body_value, pore_connectivity, control,
+                                               bricked](std::ostream& log) {
+        control.check();
+        log << "\nАнализ пористости (" << static_cast<int>(pore_connectivity) << "-связность пор):" << std::endl;
+        sample->metrics.stats = bricked ? computePorosityStats(sample->bricks, body_value, pore_connectivity, control)
+                                        : computePorosityStats(sample->slices, body_value, pore_connectivity, control);
+        log << "Пористость: " << sample->metrics.stats.porosity * 100 << "%\n";
+        log << "Количество внутренних пор: " << sample->metrics.stats.pore_count << std::endl;
+    });
+
+    // Коллаж и острова строятся по срезам, которых в кирпичной раскладке нет
+    if (!bricked && record) {
+        size_t collage = graph.add("коллаж", [sample, control](std::ostream& log) {
+            control.check();
+            log << "\nСохранение визуализации пор..." << std::endl;
+            sample->collage = renderCollageWithContours(sample->slices, sample->name, control);
+        });
+
+        graph.add("запись коллажа", [sample, project_root](std::ostream& log) {
+            std::string path = saveCollageWithContours(sample->collage, sample->name, project_root);
+            log << "\nКоллаж с границами сохранён в: " << path << std::endl;
+            sample->collage.release();
+        }, {collage});
+    }
+
+    if (!bricked) {
+        const int island_connectivity = options.island_connectivity;
+        graph.add("висячие 2D", [sample, body_value, island_connectivity, control, record](std::ostream& log) {
+            control.check();
+            log << "\nПоиск висячих компонентов на 2D-срезах:" << std::endl;
+            IslandAnalysis islands = analyzeIslands2D(sample->slices, body_value, 30, island_connectivity, control);
+            size_t longest = 0;
+            for (const auto& track : islands.tracks) {
+                longest = std::max(longest, track.areas.size());
+            }
+            log << "Островов на срезах: " << islands.islandCount()
+                << ", из них меньше " << islands.min_area << " пикселей: " << islands.smallIslandCount()
+                << ", треков: " << islands.tracks.size() << ", самый длинный: " << longest << " срезов" << std::endl;
+            sample->islands_2d = islands.islandCount();
+            if (record) {
+                saveResultSection(sample->name, "islands_2d", islandAnalysisToJson(islands));
+            }
+        });
+    }
+
+    size_t floating = graph.add("висячие 3D", [sample, body_value, connectivity, control, min_voxels,
+                                               bricked](std::ostream& log) {
+        control.check();
+        log << "\nПоиск висячих компонентов в 3D:" << std::endl;
+        sample->metrics.floating_3d_count =
+                bricked ? countFloatingComponents(labelComponents3D(sample->bricks, body_value, connectivity, control),
+                                                  min_voxels, true, log)
+                        : detectFloatingIslands3D(sample->slices, body_value, min_voxels, connectivity, log, control);
+    });
+
+    if (!record) return;
+    graph.add("сравнение с эталоном", [sample](std::ostream& log) {
+        compareWithReferenceMetrics(sample->name, sample->metrics.connected, sample->metrics.stats,
+                                    sample->metrics.floating_3d_count, log);
+        if (!sample->cache_key.empty()) {
+            storeCachedResult(sample->name, sample->cache_key, sample->metrics);
+        }
+    }, {connected, porosity, floating});
+}
+
+void printCachedSample(const Sample& sample) {
+    const CachedMetrics& cached = sample.metrics;
+    std::cout << "Срезы и параметры не изменились — результаты взяты из кэша (ключ " << sample.cache_key << ")"
+              << std::endl;
+    std::cout << "Объём " << (cached.connected ? "является" : "НЕ является") << " связным (3D)." << std::endl;
+    std::cout << "Пористость: " << cached.stats.porosity * 100 << "%\n";
+    std::cout << "Количество внутренних пор: " << cached.stats.pore_count << std::endl;
+    std::cout << "Висячих тел в 3D: " << cached.floating_3d_count << std::endl;
+}
+
+void printSampleProfile(const SampleRun& run) {
+    std::cout << "\nПрофиль:" << std::endl;
+    std::cout << "  загрузка: " << run.sample->load_seconds * 1000 << " мс" << std::endl;
+    for (const auto& [stage, seconds] : run.graph.timings()) {
+        std::cout << "  " << stage << ": " << seconds * 1000 << " мс" << std::endl;
+    }
+    // Этапы выполняются одновременно, поэтому сумма времён больше общего
+    std::cout << "  анализ (с перекрытием этапов): " << run.graph.seconds() * 1000 << " мс" << std::endl;
+}
+
+} // namespace
+
+SampleMetrics analyzeLoadedVolume(const AnalyzerOptions& options, std::vector<cv::Mat> slices, BrickVolume bricks,
+                                  int min_voxels, TaskScheduler& scheduler) {
+    SampleRun run;
+    run.sample = std::make_shared<Sample>();
+    run.sample->slices = std::move(slices);
+    run.sample->bricks = std::move(bricks);
+    buildSampleGraph(options, projectRoot(), AnalysisControl{}, min_voxels, false, run);
+    run.graph.start(scheduler);
+    run.graph.wait();
+    if (run.graph.failed()) {
+        std::ostringstream logs;
+        run.graph.printLogs(logs);
+        throw std::runtime_error("этап анализа завершился ошибкой:\n" + logs.str());
+    }
+
+    SampleMetrics metrics;
+    metrics.connected = run.sample->metrics.connected;
+    metrics.stats = run.sample->metrics.stats;
+    metrics.floating_3d_count = run.sample->metrics.floating_3d_count;
+    metrics.islands_2d = run.sample->islands_2d;
+    return metrics;
+}
+
+std::vector<std::string> listBatchDatasets(const std::string& root) {
+    std::vector<std::string> datasets;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(root, ec)) {
+        std::string path = entry.path().string();
+        std::string ext = entry.path().extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        bool is_tiff = entry.is_regular_file(ec) && (ext == ".tif" || ext == ".tiff");
+        if (is_tiff || (entry.is_directory(ec) && !listSliceFiles(path).empty())) {
+            datasets.push_back(path);
+        }
+    }
+    std::sort(datasets.begin(), datasets.end());
+    return datasets;
+}
+
+int runAnalysisPipeline(const AnalyzerOptions& options) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::string> folders;
+    if (options.batch) {
+        folders = listBatchDatasets(options.folder);
+        if (folders.empty()) {
+            std::cerr << "В папке " << options.folder << " нет наборов срезов." << std::endl;
+            return 1;
+        }
+        std::cout << "Пакетный анализ: " << folders.size() << " наборов" << std::endl;
+    } else {
+        folders.push_back(options.folder);
+    }
+
+    const std::string& project_root = projectRoot();
+    PipelineControl control;
+    control.token.setBudget(options.time_budget);
+    if (options.progress) control.printer = std::make_unique<ProgressPrinter>(std::cout);
+    installInterruptHandler();
+    TaskScheduler scheduler(options.jobs);
+
+    // Загрузка идёт впереди анализа, но не дальше, чем позволяет очередь; после отмены новые наборы не загружаются
+    BoundedQueue<std::shared_ptr<Sample>> loaded(kLoadedQueueCapacity);
+    std::thread loader([&] {
+        for (const auto& folder : folders) {
+            if (control.token.cancelled()) break;
+            control.event(fs::path(folder).filename().string(), "loading");
+            if (!loaded.push(loadSample(options, folder))) break;
+        }
+        loaded.close();
+    });
+
+    std::deque<std::unique_ptr<SampleRun>> running;
+    size_t analyzed = 0, cached = 0, failed = 0;
+
+    // Наборы завершаются по порядку поступления, так что вывод идёт в порядке папок
+    auto finishFront = [&] {
+        SampleRun& run = *running.front();
+        run.graph.wait();
+        const Sample& sample = *run.sample;
+        if (options.batch) {
+            std::cout << "\n=== " << sample.name << " ===" << std::endl;
+        }
+
+        if (sample.load_failed) {
+            std::cerr << "Не удалось загрузить слайсы из папки: " << sample.folder << std::endl;
+            control.event(sample.name, "failed", "загрузка");
+            failed++;
+        } else if (sample.from_cache) {
+            printCachedSample(sample);
+            control.event(sample.name, "done", "кэш");
+            cached++;
+        } else {
+            run.graph.printLogs(std::cout);
+            if (run.graph.failed()) {
+                failed++;
+                control.event(sample.name, control.token.cancelled() ? "cancelled" : "failed",
+                              control.token.reason());
+            } else {
+                analyzed++;
+                control.event(sample.name, "done");
+            }
+            if (options.profile) {
+                printSampleProfile(run);
+            }
+        }
+        running.pop_front();
+    };
+
+    std::shared_ptr<Sample> sample;
+    while (loaded.pop(sample)) {
+        auto run = std::make_unique<SampleRun>();
+        run->sample = std::move(sample);
+        if (!run->sample->load_failed && !run->sample->from_cache) {
+            buildSampleGraph(options, project_root, control.forSample(run->sample->name), kFloatingMinVoxels, true,
+                             *run);
+        }
+        run->graph.start(scheduler);
+        running.push_back(std::move(run));
+
+        while (running.size() > kSamplesInFlight) {
+            finishFront();
+        }
+    }
+    while (!running.empty()) {
+        finishFront();
+    }
+    loader.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (options.batch) {
+        std::cout << "\nНаборов проанализировано: " << analyzed << ", из кэша: " << cached
+                  << ", с ошибками: " << failed << ", потоков: " << scheduler.threads()
+                  << ", время: " << seconds << " с" << std::endl;
+    }
+    if (options.profile) {
+        printArenaStats(std::cout, ScratchArena::aggregateStats());
+    }
+    if (control.token.cancelled()) {
+        std::cout << "\nАнализ прерван: " << control.token.reason() << ". Наборов не проанализировано: "
+                  << folders.size() - analyzed - cached << std::endl;
+        return 1;
+    }
+    if (failed == 0) {
+        std::cout << "\nАнализ завершён." << std::endl;
+    }
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,52 @@
+#ifndef ANALYSIS_PIPELINE_H
+#define ANALYSIS_PIPELINE_H
+
+#include "analyzer_options.h"
+#include "brick_volume.h"
+#include "connectivity_checker.h"
+#include "task_graph.h"
+#include <string>
+#include <vector>
+
+/**
+ * @brief Стандартный анализ набора данных (или всех наборов папки в режиме --batch)
+ *
+ * Загрузка выполняется отдельным потоком и передаёт объёмы анализу через
+ * ограниченную очередь. Для каждого набора строится граф этапов (связность,
+ * пористость, коллаж и его запись, висячие компоненты, сравнение с эталоном),
+ * независимые этапы выполняются одновременно в общем пуле потоков, а этапы
+ * разных наборов пакета перекрываются. Вывод этапов собирается в журналы и
+ * печатается по наборам в исходном порядке.
+ *
+ * С --progress этапы печатают прогресс строками JSON по мере работы. По SIGINT
+ * или по истечении --time-budget этапы останавливаются, результаты
+ * завершённых этапов выводятся, а новые наборы не загружаются.
+ *
+ * @return Код завершения процесса
+ */
+int runAnalysisPipeline(const AnalyzerOptions& options);
+
+// Метрики этапов анализа одного объёма
+struct SampleMetrics {
+    bool connected = false;
+    PorosityStats stats{0.0, 0};
+    int floating_3d_count = 0;
+    size_t islands_2d = 0; // островов на срезах; 0 для кирпичной раскладки, где этапа нет
+};
+
+/**
+ * @brief Граф этапов runAnalysisPipeline для уже загруженного объёма
+ *
+ * Те же этапы (связность, пористость, висячие компоненты в 3D и острова на
+ * срезах) с теми же параметрами, но без коллажа, без записи в хранилище и кэш
+ * результатов и без вывода; используется volume_regress. С options.bricks
+ * 3D-этапы идут по bricks, а острова на срезах не ищутся.
+ * @throws std::runtime_error если этап завершился ошибкой
+ */
+SampleMetrics analyzeLoadedVolume(const AnalyzerOptions& options, std::vector<cv::Mat> slices, BrickVolume bricks,
+                                  int min_voxels, TaskScheduler& scheduler);
+
+// Наборы данных папки для --batch: подпапки со срезами и многостраничные TIFF, по имени
+std::vector<std::string> listBatchDatasets(const std::string& root);
+
+#endif
@@ -0,0 +1,87 @@
+#include "analysis_progress.h"
+#include <csignal>
+#include <nlohmann/json.hpp>
+
+namespace {
+
+volatile std::sig_atomic_t g_interrupted = 0;
+
+extern "C" void onInterrupt(int) {
+    g_interrupted = 1;
+}
+
+} // namespace
+
+void CancellationToken::setBudget(double seconds) {
+    has_deadline_ = seconds > 0.0;
+    if (has_deadline_) {
+        deadline_ = std::chrono::steady_clock::now() +
+                    std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                            std::chrono::duration<double>(seconds));
+    }
+}
+
+bool CancellationToken::cancelled() const {
+    return cancelled_ || interruptRequested() ||
+           (has_deadline_ && std::chrono::steady_clock::now() >= deadline_);
+}
+
+std::string CancellationToken::reason() const {
+    if (interruptRequested()) return "получен SIGINT";
+    if (has_deadline_ && std::chrono::steady_clock::now() >= deadline_) return "исчерпан бюджет времени";
+    if (cancelled_) return "отменено";
+    return {};
+}
+
+void installInterruptHandler() {
+    struct sigaction action {};
+    action.sa_handler = onInterrupt;
+    sigemptyset(&action.sa_mask);
+    // После первого сигнала восстанавливается обработчик по умолчанию
+    action.sa_flags = SA_RESETHAND;
+    sigaction(SIGINT, &action, nullptr);
+}
+
+bool interruptRequested() {
+    return g_interrupted != 0;
+}
+
+ProgressCallback ProgressPrinter::callback(const std::string& dataset) {
+    return [this, dataset](const ProgressUpdate& update) { print(dataset, update); };
+}
+
+void ProgressPrinter::print(const std::string& dataset, const ProgressUpdate& update) {
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& last = last_[dataset + '\n' + update.stage];
+    bool final = update.slices_done >= update.slices_total;
+    if (!final && last.time_since_epoch().count() != 0 &&
+        std::chrono::duration<double>(now - last).count() < interval_) {
+        return;
+    }
+    last = now;
+
+    nlohmann::json line = {
+            {"event", "progress"},
+            {"dataset", dataset},
+            {"stage", update.stage},
+            {"slices_done", update.slices_done},
+            {"slices_total", update.slices_total},
+            {"elapsed", std::chrono::duration<double>(now - started_).count()}
+    };
+    if (update.components >= 0) line["components"] = update.components;
+    if (update.porosity >= 0.0) line["porosity"] = update.porosity;
+    out_ << line.dump() << std::endl;
+}
+
+void ProgressPrinter::event(const std::string& dataset, const std::string& name, const std::string& detail) {
+    auto now = std::chrono::steady_clock::now();
+    nlohmann::json line = {
+            {"event", name},
+            {"dataset", dataset},
+            {"elapsed", std::chrono::duration<double>(now - started_).count()}
+    };
+    if (!detail.empty()) line["detail"] = detail;
+    std::lock_guard<std::mutex> lock(mutex_);
+    out_ << line.dump() << std::endl;
+}
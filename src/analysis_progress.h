@@ -0,0 +1,106 @@
+#ifndef ANALYSIS_PROGRESS_H
+#define ANALYSIS_PROGRESS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+// Промежуточное состояние этапа; поля, не относящиеся к этапу, остаются -1
+struct ProgressUpdate {
+    std::string stage;
+    int slices_done = 0;
+    int slices_total = 0;
+    long long components = -1;   // найдено компонент (пор, тел, островов) к этому моменту
+    double porosity = -1.0;      // пористость просмотренных срезов
+};
+
+using ProgressCallback = std::function<void(const ProgressUpdate&)>;
+
+// Исключение, которым этап прекращает работу при отмене
+class AnalysisCancelled : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+/**
+ * @brief Кооперативная отмена анализа
+ *
+ * Отмена срабатывает по cancel(), по истечении бюджета времени или по SIGINT,
+ * если установлен installInterruptHandler. Этапы проверяют её между срезами
+ * и внутри длинных обходов, поэтому останавливаются за доли секунды.
+ */
+class CancellationToken {
+public:
+    void cancel() { cancelled_ = true; }
+
+    // Бюджет времени от текущего момента; seconds <= 0 — без ограничения
+    void setBudget(double seconds);
+
+    bool cancelled() const;
+
+    // Причина отмены для сообщений; пустая строка, если отмены не было
+    std::string reason() const;
+
+private:
+    std::atomic<bool> cancelled_{false};
+    bool has_deadline_ = false;
+    std::chrono::steady_clock::time_point deadline_;
+};
+
+// Первый SIGINT запрашивает отмену, второй завершает процесс как обычно
+void installInterruptHandler();
+bool interruptRequested();
+
+/**
+ * @brief Отмена и прогресс, передаваемые в вычислительные ядра
+ *
+ * Пустой AnalysisControl ничего не проверяет и не сообщает.
+ */
+struct AnalysisControl {
+    const CancellationToken* token = nullptr;
+    ProgressCallback progress;
+
+    // Бросает AnalysisCancelled, если анализ отменён
+    void check() const {
+        if (token && token->cancelled()) throw AnalysisCancelled("анализ прерван: " + token->reason());
+    }
+
+    void report(const ProgressUpdate& update) const {
+        check();
+        if (progress) progress(update);
+    }
+};
+
+/**
+ * @brief Печатает прогресс строками JSON
+ *
+ * Сообщения одного этапа набора выводятся не чаще раза в interval секунд,
+ * кроме последнего (slices_done == slices_total). Вызывается из любых потоков.
+ */
+class ProgressPrinter {
+public:
+    explicit ProgressPrinter(std::ostream& out, double interval = 0.25) : out_(out), interval_(interval) {}
+
+    // Обратный вызов для этапов набора dataset
+    ProgressCallback callback(const std::string& dataset);
+
+    // Событие без прогресса: начало и конец набора, отмена
+    void event(const std::string& dataset, const std::string& name, const std::string& detail = "");
+
+private:
+    void print(const std::string& dataset, const ProgressUpdate& update);
+
+    std::ostream& out_;
+    double interval_;
+    std::chrono::steady_clock::time_point started_ = std::chrono::steady_clock::now();
+    std::map<std::string, std::chrono::steady_clock::time_point> last_;
+    std::mutex mutex_;
+};
+
+#endif
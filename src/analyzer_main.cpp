@@ -1,52 +1,676 @@
+#include "analysis_pipeline.h"
+#include "analyzer_options.h"
+#include "analyzer_service.h"
 #include "connectivity_checker.h"
+#include "label_volume.h"
+#include "local_porosity.h"
+#include "phase_analysis.h"
+#include "pore_network.h"
+#include "project_paths.h"
+#include "result_cache.h"
+#include "results_store.h"
+#include "scratch_arena.h"
+#include "slice_graph.h"
+#include "support_analysis.h"
+#include "surface_mesher.h"
+#include "volume_diff.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <iostream>
 #include <filesystem>
+#include <sstream>
 
-int main(int argc, char** argv) {
-    if (argc < 2) {
-        std::cerr << "Ошибка: укажите путь к папке со слайсами." << std::endl;
-        std::cerr << "Пример использования: " << argv[0] << " ./slices_folder" << std::endl;
+// Время этапов анализа для --profile
+class StageProfile {
+public:
+    explicit StageProfile(bool enabled) : enabled_(enabled), last_(std::chrono::steady_clock::now()) {}
+
+    void mark(const std::string& stage) {
+        auto now = std::chrono::steady_clock::now();
+        if (enabled_) stages_.emplace_back(stage, std::chrono::duration<double>(now - last_).count());
+        last_ = now;
+    }
+
+    void print() const {
+        if (!enabled_) return;
+        std::cout << "\nПрофиль:" << std::endl;
+        for (const auto& [stage, seconds] : stages_) {
+            std::cout << "  " << stage << ": " << seconds * 1000 << " мс" << std::endl;
+        }
+        printArenaStats(std::cout, ScratchArena::aggregateStats());
+    }
+
+private:
+    bool enabled_;
+    std::chrono::steady_clock::time_point last_;
+    std::vector<std::pair<std::string, double>> stages_;
+};
+
+// Ключ уровней пирамиды: содержимое срезов и параметры загрузки и свёртки; пустой, если срезы не прочитать
+static std::string pyramidKey(const AnalyzerOptions& options) {
+    uint64_t stack_hash = 0;
+    std::vector<std::string> files = listStackFiles(options.folder);
+    if (files.empty() || !hashSliceStack(files, stack_hash)) return "";
+    return makeResultCacheKey(stack_hash,
+                              "pyramid;body=" + std::to_string(options.body_value) +
+                              ";threshold=" + std::to_string(static_cast<int>(options.load.threshold_mode)) +
+                              ":" + std::to_string(options.load.threshold) +
+                              ";reduction=" + reductionRuleName(options.reduction));
+}
+
+// Быстрый приблизительный анализ на уменьшенном уровне пирамиды
+static int runPreview(const AnalyzerOptions& options) {
+    const std::string& folder = options.folder;
+    const int level = options.preview_level;
+    const int factor = 1 << level;
+    auto start = std::chrono::steady_clock::now();
+
+    // Сохранённый уровень читается напрямую, без загрузки полного разрешения, если он
+    // построен по тем же срезам с теми же параметрами; иначе он строится заново
+    std::vector<cv::Mat> slices;
+    const std::string key = pyramidKey(options);
+    if (pyramidLevelIsCurrent(folder, level, options.reduction, key)) {
+        slices = loadSlices(pyramidLevelFolder(folder, level, options.reduction));
+    }
+
+    if (slices.empty()) {
+        auto full = loadStack(folder, options.load);
+        if (full.empty()) {
+            std::cerr << "Не удалось загрузить слайсы из папки: " << folder << std::endl;
+            return 1;
+        }
+        auto pyramid = buildVolumePyramid(full, level, options.body_value, options.reduction);
+        if (options.save_pyramid) {
+            bool saved = true;
+            for (int l = 1; l <= level && saved; ++l) {
+                saved = savePyramidLevel(pyramid[l - 1], folder, l, options.reduction, key);
+            }
+            if (saved) {
+                std::cout << "Пирамида сохранена в: " << pyramidLevelFolder(folder, level, options.reduction)
+                          << std::endl;
+            } else {
+                std::cerr << "⚠️ Пирамида не сохранена, предпросмотр продолжается по построенному уровню" << std::endl;
+            }
+        }
+        slices = std::move(pyramid[level - 1]);
+    }
+
+    const int min_voxels = std::max(1, kFloatingMinVoxels / (factor * factor * factor));
+    bool connected = is3DConnected(slices, options.body_value, options.connectivity);
+    PorosityStats stats = computePorosityStats(slices, options.body_value, options.pore_connectivity);
+    int floating_3d_count = detectFloatingIslands3D(slices, options.body_value, min_voxels, options.connectivity);
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "\n⚠️ ПРИБЛИЗИТЕЛЬНЫЕ результаты: уровень " << level << " (1:" << factor
+              << ", свёртка " << reductionRuleName(options.reduction) << ")" << std::endl;
+    std::cout << "≈ Связность: " << (connected ? "да" : "нет") << std::endl;
+    std::cout << "≈ Пористость: " << stats.porosity * 100 << "%" << std::endl;
+    std::cout << "≈ Внутренних пор: " << stats.pore_count << std::endl;
+    std::cout << "≈ Висячих тел: " << floating_3d_count << std::endl;
+    std::cout << "Время предпросмотра: " << elapsed << " с" << std::endl;
+
+    std::string folder_name = std::filesystem::path(folder).filename().string();
+    saveResultSection(folder_name, "preview", {
+            {"approximate", true},
+            {"level", level},
+            {"scale", factor},
+            {"reduction", reductionRuleName(options.reduction)},
+            {"connected", connected},
+            {"porosity", stats.porosity},
+            {"internal_pores", stats.pore_count},
+            {"floating_parts", floating_3d_count},
+            {"seconds", elapsed}
+    });
+    return 0;
+}
+
+static bool parseVoxel(const std::string& text, cv::Point3i& point) {
+    return std::sscanf(text.c_str(), "%d,%d,%d", &point.z, &point.y, &point.x) == 3;
+}
+
+// Делит запрос --query на части по ':'; пустой запрос некорректен
+static bool splitQuery(const std::string& query, std::vector<std::string>& parts) {
+    parts.clear();
+    std::stringstream stream(query);
+    for (std::string part; std::getline(stream, part, ':');) parts.push_back(part);
+    return !parts.empty() && !parts[0].empty();
+}
+
+// Ответы на запросы по индексу компонент срезов без обхода вокселей
+static int runGraphQueries(const AnalyzerOptions& options) {
+    SliceGraph graph;
+    if (!loadOrBuildSliceGraph(options.folder, options.load, options.body_value, options.connectivity, graph)) {
+        std::cerr << "Не удалось загрузить слайсы из папки: " << options.folder << std::endl;
         return 1;
     }
 
-    std::string folder = argv[1];
-    auto slices = loadSlices(folder);
+    for (const std::string& query : options.queries) {
+        std::vector<std::string> parts;
+        std::cout << query << " → ";
+        if (!splitQuery(query, parts)) {
+            std::cout << "некорректный запрос" << std::endl;
+            continue;
+        }
+        const std::string& kind = parts[0];
+        cv::Point3i from, to;
+        if (kind == "connected" && parts.size() == 1) {
+            std::cout << (sliceGraphIsConnected(graph) ? "да" : "нет") << std::endl;
+        } else if (kind == "floating" && parts.size() <= 2) {
+            int min_voxels = parts.size() == 2 ? std::atoi(parts[1].c_str()) : kFloatingMinVoxels;
+            std::cout << sliceGraphFloatingCount(graph, min_voxels) << std::endl;
+        } else if (kind == "slices" && parts.size() == 3) {
+            bool linked = sliceGraphSlicesConnected(graph, std::atoi(parts[1].c_str()), std::atoi(parts[2].c_str()));
+            std::cout << (linked ? "да" : "нет") << std::endl;
+        } else if (kind == "attached" && parts.size() == 2 && parseVoxel(parts[1], from)) {
+            std::cout << (sliceGraphAttachedToBase(graph, from.z, from.y, from.x) ? "да" : "нет") << std::endl;
+        } else if (kind == "reach" && parts.size() == 3 && parseVoxel(parts[1], from) && parseVoxel(parts[2], to)) {
+            std::cout << (sliceGraphReachable(graph, from, to) ? "да" : "нет") << std::endl;
+        } else {
+            std::cout << "некорректный запрос" << std::endl;
+        }
+    }
+    return 0;
+}
+
+static const char* componentKindName(ComponentKind kind) {
+    return kind == ComponentKind::Body ? "тело" : "пора";
+}
+
+// Запросы к сохранённому объёму меток: повторная разметка не нужна
+static int runLabelQueries(const AnalyzerOptions& options) {
+    LabelVolume labels;
+    if (!loadLabelVolume(options.labels_file, labels)) {
+        return 1;
+    }
+
+    for (const std::string& query : options.queries) {
+        std::vector<std::string> parts;
+        std::cout << query << " → ";
+        if (!splitQuery(query, parts)) {
+            std::cout << "некорректный запрос" << std::endl;
+            continue;
+        }
+        const std::string& kind = parts[0];
+        cv::Point3i from, to;
+        if (kind == "at" && parts.size() == 2 && parseVoxel(parts[1], from)) {
+            uint32_t id = labelAt(labels, from);
+            if (id == 0) {
+                std::cout << "вне объёма" << std::endl;
+                continue;
+            }
+            const LabelComponent& component = labels.components[id - 1];
+            std::cout << "компонента " << id << " (" << componentKindName(component.kind)
+                      << ", " << component.voxels << " вокселей)" << std::endl;
+        } else if (kind == "box" && parts.size() == 3 && parseVoxel(parts[1], from) && parseVoxel(parts[2], to)) {
+            std::vector<uint32_t> ids = componentsInBox(labels, {from, to});
+            std::cout << ids.size() << " компонент:";
+            for (uint32_t id : ids) {
+                std::cout << " " << id << " (" << componentKindName(labels.components[id - 1].kind) << ")";
+            }
+            std::cout << std::endl;
+        } else if (kind == "nearest-pore" && parts.size() == 2 && parseVoxel(parts[1], from)) {
+            uint32_t pore = 0;
+            double distance = 0.0;
+            if (nearestPore(labels, from, pore, to, distance)) {
+                std::cout << "пора " << pore << ", воксель " << to.z << "," << to.y << "," << to.x
+                          << ", расстояние " << distance << std::endl;
+            } else {
+                std::cout << "внутренних пор нет" << std::endl;
+            }
+        } else {
+            std::cout << "некорректный запрос" << std::endl;
+        }
+    }
+    return 0;
+}
+
+// Разметка компонент тела и пор и сохранение объёма меток
+static int runLabelExport(const AnalyzerOptions& options) {
+    auto slices = loadStack(options.folder, options.load);
     if (slices.empty()) {
-        std::cerr << "Не удалось загрузить слайсы из папки: " << folder << std::endl;
+        std::cerr << "Не удалось загрузить слайсы из папки: " << options.folder << std::endl;
         return 1;
     }
 
-    uchar body_value = 255;
+    LabelVolume labels = labelVolume(slices, options.body_value, options.connectivity, options.pore_connectivity);
+    if (!saveLabelVolume(labels, options.export_labels, options.compress_labels)) {
+        return 1;
+    }
+
+    size_t bodies = std::count_if(labels.components.begin(), labels.components.end(),
+                                  [](const LabelComponent& c) { return c.kind == ComponentKind::Body; });
+    std::cout << "Метки сохранены в: " << options.export_labels << " (компонент тела: " << bodies
+              << ", пор: " << labels.components.size() - bodies << ", размер файла: "
+              << std::filesystem::file_size(options.export_labels) / 1024 << " КБ)" << std::endl;
+    return 0;
+}
+
+// Метки компонент для сетки: числа через запятую, floating — висячие тела, internal-pores — внутренние поры.
+// Нераспознанный элемент списка или метка вне разметки — ошибка (сообщение в std::cerr)
+static bool resolveMeshIds(const std::string& list, const LabelVolume& labels, bool pores,
+                           std::vector<uint32_t>& ids) {
+    ids.clear();
+    if (list.empty()) {
+        for (uint32_t id = 1; id <= labels.components.size(); ++id) {
+            if ((labels.components[id - 1].kind == ComponentKind::Pore) == pores) ids.push_back(id);
+        }
+        return true;
+    }
+    std::stringstream stream(list);
+    for (std::string item; std::getline(stream, item, ',');) {
+        if (item == "floating" || item == "internal-pores") {
+            for (uint32_t id = 1; id <= labels.components.size(); ++id) {
+                const LabelComponent& c = labels.components[id - 1];
+                bool match = item == "floating"
+                             ? c.kind == ComponentKind::Body && !c.touches_z0 &&
+                               c.voxels >= static_cast<size_t>(kFloatingMinVoxels)
+                             : c.kind == ComponentKind::Pore && !c.touches_border;
+                if (match) ids.push_back(id);
+            }
+            continue;
+        }
+        uint64_t id = 0;
+        auto [end, error] = std::from_chars(item.data(), item.data() + item.size(), id);
+        if (item.empty() || error == std::errc::invalid_argument || end != item.data() + item.size()) {
+            std::cerr << "Неизвестный элемент --mesh-ids: \"" << item << "\"" << std::endl;
+            return false;
+        }
+        if (error == std::errc::result_out_of_range || id == 0 || id > labels.components.size()) {
+            std::cerr << "Метка " << item << " вне разметки (компонент: " << labels.components.size() << ")"
+                      << std::endl;
+            return false;
+        }
+        ids.push_back(static_cast<uint32_t>(id));
+    }
+    return true;
+}
+
+// Экспорт поверхности тела, пор или выбранных компонент
+static int runMeshExport(const AnalyzerOptions& options) {
+    auto start = std::chrono::steady_clock::now();
+    MeshStats stats;
+    bool ok;
 
-    std::cout << "\nПроверка 3D-связности объекта:" << std::endl;
-    bool connected = is3DConnected(slices, body_value);
-    if (connected) {
-        std::cout << "Объём является связным (3D)." << std::endl;
+    if (!options.labels_file.empty() || !options.mesh_ids.empty()) {
+        LabelVolume labels;
+        if (!options.labels_file.empty()) {
+            if (!loadLabelVolume(options.labels_file, labels)) return 1;
+        } else {
+            auto slices = loadStack(options.folder, options.load);
+            if (slices.empty()) {
+                std::cerr << "Не удалось загрузить слайсы из папки: " << options.folder << std::endl;
+                return 1;
+            }
+            labels = labelVolume(slices, options.body_value, options.connectivity, options.pore_connectivity);
+        }
+        std::vector<uint32_t> ids;
+        if (!resolveMeshIds(options.mesh_ids, labels, options.mesh_pores, ids)) return 1;
+        std::cout << "Компонент в сетке: " << ids.size() << std::endl;
+        ok = writeLabelSurfaceMesh(labels, ids, options.mesh_path, stats);
     } else {
-        std::cout << "Объём НЕ является связным (3D)." << std::endl;
+        auto slices = loadStack(options.folder, options.load);
+        if (slices.empty()) {
+            std::cerr << "Не удалось загрузить слайсы из папки: " << options.folder << std::endl;
+            return 1;
+        }
+        ok = writeSurfaceMesh(slices, options.body_value, options.mesh_pores, options.mesh_path, stats);
     }
+    if (!ok) return 1;
 
-    std::cout << "\nАнализ пористости:" << std::endl;
-    PorosityStats stats = computePorosityStats(slices, body_value);
-    std::cout << "Пористость: " << stats.porosity * 100 << "%\n";
-    std::cout << "Количество внутренних пор: " << stats.pore_count << std::endl;
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Сетка сохранена в: " << options.mesh_path << " (вершин: " << stats.vertices
+              << ", граней: " << stats.faces << ", время: " << elapsed << " с)" << std::endl;
+    return 0;
+}
 
-    std::cout << "\nСохранение визуализации пор..." << std::endl;
+// Запрос к хранилищу результатов: последние разделы набора, его история или список наборов
+static int runResultsQuery(const AnalyzerOptions& options) {
+    const std::string dir = defaultResultsDir();
+    if (options.results_query == "all") {
+        for (const auto& dataset : listResultDatasets(dir)) {
+            std::cout << dataset << std::endl;
+        }
+        return 0;
+    }
 
-    std::string folder_name = std::filesystem::path(folder).filename().string();
-    std::string project_root = std::filesystem::current_path().parent_path().string();
+    if (options.results_history) {
+        auto records = readResultHistory(dir, options.results_query, options.results_section,
+                                         options.results_since_ms);
+        for (const auto& record : records) {
+            std::cout << nlohmann::json{{"dataset", record.dataset}, {"section", record.section},
+                                        {"time", record.time_ms}, {"data", record.data}}.dump()
+                      << std::endl;
+        }
+        return records.empty() ? 1 : 0;
+    }
+
+    nlohmann::json latest = latestResults(dir, options.results_query);
+    if (latest.empty()) {
+        std::cerr << "Нет результатов для набора: " << options.results_query << std::endl;
+        return 1;
+    }
+    std::cout << latest.dump(4) << std::endl;
+    return 0;
+}
+
+// Висячие тела для нескольких определений опоры по одной разметке
+static int runSupportAnalysis(const AnalyzerOptions& options) {
+    const int min_voxels = kFloatingMinVoxels;
+    std::vector<AnchorSource> sources;
+    std::vector<SupportDefinition> definitions(options.supports.size());
+    for (size_t i = 0; i < options.supports.size(); ++i) {
+        if (!parseSupportDefinition(options.supports[i], definitions[i], sources)) {
+            std::cerr << "Ошибка: некорректное определение опоры: " << options.supports[i] << std::endl;
+            return 1;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto slices = loadStack(options.folder, options.load);
+    if (slices.empty()) {
+        std::cerr << "Не удалось загрузить слайсы из папки: " << options.folder << std::endl;
+        return 1;
+    }
+    for (AnchorSource& source : sources) {
+        if (source.mask_path.empty()) continue;
+        source.mask = loadStack(source.mask_path, {});
+        if (source.mask.empty()) {
+            std::cerr << "Не удалось загрузить маску опоры: " << source.mask_path << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<SupportComponent> components;
+    try {
+        components = labelSupport(slices, options.body_value, sources, options.connectivity);
+    } catch (const std::invalid_argument& e) {
+        std::cerr << "Ошибка: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::vector<SupportSummary> summaries;
+    std::cout << "\nКомпонент тела: " << components.size() << std::endl;
+    for (const SupportDefinition& definition : definitions) {
+        summaries.push_back(evaluateSupport(components, definition, min_voxels));
+        const SupportSummary& summary = summaries.back();
+        std::cout << "Опора " << summary.name << ": опирающихся компонент " << summary.supported
+                  << ", висячих " << summary.unsupported << " (" << summary.unsupported_voxels << " вокселей)"
+                  << std::endl;
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Время: " << elapsed << " с" << std::endl;
+
+    std::string folder_name = std::filesystem::path(options.folder).filename().string();
+    saveResultSection(folder_name, "support", supportSummariesToJson(summaries, min_voxels));
+    return 0;
+}
+
+// Скелет пор и поровая сеть для моделирования течения
+static int runPoreNetwork(const AnalyzerOptions& options) {
+    StageProfile profile(options.profile);
+    auto slices = loadStack(options.folder, options.load);
+    if (slices.empty()) {
+        std::cerr << "Не удалось загрузить слайсы из папки: " << options.folder << std::endl;
+        return 1;
+    }
+    profile.mark("загрузка");
+
+    std::vector<float> distance = poreDistanceMap(slices, options.body_value);
+    profile.mark("карта расстояний");
+    ScratchArena::Scope scratch;
+    PaddedMask skeleton = skeletonizePores(slices, options.body_value);
+    profile.mark("скелет");
+    PoreNetwork network = extractPoreNetwork(skeleton, distance);
+    profile.mark("сеть");
+
+    if (!savePoreNetwork(network, options.pore_network)) return 1;
+    profile.mark("сохранение");
+
+    nlohmann::json summary = poreNetworkSummaryToJson(network);
+    std::cout << "\nВокселей скелета: " << network.skeleton_voxels << std::endl;
+    std::cout << "Узлов: " << network.nodes.size() << " (на границе: " << summary["border_nodes"].get<size_t>()
+              << ", изолированных: " << summary["isolated_nodes"].get<size_t>() << "), горл: "
+              << network.throats.size() << std::endl;
+    std::cout << "Координационное число: " << summary["coordination"].get<double>()
+              << ", средний радиус узла: " << summary["mean_node_radius"].get<double>()
+              << ", горла: " << summary["mean_throat_radius"].get<double>()
+              << ", средняя длина горла: " << summary["mean_throat_length"].get<double>() << std::endl;
+    std::cout << "Сеть сохранена в: " << options.pore_network << std::endl;
+
+    std::string folder_name = std::filesystem::path(options.folder).filename().string();
+    summary["file"] = options.pore_network;
+    saveResultSection(folder_name, "pore_network", summary);
+
+    profile.print();
+    return 0;
+}
+
+// Сравнение двух сканов одного образца: изменения по срезам и события компонент тела
+static int runVolumeDiff(const AnalyzerOptions& options) {
+    StageProfile profile(options.profile);
+    auto before = loadStack(options.folder, options.load);
+    auto after = loadStack(options.diff_with, options.load);
+    if (before.empty() || after.empty()) {
+        std::cerr << "Не удалось загрузить слайсы из папки: " << (before.empty() ? options.folder : options.diff_with)
+                  << std::endl;
+        return 1;
+    }
+    profile.mark("загрузка");
+
+    VolumeDiff diff;
+    try {
+        diff = diffVolumes(before, after, options.body_value, options.connectivity);
+    } catch (const std::invalid_argument& e) {
+        std::cerr << "Ошибка: " << e.what() << std::endl;
+        return 1;
+    }
+    profile.mark("сравнение");
+
+    std::vector<int> changed = diff.changedSlices();
+    std::cout << "\nИзменившихся срезов: " << changed.size() << " из " << diff.depth << " (совпавших пачек по "
+              << diff.slab_size << " срезов: " << diff.slabs_skipped << " из " << diff.slabs << ")" << std::endl;
+    std::cout << "Вокселей тела добавлено: " << diff.total_added << ", удалено: " << diff.total_removed << std::endl;
+    if (!diff.components_labeled) {
+        std::cout << "Тело не изменилось" << std::endl;
+    } else {
+        std::cout << "Компонент тела: " << diff.components_before << " → " << diff.components_after
+                  << ", без изменений связности: " << diff.components_matched << std::endl;
+    }
+    for (const ComponentEvent& event : diff.events) {
+        std::cout << "  " << componentChangeName(event.change) << ": ";
+        for (uint32_t id : event.before) std::cout << id << " ";
+        std::cout << "→";
+        for (uint32_t id : event.after) std::cout << " " << id;
+        std::cout << " (" << event.voxels_before << " → " << event.voxels_after << " вокселей)" << std::endl;
+    }
 
-    createBorderedCollageWithContours(slices, folder_name, project_root);
+    std::string folder_name = std::filesystem::path(options.folder).filename().string();
+    std::string other_name = std::filesystem::path(options.diff_with).filename().string();
+    nlohmann::json section = volumeDiffToJson(diff);
+    section["other"] = options.diff_with;
+
+    std::vector<int> shown = collageSlices(diff);
+    if (!shown.empty()) {
+        cv::Mat collage = renderChangeCollage(before, after, shown, options.body_value);
+        std::string path = saveChangeCollage(collage, folder_name + "_" + other_name, projectRoot());
+        std::cout << "Коллаж изменившихся срезов сохранён в: " << path << std::endl;
+        section["collage"] = path;
+        section["collage_slices"] = shown;
+    }
+    profile.mark("коллаж");
+    saveResultSection(folder_name, "diff", section);
+
+    profile.print();
+    return 0;
+}
+
+// Карта локальной пористости и кривая REV по интегральному объёму
+static int runLocalPorosity(const AnalyzerOptions& options) {
+    const double tolerance = 0.01;
+    const int stride = options.local_stride > 0 ? options.local_stride : std::max(1, options.local_window / 2);
+
+    StageProfile profile(options.profile);
+    auto slices = loadStack(options.folder, options.load);
+    if (slices.empty()) {
+        std::cerr << "Не удалось загрузить слайсы из папки: " << options.folder << std::endl;
+        return 1;
+    }
+    profile.mark("загрузка");
+
+    IntegralVolume integral = buildIntegralVolume(slices, options.body_value);
+    slices.clear();
+    profile.mark("интегральный объём");
+    const double porosity = integral.porosity({0, 0, 0}, {integral.width, integral.height, integral.depth});
+
+    LocalPorosityMap map = computeLocalPorosityMap(integral, options.local_window, stride);
+    profile.mark("карта");
+    std::vector<RevPoint> curve = computeRevCurve(integral);
+    profile.mark("REV");
+
+    std::cout << "\nПористость: " << porosity * 100 << "%" << std::endl;
+    std::cout << "Карта окон " << options.local_window << "³ с шагом " << stride << ": " << map.slices.size() << "×"
+              << map.slices[0].rows << "×" << map.slices[0].cols << ", пористость от " << map.min * 100 << "% до "
+              << map.max * 100 << "%, отклонение " << map.stddev * 100 << "%" << std::endl;
+    std::cout << "Кривая REV (окно: среднее ± отклонение):" << std::endl;
+    for (const RevPoint& point : curve) {
+        std::cout << "  " << point.window << ": " << point.mean * 100 << "% ± " << std::sqrt(point.variance) * 100
+                  << "% (" << point.windows << " окон)" << std::endl;
+    }
+    const int representative = representativeWindow(curve, tolerance);
+    if (representative > 0) {
+        std::cout << "Представительное окно: " << representative << " (отклонение не более " << tolerance * 100
+                  << "%)" << std::endl;
+    } else {
+        std::cout << "⚠️ Образец неоднороден: отклонение превышает " << tolerance * 100 << "% на всех окнах, имеющих не менее "
+                  << kMinRevWindows << " положений" << std::endl;
+    }
+
+    std::string out_dir = localPorosityFolder(options.folder, options.local_window);
+    if (!saveLocalPorosityMap(map, out_dir)) return 1;
+    std::cout << "Карта сохранена в: " << out_dir << std::endl;
+    profile.mark("сохранение");
+
+    std::string folder_name = std::filesystem::path(options.folder).filename().string();
+    nlohmann::json section = localPorosityToJson(porosity, map, curve, tolerance);
+    section["map"]["folder"] = out_dir;
+    saveResultSection(folder_name, "local_porosity", section);
+
+    profile.print();
+    return 0;
+}
 
-    std::cout << "\nПоиск висячих компонентов на 2D-срезах:" << std::endl;
-    detectFloatingIslands(slices, body_value);
+// Многофазный анализ объёма меток
+static int runPhaseAnalysis(const AnalyzerOptions& options) {
+    const std::string& folder = options.folder;
+    std::string folder_name = std::filesystem::path(folder).filename().string();
 
-    std::cout << "\nПоиск висячих компонентов в 3D:" << std::endl;
-    int floating_3d_count = detectFloatingIslands3D(slices, body_value);
+    StageProfile profile(options.profile);
+    auto slices = loadStack(folder, options.load);
+    if (slices.empty()) {
+        std::cerr << "Не удалось загрузить слайсы из папки: " << folder << std::endl;
+        return 1;
+    }
+    profile.mark("загрузка");
 
-    // Добавляем вызов сравнения с эталонными метриками
-    compareWithReferenceMetrics(folder_name, connected, stats, floating_3d_count);
+    std::cout << "\nМногофазный анализ (" << static_cast<int>(options.connectivity)
+              << "-связность):" << std::endl;
+    PhaseAnalysis phases = analyzePhases(slices, options.connectivity);
+    for (const auto& phase : phases.phases) {
+        std::cout << "Фаза " << static_cast<int>(phase.value)
+                  << ": доля " << phase.fraction * 100 << "%"
+                  << ", компонент: " << phase.components
+                  << ", замкнутых включений: " << phase.enclosed_inclusions << std::endl;
+    }
+    for (const auto& pair : phases.adjacency) {
+        std::cout << "Контакт фаз " << static_cast<int>(pair.a) << "–" << static_cast<int>(pair.b)
+                  << ": " << pair.contacts << " граней" << std::endl;
+    }
+    profile.mark("фазы");
+    saveResultSection(folder_name, "phases", phaseAnalysisToJson(phases));
 
+    profile.print();
     std::cout << "\nАнализ завершён." << std::endl;
     return 0;
 }
+
+int main(int argc, char** argv) {
+    AnalyzerOptions options;
+    if (!parseAnalyzerOptions(argc, argv, options)) {
+        printAnalyzerUsage(argv[0]);
+        return 1;
+    }
+
+    if (!options.serve_socket.empty()) {
+        return runAnalyzerService(options.serve_socket, options.cache_mb * 1024 * 1024, options.load);
+    }
+
+    if (!options.results_query.empty()) {
+        return runResultsQuery(options);
+    }
+
+    if (options.preview_level > 0) {
+        return runPreview(options);
+    }
+
+    if (!options.mesh_path.empty()) {
+        return runMeshExport(options);
+    }
+
+    if (!options.labels_file.empty()) {
+        return runLabelQueries(options);
+    }
+
+    if (!options.export_labels.empty()) {
+        return runLabelExport(options);
+    }
+
+    if (!options.queries.empty()) {
+        return runGraphQueries(options);
+    }
+
+    if (!options.supports.empty()) {
+        return runSupportAnalysis(options);
+    }
+
+    if (!options.pore_network.empty()) {
+        return runPoreNetwork(options);
+    }
+
+    if (!options.diff_with.empty()) {
+        return runVolumeDiff(options);
+    }
+
+    if (options.local_window > 0) {
+        return runLocalPorosity(options);
+    }
+
+    if (options.estimate_porosity) {
+        PorosityEstimate estimate =
+                estimatePorosity(options.folder, options.load, options.body_value, options.estimate);
+        if (estimate.slice_draws == 0) {
+            return 1;
+        }
+        std::cout << "\nВыборочная оценка пористости (" << sampleModeName(options.estimate.mode) << "):" << std::endl;
+        std::cout << "≈ Пористость: " << estimate.porosity * 100 << "% ± " << estimate.half_width * 100
+                  << "% (доверие " << estimate.confidence * 100 << "%)" << std::endl;
+        std::cout << "Прочитано срезов: " << estimate.slices_read << " из " << estimate.total_slices
+                  << ", вокселей в выборке: " << estimate.voxels_sampled
+                  << ", время: " << estimate.seconds << " с" << std::endl;
+        if (!estimate.converged) {
+            std::cout << "⚠️ Требуемая точность не достигнута" << std::endl;
+        }
+        std::string folder_name = std::filesystem::path(options.folder).filename().string();
+        saveResultSection(folder_name, "porosity_estimate", porosityEstimateToJson(estimate, options.estimate));
+        return 0;
+    }
+
+    if (options.phases) {
+        return runPhaseAnalysis(options);
+    }
+
+    return runAnalysisPipeline(options);
+}
@@ -0,0 +1,276 @@
+#include "analyzer_options.h"
+#include <charconv>
+#include <chrono>
+#include <iostream>
+
+// Окно --local-porosity: W или W:S, целые W > 0 и S >= 0 (0 — половина окна); строка разбирается целиком
+static bool parseLocalWindow(const std::string& text, int& window, int& stride) {
+    const char* end = text.data() + text.size();
+    auto [rest, error] = std::from_chars(text.data(), end, window);
+    if (error != std::errc() || window <= 0) return false;
+    stride = 0;
+    if (rest == end) return true;
+    if (*rest != ':') return false;
+    auto [stride_end, stride_error] = std::from_chars(rest + 1, end, stride);
+    return stride_error == std::errc() && stride_end == end && stride >= 0;
+}
+
+// Момент для --since: время в миллисекундах от эпохи или давность N с суффиксом s, m, h, d
+static bool parseSince(const std::string& text, int64_t& since_ms) {
+    int64_t value = 0;
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc() || value < 0) return false;
+    const std::string suffix(end, text.data() + text.size());
+    if (suffix.empty()) {
+        since_ms = value;
+        return true;
+    }
+    const int64_t unit_ms = suffix == "s" ? 1000
+                          : suffix == "m" ? 60000
+                          : suffix == "h" ? 3600000
+                          : suffix == "d" ? 86400000
+                                          : 0;
+    if (unit_ms == 0) return false;
+    const int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    since_ms = value > now_ms / unit_ms ? 0 : now_ms - value * unit_ms;
+    return true;
+}
+
+void printAnalyzerUsage(const char* program) {
+    std::cerr << "Пример использования: " << program << " ./slices_folder|stack.tif [опции]\n"
+              << "Опции:\n"
+              << "  --threshold T|otsu           бинаризация при загрузке: тело — значения больше T\n"
+              << "  --connectivity 6|18|26       связность тела (по умолчанию 6)\n"
+              << "  --pore-connectivity 6|18|26  связность пор (по умолчанию дополнительная к связности тела)\n"
+              << "  --island-connectivity 4|8    связность островов на 2D-срезах (по умолчанию 8)\n"
+              << "  --phases                     многофазный анализ: каждое значение пикселя — отдельная фаза\n"
+              << "  --preview-level 1|2|3        приблизительный анализ на уровне пирамиды (2x, 4x, 8x)\n"
+              << "  --reduction majority|any|all правило свёртки блоков пирамиды (по умолчанию majority)\n"
+              << "  --save-pyramid               сохранить уровни пирамиды рядом со срезами\n"
+              << "  --estimate-porosity          оценить пористость по выборке с доверительным интервалом\n"
+              << "  --sample-mode voxels|rows|blocks  единица выборки (по умолчанию rows)\n"
+              << "  --precision P                целевая полуширина интервала, доля (по умолчанию 0.001)\n"
+              << "  --confidence C               уровень доверия (по умолчанию 0.95)\n"
+              << "  --time-budget S              ограничение времени оценки или анализа в секундах\n"
+              << "  --seed N                     зерно генератора случайных чисел\n"
+              << "  --serve SOCKET               режим сервиса: запросы JSON по Unix-сокету (папка не нужна)\n"
+              << "  --cache-mb N                 лимит кэша объёмов сервиса в МБ (по умолчанию 1024)\n"
+              << "  --no-cache                   пересчитать результаты, даже если срезы не изменились\n"
+              << "  --query Q                    запрос к индексу компонент срезов (можно повторять):\n"
+              << "                               connected | floating[:MIN] | slices:A:B | attached:Z,Y,X |\n"
+              << "                               reach:Z,Y,X:Z,Y,X\n"
+              << "                               с --labels: at:Z,Y,X | box:Z,Y,X:Z,Y,X | nearest-pore:Z,Y,X\n"
+              << "  --export-labels FILE         сохранить объём меток компонент тела и пор\n"
+              << "  --compress-labels            сжимать сохраняемые метки сериями (RLE)\n"
+              << "  --labels FILE                запросы к сохранённому объёму меток (папка не нужна)\n"
+              << "  --mesh FILE.ply|FILE.stl     сохранить поверхность тела (surface nets)\n"
+              << "  --mesh-pores                 поверхность пор вместо тела\n"
+              << "  --mesh-ids LIST              только компоненты с метками из списка или floating / internal-pores\n"
+              << "  --support DEF                опоры висячих тел (можно повторять; все за один проход разметки):\n"
+              << "                               грани z0|z1|y0|y1|x0|x1|all, mask=ПУТЬ, seeds=Z,Y,X;Z,Y,X,\n"
+              << "                               части объединяются через +, например z0+x0+x1\n"
+              << "  --pore-network FILE          скелет пор и поровая сеть (узлы, горла) в FILE.json или FILE.graphml\n"
+              << "  --diff OTHER                 сравнить скан с повторным сканом OTHER того же размера\n"
+              << "  --local-porosity W[:S]       карта пористости окон W³ с шагом S (по умолчанию W/2) и кривая REV\n"
+              << "  --results NAME|all           последние результаты набора из хранилища (папка не нужна)\n"
+              << "  --history                    с --results: все записи набора в порядке записи\n"
+              << "  --section S                  с --history: только раздел S\n"
+              << "  --since T                    с --history: записи не раньше T — время записи в мс от эпохи\n"
+              << "                               или давность Ns, Nm, Nh, Nd (например 7d)\n"
+              << "  --bricks                     загружать объём в кирпичи 8³ (Z-кривая) для 3D-этапов; без коллажа\n"
+              << "                               и островов на срезах\n"
+              << "  --batch                      проанализировать все наборы (подпапки и TIFF) указанной папки\n"
+              << "  --jobs N                     число потоков для этапов анализа (по умолчанию — по числу ядер)\n"
+              << "  --profile                    вывести время этапов и статистику временной памяти\n"
+              << "  --progress                   печатать прогресс этапов строками JSON (SIGINT прерывает анализ)\n";
+}
+
+bool parseAnalyzerOptions(int argc, char** argv, AnalyzerOptions& options) {
+    bool pore_connectivity_set = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next_value = [&](std::string& value) {
+            if (i + 1 >= argc) {
+                std::cerr << "Ошибка: для опции " << arg << " не указано значение." << std::endl;
+                return false;
+            }
+            value = argv[++i];
+            return true;
+        };
+
+        if (arg == "--connectivity" || arg == "--pore-connectivity") {
+            std::string value;
+            if (!next_value(value)) return false;
+            Connectivity parsed;
+            if (!parseConnectivity(value, parsed)) {
+                std::cerr << "Ошибка: связность должна быть 6, 18 или 26, получено: " << value << std::endl;
+                return false;
+            }
+            if (arg == "--connectivity") {
+                options.connectivity = parsed;
+            } else {
+                options.pore_connectivity = parsed;
+                pore_connectivity_set = true;
+            }
+        } else if (arg == "--island-connectivity") {
+            std::string value;
+            if (!next_value(value)) return false;
+            if (value != "4" && value != "8") {
+                std::cerr << "Ошибка: связность на срезе должна быть 4 или 8, получено: " << value << std::endl;
+                return false;
+            }
+            options.island_connectivity = std::stoi(value);
+        } else if (arg == "--threshold") {
+            std::string value;
+            if (!next_value(value)) return false;
+            if (!parseThreshold(value, options.load)) {
+                std::cerr << "Ошибка: порог должен быть числом или otsu, получено: " << value << std::endl;
+                return false;
+            }
+        } else if (arg == "--phases") {
+            options.phases = true;
+        } else if (arg == "--preview-level") {
+            std::string value;
+            if (!next_value(value)) return false;
+            if (value != "1" && value != "2" && value != "3") {
+                std::cerr << "Ошибка: уровень предпросмотра должен быть 1, 2 или 3, получено: " << value << std::endl;
+                return false;
+            }
+            options.preview_level = std::stoi(value);
+        } else if (arg == "--reduction") {
+            std::string value;
+            if (!next_value(value)) return false;
+            if (!parseReductionRule(value, options.reduction)) {
+                std::cerr << "Ошибка: правило свёртки должно быть majority, any или all, получено: " << value << std::endl;
+                return false;
+            }
+        } else if (arg == "--save-pyramid") {
+            options.save_pyramid = true;
+        } else if (arg == "--serve") {
+            if (!next_value(options.serve_socket)) return false;
+        } else if (arg == "--cache-mb") {
+            std::string value;
+            if (!next_value(value)) return false;
+            try {
+                options.cache_mb = std::stoull(value);
+            } catch (const std::exception&) {
+                std::cerr << "Ошибка: некорректный размер кэша: " << value << std::endl;
+                return false;
+            }
+        } else if (arg == "--no-cache") {
+            options.no_cache = true;
+        } else if (arg == "--query") {
+            std::string value;
+            if (!next_value(value)) return false;
+            options.queries.push_back(value);
+        } else if (arg == "--export-labels") {
+            if (!next_value(options.export_labels)) return false;
+        } else if (arg == "--compress-labels") {
+            options.compress_labels = true;
+        } else if (arg == "--labels") {
+            if (!next_value(options.labels_file)) return false;
+        } else if (arg == "--mesh") {
+            if (!next_value(options.mesh_path)) return false;
+        } else if (arg == "--mesh-pores") {
+            options.mesh_pores = true;
+        } else if (arg == "--mesh-ids") {
+            if (!next_value(options.mesh_ids)) return false;
+        } else if (arg == "--support") {
+            std::string value;
+            if (!next_value(value)) return false;
+            options.supports.push_back(value);
+        } else if (arg == "--pore-network") {
+            if (!next_value(options.pore_network)) return false;
+        } else if (arg == "--diff") {
+            if (!next_value(options.diff_with)) return false;
+        } else if (arg == "--local-porosity") {
+            std::string value;
+            if (!next_value(value)) return false;
+            if (!parseLocalWindow(value, options.local_window, options.local_stride)) {
+                std::cerr << "Ошибка: окно должно быть задано как W или W:S, получено: " << value << std::endl;
+                return false;
+            }
+        } else if (arg == "--results") {
+            if (!next_value(options.results_query)) return false;
+        } else if (arg == "--history") {
+            options.results_history = true;
+        } else if (arg == "--section") {
+            if (!next_value(options.results_section)) return false;
+        } else if (arg == "--since") {
+            std::string value;
+            if (!next_value(value)) return false;
+            if (!parseSince(value, options.results_since_ms)) {
+                std::cerr << "Ошибка: момент должен быть временем в мс или давностью вида 7d, получено: " << value
+                          << std::endl;
+                return false;
+            }
+        } else if (arg == "--bricks") {
+            options.bricks = true;
+        } else if (arg == "--batch") {
+            options.batch = true;
+        } else if (arg == "--jobs") {
+            std::string value;
+            if (!next_value(value)) return false;
+            try {
+                options.jobs = std::stoi(value);
+            } catch (const std::exception&) {
+                options.jobs = -1;
+            }
+            if (options.jobs <= 0) {
+                std::cerr << "Ошибка: число потоков должно быть положительным, получено: " << value << std::endl;
+                return false;
+            }
+        } else if (arg == "--profile") {
+            options.profile = true;
+        } else if (arg == "--progress") {
+            options.progress = true;
+        } else if (arg == "--estimate-porosity") {
+            options.estimate_porosity = true;
+        } else if (arg == "--sample-mode") {
+            std::string value;
+            if (!next_value(value)) return false;
+            if (!parseSampleMode(value, options.estimate.mode)) {
+                std::cerr << "Ошибка: единица выборки должна быть voxels, rows или blocks, получено: " << value << std::endl;
+                return false;
+            }
+        } else if (arg == "--precision" || arg == "--confidence" || arg == "--time-budget" || arg == "--seed") {
+            std::string value;
+            if (!next_value(value)) return false;
+            try {
+                if (arg == "--precision") options.estimate.precision = std::stod(value);
+                else if (arg == "--confidence") options.estimate.confidence = std::stod(value);
+                else if (arg == "--time-budget") options.time_budget = options.estimate.time_budget = std::stod(value);
+                else options.estimate.seed = std::stoull(value);
+            } catch (const std::exception&) {
+                std::cerr << "Ошибка: некорректное значение " << value << " для опции " << arg << std::endl;
+                return false;
+            }
+            if (options.estimate.precision <= 0.0 ||
+                options.estimate.confidence <= 0.0 || options.estimate.confidence >= 1.0) {
+                std::cerr << "Ошибка: точность должна быть > 0, уровень доверия — в интервале (0, 1)." << std::endl;
+                return false;
+            }
+        } else if (arg.rfind("--", 0) == 0) {
+            std::cerr << "Ошибка: неизвестная опция " << arg << std::endl;
+            return false;
+        } else if (options.folder.empty()) {
+            options.folder = arg;
+        } else {
+            std::cerr << "Ошибка: лишний аргумент " << arg << std::endl;
+            return false;
+        }
+    }
+
+    if (options.folder.empty() && options.serve_socket.empty() && options.labels_file.empty() &&
+        options.results_query.empty()) {
+        std::cerr << "Ошибка: укажите путь к папке со слайсами." << std::endl;
+        return false;
+    }
+
+    if (!pore_connectivity_set) {
+        options.pore_connectivity = complementaryConnectivity(options.connectivity);
+    }
+    return true;
+}
@@ -0,0 +1,62 @@
+#ifndef ANALYZER_OPTIONS_H
+#define ANALYZER_OPTIONS_H
+
+#include "neighborhood.h"
+#include "porosity_estimator.h"
+#include "stack_loader.h"
+#include "volume_pyramid.h"
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Параметры запуска volume_analyzer
+struct AnalyzerOptions {
+    std::string folder;                                       // папка со срезами или многостраничный TIFF
+    StackLoadOptions load;
+    uchar body_value = 255;
+    Connectivity connectivity = Connectivity::Six;        // связность тела
+    Connectivity pore_connectivity = Connectivity::TwentySix; // связность пор (по умолчанию дополнительная)
+    int island_connectivity = 8;                              // связность островов на срезах (4 или 8)
+    bool phases = false;                                      // многофазный анализ объёма меток
+    int preview_level = 0;                                    // уровень пирамиды для предпросмотра (0 — выкл.)
+    ReductionRule reduction = ReductionRule::Majority;
+    bool save_pyramid = false;
+    bool estimate_porosity = false;                           // выборочная оценка пористости
+    PorosityEstimateOptions estimate;
+    std::string serve_socket;                                 // режим сервиса на Unix-сокете
+    size_t cache_mb = 1024;
+    bool no_cache = false;                                    // не использовать кэш результатов
+    std::vector<std::string> queries;                         // запросы к индексу компонент срезов или к файлу меток
+    std::string export_labels;                                // сохранить объём меток в файл
+    bool compress_labels = false;
+    std::string labels_file;                                  // отвечать на запросы по сохранённому объёму меток
+    std::string mesh_path;                                    // поверхность в .ply или .stl
+    bool mesh_pores = false;                                  // поверхность пор вместо тела
+    std::string mesh_ids;                                     // только выбранные компоненты
+    std::vector<std::string> supports;                        // определения опоры для анализа висячих тел
+    std::string pore_network;                                 // поровая сеть в .json или .graphml
+    std::string diff_with;                                    // второй скан для сравнения с folder
+    int local_window = 0;                                     // окно карты локальной пористости (0 — выкл.)
+    int local_stride = 0;                                     // шаг карты (0 — половина окна)
+    std::string results_query;                                // набор данных (или all) для запроса к хранилищу результатов
+    bool results_history = false;                             // все записи набора вместо последних
+    std::string results_section;                              // только указанный раздел истории
+    int64_t results_since_ms = 0;                             // только записи истории не раньше этого момента
+    bool bricks = false;                                      // 3D-этапы на объёме в кирпичах 8³
+    bool batch = false;                                       // folder — папка с наборами данных
+    int jobs = 0;                                             // потоков пула этапов (0 — по числу ядер)
+    bool profile = false;                                     // время этапов и счётчики временной памяти
+    bool progress = false;                                    // прогресс этапов строками JSON на stdout
+    double time_budget = 0.0;                                 // ограничение времени анализа (0 — нет)
+};
+
+void printAnalyzerUsage(const char* program);
+
+/**
+ * @brief Разбирает аргументы командной строки
+ * @return false, если аргументы некорректны (сообщение уже выведено в std::cerr)
+ */
+bool parseAnalyzerOptions(int argc, char** argv, AnalyzerOptions& options);
+
+#endif
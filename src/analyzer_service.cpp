@@ -0,0 +1,392 @@
+#include "analyzer_service.h"
+#include "result_cache.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <set>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+size_t CachedVolume::bytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t total = 0;
+    for (const auto& slice : slices) {
+        total += slice.total() * slice.elemSize();
+    }
+    for (const auto& [key, table] : components) {
+        total += table.size() * sizeof(ComponentInfo);
+    }
+    return total;
+}
+
+// Параметры загрузки в каноническом виде: часть имени записи кэша и ключа содержимого
+static std::string loadParameters(const StackLoadOptions& load) {
+    return "threshold=" + std::to_string(static_cast<int>(load.threshold_mode)) + ":" + std::to_string(load.threshold);
+}
+
+VolumeCache::VolumeCache(size_t capacity_bytes) : capacity_bytes_(capacity_bytes) {}
+
+std::shared_ptr<CachedVolume> VolumeCache::acquire(const std::string& folder, const StackLoadOptions& load,
+                                                   bool& loaded) {
+    const std::string name = folder + "\n" + loadParameters(load);
+    uint64_t stack_hash = 0;
+    std::vector<std::string> files = listStackFiles(folder);
+    if (files.empty() || !hashSliceStack(files, stack_hash)) {
+        return nullptr;
+    }
+    const std::string key = makeResultCacheKey(stack_hash, loadParameters(load));
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(name);
+        if (it != index_.end()) {
+            if (it->second->second->key == key) {
+                entries_.splice(entries_.begin(), entries_, it->second);
+                hits_++;
+                loaded = false;
+                return entries_.front().second;
+            }
+            // Срезы на диске изменились
+            entries_.erase(it->second);
+            index_.erase(it);
+        }
+    }
+
+    auto volume = std::make_shared<CachedVolume>();
+    volume->key = key;
+    volume->slices = loadStack(folder, load);
+    if (volume->slices.empty()) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    misses_++;
+    loaded = true;
+    // Тот же объём мог загрузить параллельный запрос: остаётся последний загруженный
+    auto it = index_.find(name);
+    if (it != index_.end()) {
+        entries_.erase(it->second);
+        index_.erase(it);
+    }
+    entries_.emplace_front(name, volume);
+    index_[name] = entries_.begin();
+    trimLocked();
+    return volume;
+}
+
+void VolumeCache::invalidate(const std::string& folder) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const std::string prefix = folder + "\n";
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        if (it->first.compare(0, prefix.size(), prefix) == 0) {
+            index_.erase(it->first);
+            it = entries_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void VolumeCache::trim() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    trimLocked();
+}
+
+void VolumeCache::trimLocked() {
+    // Последний использованный объём остаётся, даже если он один больше лимита; вытесненный
+    // объём живёт, пока его используют запросы, уже получившие его
+    while (entries_.size() > 1 && bytesLocked() > capacity_bytes_) {
+        index_.erase(entries_.back().first);
+        entries_.pop_back();
+    }
+}
+
+size_t VolumeCache::bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytesLocked();
+}
+
+size_t VolumeCache::bytesLocked() const {
+    size_t total = 0;
+    for (const auto& entry : entries_) {
+        total += entry.second->bytes();
+    }
+    return total;
+}
+
+size_t VolumeCache::entries() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+size_t VolumeCache::hits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+size_t VolumeCache::misses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+}
+
+nlohmann::json handleAnalysisRequest(VolumeCache& cache, const nlohmann::json& request,
+                                     const StackLoadOptions& default_load) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::string command = request.value("command", "analyze");
+    if (command == "stats" || command == "shutdown") {
+        return {
+                {"ok", true},
+                {"cache_entries", cache.entries()},
+                {"cache_bytes", cache.bytes()},
+                {"cache_hits", cache.hits()},
+                {"cache_misses", cache.misses()}
+        };
+    }
+    if (command != "analyze") {
+        return {{"ok", false}, {"error", "unknown command: " + command}};
+    }
+    if (!request.contains("folder")) {
+        return {{"ok", false}, {"error", "field 'folder' is required"}};
+    }
+
+    std::error_code ec;
+    std::string folder = fs::weakly_canonical(request["folder"].get<std::string>(), ec).string();
+    int body_value = request.value("body_value", 255);
+    int min_voxels = request.value("min_voxels", kFloatingMinVoxels);
+
+    Connectivity connectivity = Connectivity::Six;
+    if (request.contains("connectivity") &&
+        !parseConnectivity(std::to_string(request["connectivity"].get<int>()), connectivity)) {
+        return {{"ok", false}, {"error", "connectivity must be 6, 18 or 26"}};
+    }
+    Connectivity pore_connectivity = complementaryConnectivity(connectivity);
+    if (request.contains("pore_connectivity") &&
+        !parseConnectivity(std::to_string(request["pore_connectivity"].get<int>()), pore_connectivity)) {
+        return {{"ok", false}, {"error", "pore_connectivity must be 6, 18 or 26"}};
+    }
+    if (body_value < 0 || body_value > 255) {
+        return {{"ok", false}, {"error", "body_value must be in [0, 255]"}};
+    }
+
+    StackLoadOptions load = default_load;
+    if (request.contains("threshold")) {
+        const nlohmann::json& threshold = request["threshold"];
+        if (threshold.is_number()) {
+            load.threshold_mode = ThresholdMode::Fixed;
+            load.threshold = threshold.get<double>();
+        } else if (!threshold.is_string() || !parseThreshold(threshold.get<std::string>(), load)) {
+            return {{"ok", false}, {"error", "threshold must be a number or \"otsu\""}};
+        }
+    }
+
+    if (request.value("reload", false)) {
+        cache.invalidate(folder);
+    }
+
+    bool loaded = false;
+    std::shared_ptr<CachedVolume> volume = cache.acquire(folder, load, loaded);
+    if (!volume) {
+        return {{"ok", false}, {"error", "failed to load slices from " + folder}};
+    }
+
+    // Недостающие таблицы считаются без блокировки; параллельный запрос мог посчитать их
+    // же — тогда сохраняется любая из одинаковых
+    const uchar body = static_cast<uchar>(body_value);
+    const std::pair<int, int> body_key(body_value, static_cast<int>(connectivity));
+    const std::pair<int, int> pore_key(body_value, static_cast<int>(pore_connectivity));
+    std::unique_lock<std::mutex> lock(volume->mutex);
+    const bool labels_cached = volume->components.count(body_key) > 0;
+    if (!volume->connected.count(body_key)) {
+        lock.unlock();
+        bool connected = is3DConnected(volume->slices, body, connectivity);
+        lock.lock();
+        volume->connected[body_key] = connected;
+    }
+    if (!volume->porosity.count(pore_key)) {
+        lock.unlock();
+        PorosityStats stats = computePorosityStats(volume->slices, body, pore_connectivity);
+        lock.lock();
+        volume->porosity[pore_key] = stats;
+    }
+    if (!labels_cached) {
+        lock.unlock();
+        std::vector<ComponentInfo> components = labelComponents3D(volume->slices, body, connectivity);
+        lock.lock();
+        volume->components[body_key] = std::move(components);
+    }
+
+    const PorosityStats stats = volume->porosity[pore_key];
+    const bool connected = volume->connected[body_key];
+    const std::vector<ComponentInfo>& components = volume->components[body_key];
+    const int floating = countFloatingComponents(components, min_voxels);
+    const size_t component_count = components.size();
+    lock.unlock();
+    if (!labels_cached) cache.trim();
+
+    return {
+            {"ok", true},
+            {"folder", folder},
+            {"connected", connected},
+            {"porosity", stats.porosity},
+            {"internal_pores", stats.pore_count},
+            {"floating_parts", floating},
+            {"components", component_count},
+            {"volume_cached", !loaded},
+            {"labels_cached", labels_cached},
+            {"seconds", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()}
+    };
+}
+
+// Читает из сокета одну строку; false — соединение закрыто
+static bool readLine(int fd, std::string& buffer, std::string& line) {
+    while (true) {
+        size_t pos = buffer.find('\n');
+        if (pos != std::string::npos) {
+            line = buffer.substr(0, pos);
+            buffer.erase(0, pos + 1);
+            return true;
+        }
+        char chunk[4096];
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) return false;
+        buffer.append(chunk, n);
+    }
+}
+
+static bool writeAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, 0);
+        if (n <= 0) return false;
+        sent += n;
+    }
+    return true;
+}
+
+// Общее состояние сервиса: кэш, параметры загрузки и открытые соединения
+struct ServiceState {
+    VolumeCache cache;
+    StackLoadOptions load;
+    int server;
+    std::atomic<bool> running{true};
+    std::mutex mutex; // clients и вывод журнала запросов
+    std::condition_variable finished;
+    std::set<int> clients;
+
+    ServiceState(size_t cache_bytes, const StackLoadOptions& load_options, int server_fd)
+        : cache(cache_bytes), load(load_options), server(server_fd) {}
+};
+
+// Останавливает приём соединений и будит потоки, ждущие запросов
+static void stopService(ServiceState& state) {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.running = false;
+    shutdown(state.server, SHUT_RDWR);
+    for (int client : state.clients) {
+        shutdown(client, SHUT_RDWR);
+    }
+}
+
+// Поток соединения: запросы обрабатываются по очереди, пока клиент не закроет соединение
+static void serveClient(ServiceState& state, int client) {
+    std::string buffer, line;
+    while (state.running && readLine(client, buffer, line)) {
+        if (line.empty()) continue;
+
+        nlohmann::json response;
+        bool stop = false;
+        try {
+            nlohmann::json request = nlohmann::json::parse(line);
+            response = handleAnalysisRequest(state.cache, request, state.load);
+            stop = request.value("command", "") == "shutdown";
+        } catch (const std::exception& e) {
+            response = {{"ok", false}, {"error", e.what()}};
+        }
+
+        if (response.value("ok", false) && response.contains("folder")) {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            std::cout << "Запрос: " << response["folder"].get<std::string>()
+                      << (response["volume_cached"].get<bool>() ? " (из кэша)" : " (загружен)")
+                      << ", " << response["seconds"].get<double>() << " с" << std::endl;
+        }
+        if (!writeAll(client, response.dump() + "\n")) break;
+        if (stop) stopService(state);
+    }
+
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.clients.erase(client);
+    close(client);
+    state.finished.notify_all();
+}
+
+int runAnalyzerService(const std::string& socket_path, size_t cache_bytes, const StackLoadOptions& load) {
+    std::signal(SIGPIPE, SIG_IGN);
+
+    sockaddr_un addr{};
+    if (socket_path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Ошибка: слишком длинный путь к сокету: " << socket_path << std::endl;
+        return 1;
+    }
+    // Оставшийся от прошлого запуска сокет удаляется перед bind, любой другой файл — нет
+    struct stat existing{};
+    if (lstat(socket_path.c_str(), &existing) == 0 && !S_ISSOCK(existing.st_mode)) {
+        std::cerr << "Ошибка: " << socket_path << " существует и не является сокетом" << std::endl;
+        return 1;
+    }
+
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0) {
+        std::cerr << "Ошибка создания сокета: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(socket_path.c_str());
+    if (bind(server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(server, 16) < 0) {
+        std::cerr << "Ошибка привязки сокета " << socket_path << ": " << std::strerror(errno) << std::endl;
+        close(server);
+        return 1;
+    }
+
+    std::cout << "Сервис анализа слушает " << socket_path
+              << " (кэш: " << cache_bytes / (1024 * 1024) << " МБ)" << std::endl;
+
+    ServiceState state(cache_bytes, load, server);
+    while (state.running) {
+        int client = accept(server, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) continue;
+            if (state.running) std::cerr << "Ошибка accept: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (!state.running) {
+            close(client);
+            break;
+        }
+        state.clients.insert(client);
+        std::thread(serveClient, std::ref(state), client).detach();
+    }
+
+    // Остальные соединения закрываются; кэш освобождается после выхода их потоков
+    stopService(state);
+    {
+        std::unique_lock<std::mutex> lock(state.mutex);
+        state.finished.wait(lock, [&] { return state.clients.empty(); });
+    }
+    close(server);
+    unlink(socket_path.c_str());
+    std::cout << "Сервис анализа остановлен." << std::endl;
+    return 0;
+}
@@ -0,0 +1,93 @@
+#ifndef ANALYZER_SERVICE_H
+#define ANALYZER_SERVICE_H
+
+#include "connectivity_checker.h"
+#include <nlohmann/json.hpp>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Загруженный объём и уже посчитанные по нему таблицы; ключи — (body_value, связность).
+// Срезы после загрузки не меняются, таблицы дополняются под mutex объёма
+struct CachedVolume {
+    std::string key; // содержимое срезов и параметры загрузки (makeResultCacheKey)
+    std::vector<cv::Mat> slices;
+    std::map<std::pair<int, int>, bool> connected;
+    std::map<std::pair<int, int>, PorosityStats> porosity;
+    std::map<std::pair<int, int>, std::vector<ComponentInfo>> components;
+    mutable std::mutex mutex;
+
+    size_t bytes() const;
+};
+
+// LRU-кэш декодированных объёмов, ограниченный по памяти; общий для всех соединений
+class VolumeCache {
+public:
+    explicit VolumeCache(size_t capacity_bytes);
+
+    /**
+     * @brief Возвращает объём из кэша или загружает его с диска
+     *
+     * Запись ищется по папке и параметрам загрузки и проверяется по хешу содержимого
+     * срезов: изменённые на диске срезы загружаются заново. Хеширование и загрузка
+     * идут без блокировки кэша, поэтому запросы разных соединений не ждут друг друга.
+     * @param loaded Устанавливается в true, если объём пришлось загрузить
+     * @return nullptr, если срезы не удалось прочитать
+     */
+    std::shared_ptr<CachedVolume> acquire(const std::string& folder, const StackLoadOptions& load, bool& loaded);
+
+    // Удаляет объёмы папки (с любыми параметрами загрузки) из кэша
+    void invalidate(const std::string& folder);
+
+    // Вытесняет давно не использованные объёмы, пока кэш не уложится в лимит
+    void trim();
+
+    size_t bytes() const;
+    size_t entries() const;
+    size_t hits() const;
+    size_t misses() const;
+
+private:
+    using Entry = std::pair<std::string, std::shared_ptr<CachedVolume>>;
+
+    void trimLocked();
+    size_t bytesLocked() const;
+
+    mutable std::mutex mutex_;
+    size_t capacity_bytes_;
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+    std::list<Entry> entries_; // в начале — последний использованный
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+};
+
+/**
+ * @brief Обрабатывает один запрос на анализ
+ *
+ * Запрос: {"folder": "...", "body_value": 255, "connectivity": 6,
+ *          "pore_connectivity": 26, "min_voxels": 10, "threshold": 128 | "otsu",
+ *          "reload": false}
+ * Без threshold срезы бинаризуются по параметрам запуска сервиса (load).
+ * Служебные команды: {"command": "stats"} и {"command": "shutdown"}.
+ */
+nlohmann::json handleAnalysisRequest(VolumeCache& cache, const nlohmann::json& request,
+                                     const StackLoadOptions& load);
+
+/**
+ * @brief Запускает сервис анализа на локальном Unix-сокете
+ *
+ * Запросы и ответы — JSON-объекты, по одному на строку. Каждое соединение
+ * обслуживается своим потоком, кэш объёмов общий; сервис работает до команды
+ * shutdown, после которой остальные соединения закрываются.
+ *
+ * @param load Бинаризация срезов по умолчанию (--threshold)
+ * @return Код завершения процесса
+ */
+int runAnalyzerService(const std::string& socket_path, size_t cache_bytes, const StackLoadOptions& load);
+
+#endif
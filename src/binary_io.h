@@ -0,0 +1,34 @@
+#ifndef BINARY_IO_H
+#define BINARY_IO_H
+
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+// Чтение и запись значений и массивов в двоичные файлы индексов (порядок байт — как на машине)
+
+template <typename T>
+void writeValue(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void writeArray(std::ofstream& out, const std::vector<T>& values) {
+    writeValue<uint64_t>(out, values.size());
+    out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+template <typename T>
+bool readValue(std::ifstream& in, T& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+template <typename T>
+bool readArray(std::ifstream& in, std::vector<T>& values) {
+    uint64_t size = 0;
+    if (!readValue(in, size)) return false;
+    values.resize(size);
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(values.data()), size * sizeof(T)));
+}
+
+#endif
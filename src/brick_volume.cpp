@@ -0,0 +1,126 @@
+#include "brick_volume.h"
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+// Разрежает биты числа: бит i переходит в позицию 3i
+uint64_t spreadBits(uint64_t v) {
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffffULL;
+    v = (v | v << 16) & 0x1f0000ff0000ffULL;
+    v = (v | v << 8) & 0x100f00f00f00f00fULL;
+    v = (v | v << 4) & 0x10c30c30c30c30c3ULL;
+    v = (v | v << 2) & 0x1249249249249249ULL;
+    return v;
+}
+
+uint64_t mortonCode(int z, int y, int x) {
+    return spreadBits(z) << 2 | spreadBits(y) << 1 | spreadBits(x);
+}
+
+int bricksFor(int voxels) {
+    return (voxels + 2 + kBrickSize - 1) / kBrickSize;
+}
+
+} // namespace
+
+BrickVolume makeBrickVolume(int depth, int height, int width, uchar fill) {
+    BrickVolume bricks;
+    bricks.depth = depth;
+    bricks.height = height;
+    bricks.width = width;
+    bricks.grid_z = bricksFor(depth);
+    bricks.grid_y = bricksFor(height);
+    bricks.grid_x = bricksFor(width);
+    const size_t count = static_cast<size_t>(bricks.grid_z) * bricks.grid_y * bricks.grid_x;
+
+    // Кирпичи нумеруются подряд в порядке кода Мортона: сетка не обязана быть степенью двойки
+    std::vector<uint64_t> codes(count);
+    for (int bz = 0; bz < bricks.grid_z; ++bz) {
+        for (int by = 0; by < bricks.grid_y; ++by) {
+            for (int bx = 0; bx < bricks.grid_x; ++bx) {
+                codes[(static_cast<size_t>(bz) * bricks.grid_y + by) * bricks.grid_x + bx] = mortonCode(bz, by, bx);
+            }
+        }
+    }
+    std::vector<uint32_t> order(count);
+    std::iota(order.begin(), order.end(), 0u);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return codes[a] < codes[b]; });
+
+    bricks.slot_of.resize(count);
+    bricks.brick_origin.resize(count);
+    for (uint32_t slot = 0; slot < count; ++slot) {
+        const uint32_t linear = order[slot];
+        bricks.slot_of[linear] = slot;
+        const int bx = linear % bricks.grid_x;
+        const int by = linear / bricks.grid_x % bricks.grid_y;
+        const int bz = linear / bricks.grid_x / bricks.grid_y;
+        bricks.brick_origin[slot] = {bx * kBrickSize, by * kBrickSize, bz * kBrickSize};
+    }
+
+    bricks.neighbors.assign(count * 27, kNoBrick);
+    for (uint32_t slot = 0; slot < count; ++slot) {
+        const cv::Point3i& origin = bricks.brick_origin[slot];
+        const int bz = origin.z / kBrickSize, by = origin.y / kBrickSize, bx = origin.x / kBrickSize;
+        for (int dz = -1; dz <= 1; ++dz) {
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    const int nz = bz + dz, ny = by + dy, nx = bx + dx;
+                    if (nz < 0 || ny < 0 || nx < 0 || nz >= bricks.grid_z || ny >= bricks.grid_y ||
+                        nx >= bricks.grid_x) {
+                        continue;
+                    }
+                    bricks.neighbors[static_cast<size_t>(slot) * 27 + (dz + 1) * 9 + (dy + 1) * 3 + dx + 1] =
+                            bricks.slot_of[(static_cast<size_t>(nz) * bricks.grid_y + ny) * bricks.grid_x + nx];
+                }
+            }
+        }
+    }
+
+    bricks.cells.assign(count * kBrickVoxels, fill);
+    return bricks;
+}
+
+void storeBrickRow(BrickVolume& bricks, int z, int y, const uchar* row) {
+    // Строка проходит через кирпичи по 8 вокселей: позиция кирпича ищется один раз на отрезок
+    for (int x = 0; x < bricks.width;) {
+        const size_t cell = bricks.index(z, y, x);
+        const int run = std::min(kBrickSize - static_cast<int>(cell & 7), bricks.width - x);
+        std::copy(row + x, row + x + run, &bricks.cells[cell]);
+        x += run;
+    }
+}
+
+BrickVolume toBricks(const std::vector<cv::Mat>& volume) {
+    if (volume.empty()) return {};
+    BrickVolume bricks = makeBrickVolume(static_cast<int>(volume.size()), volume[0].rows, volume[0].cols);
+
+    // Один слой кирпичей — 8 срезов; разные слои не пересекаются по ячейкам
+    cv::parallel_for_(cv::Range(0, bricks.grid_z), [&](const cv::Range& range) {
+        for (int layer = range.start; layer < range.end; ++layer) {
+            const int z_begin = std::max(0, layer * kBrickSize - 1);
+            const int z_end = std::min(bricks.depth, (layer + 1) * kBrickSize - 1);
+            for (int z = z_begin; z < z_end; ++z) {
+                for (int y = 0; y < bricks.height; ++y) {
+                    storeBrickRow(bricks, z, y, volume[z].ptr<uchar>(y));
+                }
+            }
+        }
+    });
+    return bricks;
+}
+
+cv::Mat extractBrickSlice(const BrickVolume& bricks, int z) {
+    cv::Mat slice(bricks.height, bricks.width, CV_8UC1);
+    for (int y = 0; y < bricks.height; ++y) {
+        uchar* row = slice.ptr<uchar>(y);
+        for (int x = 0; x < bricks.width;) {
+            const size_t cell = bricks.index(z, y, x);
+            const int run = std::min(kBrickSize - static_cast<int>(cell & 7), bricks.width - x);
+            std::copy(&bricks.cells[cell], &bricks.cells[cell] + run, row + x);
+            x += run;
+        }
+    }
+    return slice;
+}
@@ -0,0 +1,207 @@
+#ifndef BRICK_VOLUME_H
+#define BRICK_VOLUME_H
+
+#include "neighborhood.h"
+#include "padded_mask.h"
+#include "scratch_arena.h"
+#include <opencv2/opencv.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Кирпич — куб 8×8×8 вокселей, 512 байт подряд; внутри кирпича порядок z → y → x
+constexpr int kBrickShift = 3;
+constexpr int kBrickSize = 1 << kBrickShift;
+constexpr int kBrickVoxels = kBrickSize * kBrickSize * kBrickSize;
+constexpr uint32_t kNoBrick = UINT32_MAX;
+
+/**
+ * @brief Объём, разбитый на кирпичи 8³, упорядоченные по Z-кривой (Мортону)
+ *
+ * Соседи вокселя почти всегда лежат в том же кирпиче (в пределах 512 байт), а
+ * соседние кирпичи — рядом в памяти, поэтому обходы с шаблоном 6/18/26 не
+ * прыгают между отдельными срезами и строками. Как и в PaddedMask, объём
+ * окружён рамкой в один воксель (значение 0), так что соседи любого вокселя
+ * объёма существуют. Ячейка — индекс в cells: позиция кирпича * 512 + смещение.
+ */
+struct BrickVolume {
+    int depth = 0, height = 0, width = 0;
+    int grid_z = 0, grid_y = 0, grid_x = 0; // кирпичей по осям с учётом рамки
+    std::vector<uint32_t> slot_of;          // (bz, by, bx) → позиция кирпича в порядке Z-кривой
+    std::vector<cv::Point3i> brick_origin;  // позиция → координаты первого вокселя кирпича (с рамкой)
+    std::vector<uint32_t> neighbors;        // позиция → 27 соседних кирпичей (kNoBrick за краем)
+    std::vector<uchar> cells;
+
+    size_t brickCount() const { return brick_origin.size(); }
+
+    // Ячейка вокселя (z, y, x); допустимы координаты рамки от -1 до размера включительно
+    size_t index(int z, int y, int x) const {
+        const int pz = z + 1, py = y + 1, px = x + 1;
+        const uint32_t slot = slot_of[((static_cast<size_t>(pz >> kBrickShift) * grid_y) + (py >> kBrickShift)) *
+                                      grid_x + (px >> kBrickShift)];
+        return (static_cast<size_t>(slot) << 9) | ((pz & 7) << 6) | ((py & 7) << 3) | (px & 7);
+    }
+
+    uchar at(int z, int y, int x) const { return cells[index(z, y, x)]; }
+
+    // Ячейка соседа по смещению; соседние кирпичи берутся из таблицы, только если сосед вне кирпича
+    size_t neighbor(size_t cell, int dz, int dy, int dx) const {
+        const uint32_t slot = static_cast<uint32_t>(cell >> 9);
+        const int local = static_cast<int>(cell & (kBrickVoxels - 1));
+        const int lz = (local >> 6) + dz, ly = ((local >> 3) & 7) + dy, lx = (local & 7) + dx;
+        uint32_t next = slot;
+        if (((lz | ly | lx) & ~7) != 0) {
+            next = neighbors[static_cast<size_t>(slot) * 27 + ((lz >> 3) + 1) * 9 + ((ly >> 3) + 1) * 3 + (lx >> 3) + 1];
+        }
+        return (static_cast<size_t>(next) << 9) | ((lz & 7) << 6) | ((ly & 7) << 3) | (lx & 7);
+    }
+
+    // Координаты вокселя объёма по ячейке
+    cv::Point3i coords(size_t cell) const {
+        const cv::Point3i& origin = brick_origin[cell >> 9];
+        const int local = static_cast<int>(cell & (kBrickVoxels - 1));
+        return {origin.x + (local & 7) - 1, origin.y + ((local >> 3) & 7) - 1, origin.z + (local >> 6) - 1};
+    }
+};
+
+// Пустой объём заданного размера: таблицы кирпичей построены, все ячейки равны fill
+BrickVolume makeBrickVolume(int depth, int height, int width, uchar fill = 0);
+
+// Копирует строку среза z в кирпичи (строки одного слоя кирпичей можно писать параллельно)
+void storeBrickRow(BrickVolume& bricks, int z, int y, const uchar* row);
+
+// Раскладывает срезы по кирпичам; слои кирпичей заполняются параллельно
+BrickVolume toBricks(const std::vector<cv::Mat>& volume);
+
+cv::Mat extractBrickSlice(const BrickVolume& bricks, int z);
+
+/**
+ * @brief Маска состояний ячеек той же разметки, что и BrickVolume
+ *
+ * Состояния те же, что у PaddedMask: рамка и ячейки за пределами объёма в
+ * неполных кирпичах — kCellOutside.
+ */
+template <typename Predicate>
+ScratchVector<uchar> buildBrickMask(const BrickVolume& bricks, Predicate is_target) {
+    ScratchVector<uchar> states(bricks.cells.size(), kCellOutside);
+    for (size_t slot = 0; slot < bricks.brickCount(); ++slot) {
+        const cv::Point3i& origin = bricks.brick_origin[slot];
+        const size_t base = slot << 9;
+        for (int lz = 0; lz < kBrickSize; ++lz) {
+            const int z = origin.z + lz - 1;
+            if (z < 0 || z >= bricks.depth) continue;
+            for (int ly = 0; ly < kBrickSize; ++ly) {
+                const int y = origin.y + ly - 1;
+                if (y < 0 || y >= bricks.height) continue;
+                const size_t row = base + (lz << 6) + (ly << 3);
+                for (int lx = 0; lx < kBrickSize; ++lx) {
+                    const int x = origin.x + lx - 1;
+                    if (x < 0 || x >= bricks.width) continue;
+                    states[row + lx] = is_target(bricks.cells[row + lx]) ? kCellTarget : kCellOther;
+                }
+            }
+        }
+    }
+    return states;
+}
+
+// Положения внутри кирпича, все 26 соседей которых лежат в том же кирпиче
+constexpr std::array<bool, kBrickVoxels> makeInteriorBrickCells() {
+    std::array<bool, kBrickVoxels> interior{};
+    for (int local = 0; local < kBrickVoxels; ++local) {
+        const int lz = local >> 6, ly = (local >> 3) & 7, lx = local & 7;
+        interior[local] = lz > 0 && lz < 7 && ly > 0 && ly < 7 && lx > 0 && lx < 7;
+    }
+    return interior;
+}
+inline constexpr std::array<bool, kBrickVoxels> kInteriorBrickCell = makeInteriorBrickCells();
+
+// Переходы к соседям для каждого из 512 положений в кирпиче: номер соседнего кирпича
+// (0..26, 13 — тот же) в старших битах и положение соседа в нём в младших 9 битах
+template <int N>
+const std::array<uint16_t, kBrickVoxels * N>& brickNeighborSteps() {
+    static const std::array<uint16_t, kBrickVoxels * N> steps = [] {
+        std::array<uint16_t, kBrickVoxels * N> table{};
+        for (int local = 0; local < kBrickVoxels; ++local) {
+            for (int i = 0; i < N; ++i) {
+                const Offset3& o = Neighborhood<N>::offsets[i];
+                const int lz = (local >> 6) + o.dz, ly = ((local >> 3) & 7) + o.dy, lx = (local & 7) + o.dx;
+                const int brick = ((lz >> 3) + 1) * 9 + ((ly >> 3) + 1) * 3 + (lx >> 3) + 1;
+                table[local * N + i] = static_cast<uint16_t>(brick << 9 | (lz & 7) << 6 | (ly & 7) << 3 | (lx & 7));
+            }
+        }
+        return table;
+    }();
+    return steps;
+}
+
+/**
+ * @brief Обход компоненты целевых ячеек маски кирпичей от seed, как floodFill для PaddedMask
+ *
+ * Для внутренних положений кирпича соседи получаются сдвигом индекса, для
+ * положений на гранях — по таблице переходов и таблице соседних кирпичей,
+ * записи которой для одного кирпича лежат рядом.
+ */
+template <int N, typename Visitor>
+FillResult brickFloodFill(const BrickVolume& bricks, ScratchVector<uchar>& states, size_t seed,
+                          ScratchVector<size_t>& stack, Visitor visit) {
+    constexpr std::array<uchar, N> faces = outsideFaces<N>();
+    const std::array<uint16_t, kBrickVoxels * N>& steps = brickNeighborSteps<N>();
+    const uint32_t* neighbors = bricks.neighbors.data();
+    uchar* cells = states.data();
+    std::array<std::ptrdiff_t, N> inner{};
+    for (int i = 0; i < N; ++i) {
+        const Offset3& o = Neighborhood<N>::offsets[i];
+        inner[i] = o.dz * kBrickSize * kBrickSize + o.dy * kBrickSize + o.dx;
+    }
+
+    FillResult result;
+    stack.clear();
+    stack.push_back(seed);
+    cells[seed] = kCellVisited;
+
+    while (!stack.empty()) {
+        const size_t current = stack.back();
+        stack.pop_back();
+        visit(current);
+        result.voxels++;
+
+        const int local = static_cast<int>(current & (kBrickVoxels - 1));
+        if (kInteriorBrickCell[local]) {
+            // Все соседи в том же кирпиче, но рамка может оказаться среди них: вокселю
+            // с координатой 0 соответствует положение 1, а дальний слой рамки при размере,
+            // не кратном восьми, попадает внутрь кирпича
+            for (int i = 0; i < N; ++i) {
+                const size_t next = current + inner[i];
+                const uchar cell = cells[next];
+                if (cell == kCellTarget) {
+                    cells[next] = kCellVisited;
+                    stack.push_back(next);
+                } else if (cell == kCellOutside) {
+                    result.touches_border = true;
+                    result.faces |= faces[i];
+                }
+            }
+            continue;
+        }
+
+        const uint32_t* around = neighbors + (current >> 9) * 27;
+        const uint16_t* step = &steps[local * N];
+        for (int i = 0; i < N; ++i) {
+            const size_t next = static_cast<size_t>(around[step[i] >> 9]) << 9 | (step[i] & (kBrickVoxels - 1));
+            const uchar cell = cells[next];
+            if (cell == kCellTarget) {
+                cells[next] = kCellVisited;
+                stack.push_back(next);
+            } else if (cell == kCellOutside) {
+                result.touches_border = true;
+                result.faces |= faces[i];
+            }
+        }
+    }
+    result.touches_z0 = (result.faces & kFaceZ0) != 0;
+    return result;
+}
+
+#endif
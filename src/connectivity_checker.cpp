@@ -1,70 +1,68 @@
 #include "connectivity_checker.h"
+#include "padded_mask.h"
+#include "project_paths.h"
+#include "results_store.h"
+#include <algorithm>
 #include <filesystem>
 #include <iostream>
-#include <regex>
-#include <queue>
+#include <array>
 #include <opencv2/opencv.hpp>
 #include <vector>
-#include <map>
 #include <nlohmann/json.hpp>
 #include <fstream>
 
 namespace fs = std::filesystem;
 
-std::vector<cv::Mat> loadSlices(const std::string& folder) {
-    std::vector<std::pair<int, cv::Mat>> files;
-    std::regex re("slice_(\\d+)\\.png");
-
-    try {
-        for (const auto& entry : fs::directory_iterator(folder)) {
-            if (entry.path().extension() == ".png") {
-                std::string filename = entry.path().filename().string();
-                std::smatch match;
-                if (std::regex_match(filename, match, re)) {
-                    int index = std::stoi(match[1]);
-                    cv::Mat img = cv::imread(entry.path().string(), cv::IMREAD_GRAYSCALE);
-                    if (!img.empty()) {
-                        files.emplace_back(index, img);
-                    }
-                }
+// Отмена проверяется и прогресс сообщается внутри обхода раз в столько вокселей
+constexpr size_t kControlVoxels = size_t(1) << 16;
+
+template <int N>
+static bool is3DConnectedImpl(const std::vector<cv::Mat>& volume, uchar body_value, const AnalysisControl& control) {
+    ScratchArena::Scope scratch;
+    PaddedMask mask = buildPaddedMask(volume, [body_value](uchar v) { return v == body_value; });
+    ScratchVector<size_t> stack;
+    stack.reserve(mask.plane);
+
+    // Прогресс обхода — число достигнутых вокселей в пересчёте на срезы
+    ProgressUpdate update{"связность", 0, mask.depth};
+    const size_t slice_voxels = static_cast<size_t>(mask.height) * mask.width;
+    size_t visited = 0;
+    auto visit = [&](size_t) {
+        if (++visited % kControlVoxels != 0) return;
+        update.slices_done = static_cast<int>(std::min<size_t>(visited / slice_voxels, mask.depth - 1));
+        control.report(update);
+    };
+
+    // Находим первую точку тела в первом слое
+    bool found = false;
+    for (int y = 0; y < mask.height && !found; ++y) {
+        for (int x = 0; x < mask.width && !found; ++x) {
+            size_t idx = mask.index(0, y, x);
+            if (mask.cells[idx] == kCellTarget) {
+                floodFill<N>(mask, idx, stack, visit);
+                found = true;
             }
         }
-    } catch (const fs::filesystem_error& e) {
-        std::cerr << "Error accessing directory: " << e.what() << std::endl;
-        return {};
     }
+    update.slices_done = mask.depth;
+    control.report(update);
 
-    if (files.empty()) {
-        std::cerr << "No valid slices found in folder: " << folder << std::endl;
-        return {};
-    }
-
-    // Сортируем по индексу
-    std::sort(files.begin(), files.end(),
-              [](const auto& a, const auto& b) { return a.first < b.first; });
+    if (!found) return false; // Нет тела вообще
 
-    // Проверяем размеры всех изображений
-    cv::Size first_size = files[0].second.size();
-    for (const auto& [index, img] : files) {
-        if (img.size() != first_size) {
-            std::cerr << "Error: Slice " << index << " has different size" << std::endl;
-            return {};
+    // Проверяем есть ли непосещенные точки тела в последнем слое
+    for (int y = 0; y < mask.height; ++y) {
+        for (int x = 0; x < mask.width; ++x) {
+            if (mask.cells[mask.index(mask.depth - 1, y, x)] == kCellTarget) {
+                return false;
+            }
         }
     }
 
-    std::vector<cv::Mat> slices;
-    slices.reserve(files.size());
-    for (auto& [index, img] : files) {
-        slices.push_back(std::move(img));
-    }
-
-    std::cout << "Загрузка " << slices.size() << " срезов из " << folder
-              << " (размер: " << first_size.height << "×" << first_size.width << ")" << std::endl;
-
-    return slices;
+    return true;
 }
 
-bool is3DConnected(const std::vector<cv::Mat>& volume, uchar body_value) {
+bool is3DConnected(const std::vector<cv::Mat>& volume, uchar body_value, Connectivity connectivity,
+                   const AnalysisControl& control) {
     if (volume.empty()) {
         std::cerr << "Error: Empty volume" << std::endl;
         return false;
@@ -82,141 +80,68 @@ bool is3DConnected(const std::vector<cv::Mat>& volume, uchar body_value) {
         }
     }
 
-    // Используем BFS для обхода (более эффективен для больших объемов)
-    std::vector<std::vector<std::vector<bool>>> visited(
-            Z, std::vector<std::vector<bool>>(Y, std::vector<bool>(X, false)));
-
-    std::queue<std::tuple<int, int, int>> q;
-
-    // Находим первую точку тела в первом слое
-    bool found = false;
-    for (int y = 0; y < Y && !found; ++y) {
-        for (int x = 0; x < X && !found; ++x) {
-            if (volume[0].at<uchar>(y, x) == body_value) {
-                q.emplace(0, y, x);
-                visited[0][y][x] = true;
-                found = true;
-            }
-        }
-    }
-
-    if (!found) return false; // Нет тела вообще
-
-    // 6-связный обход (только соседние воксели)
-    const int dz[] = {-1, 1, 0, 0, 0, 0};
-    const int dy[] = {0, 0, -1, 1, 0, 0};
-    const int dx[] = {0, 0, 0, 0, -1, 1};
-
-    while (!q.empty()) {
-        auto [z, y, x] = q.front();
-        q.pop();
-
-        for (int i = 0; i < 6; ++i) {
-            int nz = z + dz[i];
-            int ny = y + dy[i];
-            int nx = x + dx[i];
-
-            if (nz >= 0 && nz < Z && ny >= 0 && ny < Y && nx >= 0 && nx < X) {
-                if (!visited[nz][ny][nx] && volume[nz].at<uchar>(ny, nx) == body_value) {
-                    visited[nz][ny][nx] = true;
-                    q.emplace(nz, ny, nx);
-                }
-            }
-        }
-    }
-
-    // Проверяем есть ли непосещенные точки тела в последнем слое
-    for (int y = 0; y < Y; ++y) {
-        for (int x = 0; x < X; ++x) {
-            if (volume[Z-1].at<uchar>(y, x) == body_value && !visited[Z-1][y][x]) {
-                return false;
-            }
-        }
-    }
-
-    return true;
+    return dispatchConnectivity(connectivity, [&](auto n) {
+        return is3DConnectedImpl<decltype(n)::value>(volume, body_value, control);
+    });
 }
 
-PorosityStats computePorosityStats(const std::vector<cv::Mat>& volume, uchar body_value) {
-    int depth = volume.size();
-    int height = volume[0].rows;
-    int width = volume[0].cols;
+template <int N>
+static PorosityStats computePorosityStatsImpl(const std::vector<cv::Mat>& volume, uchar body_value,
+                                              const AnalysisControl& control) {
+    ScratchArena::Scope scratch;
+    PaddedMask mask = buildPaddedMask(volume, [body_value](uchar v) { return v != body_value; });
+    ScratchVector<size_t> stack;
+    stack.reserve(mask.plane);
 
-    std::vector<std::vector<std::vector<int>>> visited(depth,
-                                                       std::vector<std::vector<int>>(height, std::vector<int>(width, 0)));
-
-    int total_voxels = 0;
-    int empty_voxels = 0;
+    size_t total_voxels = static_cast<size_t>(mask.depth) * mask.height * mask.width;
+    size_t empty_voxels = 0;
     int pore_count = 0;
 
-    auto inBounds = [&](int z, int y, int x) {
-        return 0 <= z && z < depth && 0 <= y && y < height && 0 <= x && x < width;
+    // Пустые воксели просмотренных срезов: к концу среза все они уже посещены обходами
+    size_t scanned_empty = 0;
+    ProgressUpdate update{"пористость", 0, mask.depth};
+    size_t visited = 0;
+    auto visit = [&](size_t) {
+        if (++visited % kControlVoxels == 0) control.report(update);
     };
 
-    // Шаблон направлений для 26-связности
-    const int dz[] = {-1, -1, -1, 0, 0, 0, 1, 1, 1};
-    const int dy[] = {-1,  0,  1,-1, 0, 1,-1, 0, 1};
-    const int dx[] = {-1,  0,  1,-1, 0, 1,-1, 0, 1};
-
     // Обход по всем вокселям
-    for (int z = 0; z < depth; ++z) {
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                uchar val = volume[z].at<uchar>(y, x);
-                total_voxels++;
-                if (val != body_value && visited[z][y][x] == 0) {
-                    // Начинаем поиск пустой компоненты
-                    bool touches_border = (z == 0 || z == depth - 1 ||
-                                           y == 0 || y == height - 1 ||
-                                           x == 0 || x == width - 1);
-
-                    int local_empty_count = 0;
-                    std::queue<std::tuple<int, int, int>> q;
-                    q.push({z, y, x});
-                    visited[z][y][x] = 1;
-
-                    while (!q.empty()) {
-                        auto [cz, cy, cx] = q.front(); q.pop();
-                        local_empty_count++;
-
-                        for (int i = 0; i < 9; ++i) {
-                            for (int j = 0; j < 3; ++j) {
-                                int nz = cz + dz[i];
-                                int ny = cy + dy[i];
-                                int nx = cx + dx[j];
-
-                                if (!inBounds(nz, ny, nx)) continue;
-                                if (visited[nz][ny][nx]) continue;
-                                if (volume[nz].at<uchar>(ny, nx) == body_value) continue;
-
-                                if (nz == 0 || nz == depth - 1 ||
-                                    ny == 0 || ny == height - 1 ||
-                                    nx == 0 || nx == width - 1)
-                                    touches_border = true;
-
-                                visited[nz][ny][nx] = 1;
-                                q.push({nz, ny, nx});
-                            }
-                        }
-                    }
-
-                    empty_voxels += local_empty_count;
-                    if (!touches_border) {
-                        pore_count++;
-                    }
+    for (int z = 0; z < mask.depth; ++z) {
+        for (int y = 0; y < mask.height; ++y) {
+            for (int x = 0; x < mask.width; ++x) {
+                size_t idx = mask.index(z, y, x);
+                if (mask.cells[idx] == kCellOther) continue;
+                scanned_empty++;
+                if (mask.cells[idx] != kCellTarget) continue;
+
+                // Пустая компонента, не касающаяся границы объёма, — внутренняя пора
+                FillResult component = floodFill<N>(mask, idx, stack, visit);
+                empty_voxels += component.voxels;
+                if (!component.touches_border) {
+                    pore_count++;
                 }
             }
         }
+        update.slices_done = z + 1;
+        update.components = pore_count;
+        update.porosity = static_cast<double>(scanned_empty) / (static_cast<size_t>(z + 1) * mask.height * mask.width);
+        control.report(update);
     }
 
     double porosity = (double)empty_voxels / total_voxels;
     return {porosity, pore_count};
 }
 
+PorosityStats computePorosityStats(const std::vector<cv::Mat>& volume, uchar body_value, Connectivity connectivity,
+                                   const AnalysisControl& control) {
+    return dispatchConnectivity(connectivity, [&](auto n) {
+        return computePorosityStatsImpl<decltype(n)::value>(volume, body_value, control);
+    });
+}
+
 
-void createBorderedCollageWithContours(const std::vector<cv::Mat>& slices,
-                                       const std::string& folder_name,
-                                       const std::string& project_root) {
+cv::Mat renderCollageWithContours(const std::vector<cv::Mat>& slices, const std::string& folder_name,
+                                  const AnalysisControl& control) {
     const int cols = 10;
     const int border_size = 1;
     const int slice_size = slices[0].rows;
@@ -231,6 +156,7 @@ void createBorderedCollageWithContours(const std::vector<cv::Mat>& slices,
     bool is_disconnected_case = folder_name.find("disconnected") != std::string::npos;
 
     for (size_t i = 0; i < slices.size(); ++i) {
+        control.report({"коллаж", static_cast<int>(i), static_cast<int>(slices.size())});
         int row = i / cols;
         int col = i % cols;
         int y = row * (slice_size + border_size);
@@ -273,133 +199,251 @@ void createBorderedCollageWithContours(const std::vector<cv::Mat>& slices,
         }
     }
 
+    control.report({"коллаж", static_cast<int>(slices.size()), static_cast<int>(slices.size())});
+    return collage;
+}
+
+std::string saveCollageWithContours(const cv::Mat& collage, const std::string& folder_name,
+                                    const std::string& project_root) {
     std::string out_dir = project_root + "/data/output/collages/";
     fs::create_directories(out_dir);
     std::string output_path = out_dir + folder_name + "_collage_with_contours.png";
     cv::imwrite(output_path, collage);
-
-    std::cout << "\nКоллаж с границами сохранён в: " << output_path << std::endl;
+    return output_path;
 }
 
 
 
-void detectFloatingIslands(const std::vector<cv::Mat>& volume, uchar body_value, int min_area) {
-    if (volume.empty()) return;
+template <int N>
+static std::vector<ComponentInfo> labelComponents3DImpl(const std::vector<cv::Mat>& volume, uchar body_value,
+                                                        const AnalysisControl& control) {
+    ScratchArena::Scope scratch;
+    PaddedMask mask = buildPaddedMask(volume, [body_value](uchar v) { return v == body_value; });
+    ScratchVector<size_t> stack;
+    stack.reserve(mask.plane);
+    std::vector<ComponentInfo> components;
+
+    ProgressUpdate update{"висячие 3D", 0, mask.depth};
+    size_t visited = 0;
+    auto visit = [&](size_t) {
+        if (++visited % kControlVoxels == 0) control.report(update);
+    };
+
+    for (int z = 0; z < mask.depth; ++z) {
+        for (int y = 0; y < mask.height; ++y) {
+            for (int x = 0; x < mask.width; ++x) {
+                size_t idx = mask.index(z, y, x);
+                if (mask.cells[idx] != kCellTarget) continue;
+
+                FillResult component = floodFill<N>(mask, idx, stack, visit);
+                components.push_back({component.voxels, component.touches_z0});
+            }
+        }
+        update.slices_done = z + 1;
+        update.components = static_cast<long long>(components.size());
+        control.report(update);
+    }
 
-    for (int z = 0; z < volume.size(); ++z) {
-        cv::Mat binary;
-        cv::compare(volume[z], body_value, binary, cv::CMP_EQ);
+    return components;
+}
 
-        cv::Mat labels, stats, centroids;
-        int n_components = cv::connectedComponentsWithStats(binary, labels, stats, centroids, 8);
+std::vector<ComponentInfo> labelComponents3D(const std::vector<cv::Mat>& volume, uchar body_value,
+                                             Connectivity connectivity, const AnalysisControl& control) {
+    if (volume.empty()) return {};
+    return dispatchConnectivity(connectivity, [&](auto n) {
+        return labelComponents3DImpl<decltype(n)::value>(volume, body_value, control);
+    });
+}
 
-        for (int i = 1; i < n_components; ++i) {
-            int area = stats.at<int>(i, cv::CC_STAT_AREA);
-            if (area < min_area) {
-                std::cout << "Обнаружены висячие участки на срезах: " << z
-                          << ", связная область " << i
-                          << ", площадь: " << area << " пикселей" << std::endl;
+int countFloatingComponents(const std::vector<ComponentInfo>& components, int min_voxels, bool verbose,
+                            std::ostream& out) {
+    int floating_count = 0;
+    for (size_t i = 0; i < components.size(); ++i) {
+        const ComponentInfo& component = components[i];
+        if (!component.touches_z0 && component.voxels >= static_cast<size_t>(min_voxels)) {
+            if (verbose) {
+                out << "Обнаружены висячие участки в объёме: " << i + 1
+                    << " – Объём: " << component.voxels << " вокселей" << std::endl;
             }
+            floating_count++;
         }
     }
+    return floating_count;
 }
 
-struct Vec3 {
-    int z, y, x;
-    Vec3(int z_, int y_, int x_) : z(z_), y(y_), x(x_) {}
-};
+int detectFloatingIslands3D(const std::vector<cv::Mat>& volume, uchar body_value, int min_voxels,
+                            Connectivity connectivity, std::ostream& out, const AnalysisControl& control) {
+    return countFloatingComponents(labelComponents3D(volume, body_value, connectivity, control), min_voxels, true,
+                                   out);
+}
 
-bool isInside(int z, int y, int x, int D, int H, int W) {
-    return z >= 0 && z < D && y >= 0 && y < H && x >= 0 && x < W;
+// Обход вокселей объёма в кирпичах в порядке z → y → x: на каждые 8 вокселей строки — один поиск кирпича
+template <typename F>
+static void forEachBrickCell(const BrickVolume& volume, int z, F f) {
+    for (int y = 0; y < volume.height; ++y) {
+        for (int x = 0; x < volume.width;) {
+            const size_t cell = volume.index(z, y, x);
+            const int run = std::min(kBrickSize - static_cast<int>(cell & 7), volume.width - x);
+            for (int i = 0; i < run; ++i) f(cell + i);
+            x += run;
+        }
+    }
 }
 
-int detectFloatingIslands3D(const std::vector<cv::Mat>& volume, uchar body_value, int min_voxels) {
-    const int D = volume.size();
-    const int H = volume[0].rows;
-    const int W = volume[0].cols;
+template <int N>
+static bool is3DConnectedBricksImpl(const BrickVolume& volume, uchar body_value, const AnalysisControl& control) {
+    ScratchArena::Scope scratch;
+    ScratchVector<uchar> states = buildBrickMask(volume, [body_value](uchar v) { return v == body_value; });
+    ScratchVector<size_t> stack;
+    stack.reserve(static_cast<size_t>(volume.height) * volume.width);
+
+    ProgressUpdate update{"связность", 0, volume.depth};
+    const size_t slice_voxels = static_cast<size_t>(volume.height) * volume.width;
+    size_t visited = 0;
+    auto visit = [&](size_t) {
+        if (++visited % kControlVoxels != 0) return;
+        update.slices_done = static_cast<int>(std::min<size_t>(visited / slice_voxels, volume.depth - 1));
+        control.report(update);
+    };
+
+    bool found = false;
+    forEachBrickCell(volume, 0, [&](size_t cell) {
+        if (found || states[cell] != kCellTarget) return;
+        brickFloodFill<N>(volume, states, cell, stack, visit);
+        found = true;
+    });
+    update.slices_done = volume.depth;
+    control.report(update);
+    if (!found) return false;
+
+    bool connected = true;
+    forEachBrickCell(volume, volume.depth - 1, [&](size_t cell) {
+        if (states[cell] == kCellTarget) connected = false;
+    });
+    return connected;
+}
 
-    cv::Mat1i labels(D, H * W, int(0));
-    int current_label = 1;
+bool is3DConnected(const BrickVolume& volume, uchar body_value, Connectivity connectivity,
+                   const AnalysisControl& control) {
+    if (volume.depth == 0) {
+        std::cerr << "Error: Empty volume" << std::endl;
+        return false;
+    }
+    return dispatchConnectivity(connectivity, [&](auto n) {
+        return is3DConnectedBricksImpl<decltype(n)::value>(volume, body_value, control);
+    });
+}
 
-    std::map<int, std::vector<Vec3>> label_voxels;
+template <int N>
+static PorosityStats computePorosityStatsBricksImpl(const BrickVolume& volume, uchar body_value,
+                                                    const AnalysisControl& control) {
+    ScratchArena::Scope scratch;
+    ScratchVector<uchar> states = buildBrickMask(volume, [body_value](uchar v) { return v != body_value; });
+    ScratchVector<size_t> stack;
+    stack.reserve(static_cast<size_t>(volume.height) * volume.width);
 
-    const std::vector<Vec3> directions = {
-            {0, 0, 1}, {0, 0, -1}, {0, 1, 0}, {0, -1, 0},
-            {1, 0, 0}, {-1, 0, 0}
+    const size_t slice_voxels = static_cast<size_t>(volume.height) * volume.width;
+    size_t empty_voxels = 0, scanned_empty = 0;
+    int pore_count = 0;
+    ProgressUpdate update{"пористость", 0, volume.depth};
+    size_t visited = 0;
+    auto visit = [&](size_t) {
+        if (++visited % kControlVoxels == 0) control.report(update);
     };
 
-    for (int z = 0; z < D; ++z) {
-        for (int y = 0; y < H; ++y) {
-            for (int x = 0; x < W; ++x) {
-                int idx = y * W + x;
-                if (volume[z].at<uchar>(y, x) == body_value && labels(z, idx) == 0) {
-                    std::queue<Vec3> q;
-                    q.emplace(z, y, x);
-                    labels(z, idx) = current_label;
-                    label_voxels[current_label].emplace_back(z, y, x);
-
-                    while (!q.empty()) {
-                        Vec3 v = q.front(); q.pop();
-                        for (const Vec3& d : directions) {
-                            int nz = v.z + d.z;
-                            int ny = v.y + d.y;
-                            int nx = v.x + d.x;
-                            if (isInside(nz, ny, nx, D, H, W) &&
-                                volume[nz].at<uchar>(ny, nx) == body_value &&
-                                labels(nz, ny * W + nx) == 0) {
-                                labels(nz, ny * W + nx) = current_label;
-                                q.emplace(nz, ny, nx);
-                                label_voxels[current_label].emplace_back(nz, ny, nx);
-                            }
-                        }
-                    }
-                    current_label++;
-                }
-            }
-        }
+    for (int z = 0; z < volume.depth; ++z) {
+        forEachBrickCell(volume, z, [&](size_t cell) {
+            if (states[cell] == kCellOther) return;
+            scanned_empty++;
+            if (states[cell] != kCellTarget) return;
+            FillResult component = brickFloodFill<N>(volume, states, cell, stack, visit);
+            empty_voxels += component.voxels;
+            if (!component.touches_border) pore_count++;
+        });
+        update.slices_done = z + 1;
+        update.components = pore_count;
+        update.porosity = static_cast<double>(scanned_empty) / (slice_voxels * (z + 1));
+        control.report(update);
     }
 
-    int floating_count = 0;
+    return {static_cast<double>(empty_voxels) / (slice_voxels * volume.depth), pore_count};
+}
 
-    // Используем обычный цикл без structured bindings для совместимости
-    for (const auto& pair : label_voxels) {
-        int label = pair.first;
-        const auto& voxels = pair.second;
+PorosityStats computePorosityStats(const BrickVolume& volume, uchar body_value, Connectivity connectivity,
+                                   const AnalysisControl& control) {
+    if (volume.depth == 0) return {0.0, 0};
+    return dispatchConnectivity(connectivity, [&](auto n) {
+        return computePorosityStatsBricksImpl<decltype(n)::value>(volume, body_value, control);
+    });
+}
 
-        bool touches_z0 = false;
-        for (const auto& v : voxels) {
-            if (v.z == 0) {
-                touches_z0 = true;
-                break;
-            }
-        }
+template <int N>
+static std::vector<ComponentInfo> labelComponents3DBricksImpl(const BrickVolume& volume, uchar body_value,
+                                                              const AnalysisControl& control) {
+    ScratchArena::Scope scratch;
+    ScratchVector<uchar> states = buildBrickMask(volume, [body_value](uchar v) { return v == body_value; });
+    ScratchVector<size_t> stack;
+    stack.reserve(static_cast<size_t>(volume.height) * volume.width);
+    std::vector<ComponentInfo> components;
+
+    ProgressUpdate update{"висячие 3D", 0, volume.depth};
+    size_t visited = 0;
+    auto visit = [&](size_t) {
+        if (++visited % kControlVoxels == 0) control.report(update);
+    };
 
-        if (!touches_z0 && voxels.size() >= static_cast<size_t>(min_voxels)) {
-            std::cout << "Обнаружены висячие участки в объёме: " << label
-                      << " – Объём: " << voxels.size() << " вокселей" << std::endl;
-            floating_count++;
-        }
+    for (int z = 0; z < volume.depth; ++z) {
+        forEachBrickCell(volume, z, [&](size_t cell) {
+            if (states[cell] != kCellTarget) return;
+            FillResult component = brickFloodFill<N>(volume, states, cell, stack, visit);
+            components.push_back({component.voxels, component.touches_z0});
+        });
+        update.slices_done = z + 1;
+        update.components = static_cast<long long>(components.size());
+        control.report(update);
     }
+    return components;
+}
 
-    return floating_count;
+std::vector<ComponentInfo> labelComponents3D(const BrickVolume& volume, uchar body_value, Connectivity connectivity,
+                                             const AnalysisControl& control) {
+    if (volume.depth == 0) return {};
+    return dispatchConnectivity(connectivity, [&](auto n) {
+        return labelComponents3DBricksImpl<decltype(n)::value>(volume, body_value, control);
+    });
 }
 
-void compareWithReferenceMetrics(const std::string& cube_name, bool is_connected, const PorosityStats& stats, int floating_3d_count) {
-    std::ifstream in("../src/reference_metrics.json");
-    if (!in) {
-        std::cerr << "❌ Не удалось открыть reference_metrics.json" << std::endl;
-        return;
-    }
+// Эталонные метрики читаются один раз за процесс, в том числе при пакетном анализе
+static const nlohmann::json& referenceMetrics() {
+    static const nlohmann::json reference = [] {
+        nlohmann::json ref;
+        std::ifstream in(projectPath("src/reference_metrics.json"));
+        if (!in) {
+            std::cerr << "❌ Не удалось открыть reference_metrics.json" << std::endl;
+            return ref;
+        }
+        try {
+            in >> ref;
+        } catch (const nlohmann::json::exception& e) {
+            std::cerr << "❌ Некорректный reference_metrics.json: " << e.what() << std::endl;
+            ref = nlohmann::json();
+        }
+        return ref;
+    }();
+    return reference;
+}
 
-    nlohmann::json ref;
-    in >> ref;
+void compareWithReferenceMetrics(const std::string& cube_name, bool is_connected, const PorosityStats& stats,
+                                 int floating_3d_count, std::ostream& out) {
+    const nlohmann::json& ref = referenceMetrics();
+    if (ref.is_null()) return;
 
     if (!ref.contains(cube_name)) {
         std::cerr << "⚠️ Нет эталонных метрик для фигуры: " << cube_name << std::endl;
         return;
     }
 
-    auto j = ref[cube_name];
+    const auto& j = ref[cube_name];
 
     int internal_pores_ref = j.value("internal_pores", 0);
     int floating_parts_ref = j.value("floating_parts", 0);
@@ -415,33 +459,26 @@ void compareWithReferenceMetrics(const std::string& cube_name, bool is_connected
     bool all_ok = porosity_match && connected_match && internal_pores_match && floating_parts_match;
 
     // === Печать в консоль ===
-    std::cout << "\n🔎 Сравнение с эталонными метриками:\n";
-    std::cout << "• Связность: " << (connected_match ? "✅" : "❌")
-              << " (ожидалось: " << (connected_ref ? "да" : "нет") << ")\n";
+    out << "\n🔎 Сравнение с эталонными метриками:\n";
+    out << "• Связность: " << (connected_match ? "✅" : "❌")
+        << " (ожидалось: " << (connected_ref ? "да" : "нет") << ")\n";
     if (porosity_ref >= 0.0) {
-        std::cout << "• Пористость: " << stats.porosity
-                  << " (ожидалось: " << porosity_ref << ") "
-                  << (porosity_match ? "✅" : "❌")
-                  << " (Δ = " << porosity_diff << ")\n";
+        out << "• Пористость: " << stats.porosity
+            << " (ожидалось: " << porosity_ref << ") "
+            << (porosity_match ? "✅" : "❌")
+            << " (Δ = " << porosity_diff << ")\n";
     } else {
-        std::cout << "• Пористость: " << stats.porosity << " (эталон отсутствует) ⚠️\n";
-    }
-    std::cout << "• Внутренних пор: " << stats.pore_count
-              << " (ожидалось: " << internal_pores_ref << ") "
-              << (internal_pores_match ? "✅" : "❌") << "\n";
-    std::cout << "• Висячих тел: " << floating_3d_count
-              << " (ожидалось: " << floating_parts_ref << ") "
-              << (floating_parts_match ? "✅" : "❌") << "\n";
-
-    // === Сохраняем в JSON ===
-    nlohmann::json result;
-    std::ifstream comp_in("../data/output/results/" + cube_name + "_result.json");
-    if (comp_in) {
-        comp_in >> result;
-        comp_in.close();
+        out << "• Пористость: " << stats.porosity << " (эталон отсутствует) ⚠️\n";
     }
-
-    result[cube_name] = {
+    out << "• Внутренних пор: " << stats.pore_count
+        << " (ожидалось: " << internal_pores_ref << ") "
+        << (internal_pores_match ? "✅" : "❌") << "\n";
+    out << "• Висячих тел: " << floating_3d_count
+        << " (ожидалось: " << floating_parts_ref << ") "
+        << (floating_parts_match ? "✅" : "❌") << "\n";
+
+    // === Сохраняем в хранилище результатов ===
+    appendResultRecord(defaultResultsDir(), cube_name, "reference_check", {
             {"matches", all_ok},
             {"connected_match", connected_match},
             {"porosity_match", porosity_match},
@@ -454,9 +491,9 @@ void compareWithReferenceMetrics(const std::string& cube_name, bool is_connected
                                 {"internal_pores", stats.pore_count},
                                 {"floating_parts", floating_3d_count}
                         }}
-    };
+    });
+}
 
-    std::string output_path = "../data/output/results/" + cube_name + "_result.json";
-    std::ofstream out(output_path);
-    out << std::setw(4) << result << std::endl;
+void saveResultSection(const std::string& cube_name, const std::string& section, const nlohmann::json& data) {
+    appendResultRecord(defaultResultsDir(), cube_name, section, data);
 }
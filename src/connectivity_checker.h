@@ -1,25 +1,66 @@
 #ifndef CONNECTIVITY_CHECKER_H
 #define CONNECTIVITY_CHECKER_H
 
+#include "analysis_progress.h"
+#include "brick_volume.h"
+#include "neighborhood.h"
+#include "stack_loader.h"
 #include <opencv2/opencv.hpp>
+#include <iostream>
+#include <nlohmann/json.hpp>
 #include <string>
 #include <vector>
 
-std::vector<cv::Mat> loadSlices(const std::string& folder);
-bool is3DConnected(const std::vector<cv::Mat>& volume, uchar body_value);
+// Ядра анализа принимают AnalysisControl: сообщают прогресс по срезам и при отмене
+// бросают AnalysisCancelled (проверка между срезами и каждые 64K вокселей обхода)
+bool is3DConnected(const std::vector<cv::Mat>& volume, uchar body_value,
+                   Connectivity connectivity = Connectivity::Six, const AnalysisControl& control = {});
 
 struct PorosityStats {
     double porosity;
     int pore_count;
 };
 
-PorosityStats computePorosityStats(const std::vector<cv::Mat>& volume, uchar body_value);
-void detectFloatingIslands(const std::vector<cv::Mat>& volume, uchar body_value, int min_area = 30);
-int detectFloatingIslands3D(const std::vector<cv::Mat>& volume, uchar body_value, int min_voxels = 10);
-void createBorderedCollageWithContours(const std::vector<cv::Mat>& slices,
-                                       const std::string& folder_name,
-                                       const std::string& project_root);
-void compareWithReferenceMetrics(const std::string& cube_name, bool is_connected, const PorosityStats& stats, int floating3DCount);
+PorosityStats computePorosityStats(const std::vector<cv::Mat>& volume, uchar body_value,
+                                   Connectivity connectivity = Connectivity::TwentySix,
+                                   const AnalysisControl& control = {});
+// Связная компонента тела в 3D: номер компоненты — индекс в таблице + 1 (порядок обхода z → y → x)
+struct ComponentInfo {
+    size_t voxels;
+    bool touches_z0;
+};
+
+// Наименьший объём висячей компоненты по умолчанию, в вокселях; общий для всех режимов
+constexpr int kFloatingMinVoxels = 10;
+
+std::vector<ComponentInfo> labelComponents3D(const std::vector<cv::Mat>& volume, uchar body_value,
+                                             Connectivity connectivity = Connectivity::Six,
+                                             const AnalysisControl& control = {});
+// Число компонент, не касающихся z == 0 и содержащих не менее min_voxels вокселей
+int countFloatingComponents(const std::vector<ComponentInfo>& components, int min_voxels, bool verbose = false,
+                            std::ostream& out = std::cout);
+int detectFloatingIslands3D(const std::vector<cv::Mat>& volume, uchar body_value, int min_voxels = kFloatingMinVoxels,
+                            Connectivity connectivity = Connectivity::Six, std::ostream& out = std::cout,
+                            const AnalysisControl& control = {});
+// Те же анализы для объёма в кирпичах 8³: результаты (и порядок компонент) совпадают
+bool is3DConnected(const BrickVolume& volume, uchar body_value, Connectivity connectivity = Connectivity::Six,
+                   const AnalysisControl& control = {});
+PorosityStats computePorosityStats(const BrickVolume& volume, uchar body_value,
+                                   Connectivity connectivity = Connectivity::TwentySix,
+                                   const AnalysisControl& control = {});
+std::vector<ComponentInfo> labelComponents3D(const BrickVolume& volume, uchar body_value,
+                                             Connectivity connectivity = Connectivity::Six,
+                                             const AnalysisControl& control = {});
+// Коллаж срезов с контурами пор (и тел для наборов disconnected), BGR
+cv::Mat renderCollageWithContours(const std::vector<cv::Mat>& slices, const std::string& folder_name,
+                                  const AnalysisControl& control = {});
+// Кодирует коллаж в PNG в data/output/collages/ и возвращает путь к файлу
+std::string saveCollageWithContours(const cv::Mat& collage, const std::string& folder_name,
+                                    const std::string& project_root);
+void compareWithReferenceMetrics(const std::string& cube_name, bool is_connected, const PorosityStats& stats,
+                                 int floating3DCount, std::ostream& out = std::cout);
+// Дописывает раздел section результатов набора в хранилище результатов (results_store.h)
+void saveResultSection(const std::string& cube_name, const std::string& section, const nlohmann::json& data);
 
 
 
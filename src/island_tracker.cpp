@@ -0,0 +1,226 @@
+#include "island_tracker.h"
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+namespace {
+
+// Перекрытие острова a на срезе z с островом b на срезе z + 1 (метки connectedComponents)
+struct Overlap {
+    int a, b;
+    int pixels;
+};
+
+// Пары меток по совпадающим пикселям; серии одинаковых пар сворачиваются до одной записи
+std::vector<Overlap> countOverlaps(const cv::Mat& lower, const cv::Mat& upper) {
+    std::vector<Overlap> runs;
+    for (int y = 0; y < lower.rows; ++y) {
+        const int* a = lower.ptr<int>(y);
+        const int* b = upper.ptr<int>(y);
+        for (int x = 0; x < lower.cols; ++x) {
+            if (a[x] == 0 || b[x] == 0) continue;
+            if (!runs.empty() && runs.back().a == a[x] && runs.back().b == b[x]) {
+                runs.back().pixels++;
+            } else {
+                runs.push_back({a[x], b[x], 1});
+            }
+        }
+    }
+
+    std::sort(runs.begin(), runs.end(), [](const Overlap& l, const Overlap& r) {
+        return std::tie(l.a, l.b) < std::tie(r.a, r.b);
+    });
+    std::vector<Overlap> merged;
+    for (const Overlap& run : runs) {
+        if (!merged.empty() && merged.back().a == run.a && merged.back().b == run.b) {
+            merged.back().pixels += run.pixels;
+        } else {
+            merged.push_back(run);
+        }
+    }
+    return merged;
+}
+
+void appendToTrack(IslandTrack& track, const SliceIsland& island) {
+    track.last_slice = island.slice;
+    track.areas.push_back(island.area);
+    track.centroids.push_back(island.centroid);
+}
+
+// Продолжает треки островами среза z + 1; острова без пары начинают новые треки
+void linkSlices(std::vector<SliceIsland>& lower, std::vector<SliceIsland>& upper, std::vector<Overlap> overlaps,
+                std::vector<IslandTrack>& tracks) {
+    std::vector<int> lower_links(lower.size(), 0), upper_links(upper.size(), 0);
+    for (const Overlap& overlap : overlaps) {
+        lower_links[overlap.a - 1]++;
+        upper_links[overlap.b - 1]++;
+    }
+
+    std::sort(overlaps.begin(), overlaps.end(), [](const Overlap& l, const Overlap& r) {
+        return std::tie(r.pixels, l.a, l.b) < std::tie(l.pixels, r.a, r.b);
+    });
+    std::vector<uchar> lower_used(lower.size(), 0);
+    for (const Overlap& overlap : overlaps) {
+        SliceIsland& below = lower[overlap.a - 1];
+        SliceIsland& above = upper[overlap.b - 1];
+        if (lower_used[overlap.a - 1] || above.track >= 0) continue;
+        lower_used[overlap.a - 1] = 1;
+        above.track = below.track;
+        appendToTrack(tracks[above.track], above);
+    }
+
+    for (size_t i = 0; i < lower.size(); ++i) {
+        if (lower_links[i] > 1) tracks[lower[i].track].splits++;
+    }
+    for (size_t i = 0; i < upper.size(); ++i) {
+        SliceIsland& island = upper[i];
+        if (island.track < 0) {
+            island.track = static_cast<int>(tracks.size());
+            tracks.emplace_back();
+            tracks.back().first_slice = island.slice;
+            appendToTrack(tracks.back(), island);
+        }
+        if (upper_links[i] > 1) tracks[island.track].merges++;
+    }
+}
+
+} // namespace
+
+double IslandTrack::drift() const {
+    if (centroids.size() < 2) return 0.0;
+    return std::hypot(centroids.back().x - centroids.front().x, centroids.back().y - centroids.front().y);
+}
+
+double IslandTrack::maxStep() const {
+    double step = 0.0;
+    for (size_t i = 1; i < centroids.size(); ++i) {
+        step = std::max(step, std::hypot(centroids[i].x - centroids[i - 1].x, centroids[i].y - centroids[i - 1].y));
+    }
+    return step;
+}
+
+size_t IslandAnalysis::islandCount() const {
+    size_t count = 0;
+    for (const auto& slice : slices) count += slice.size();
+    return count;
+}
+
+size_t IslandAnalysis::smallIslandCount() const {
+    size_t count = 0;
+    for (const auto& slice : slices) {
+        for (const auto& island : slice) {
+            if (island.area < min_area) count++;
+        }
+    }
+    return count;
+}
+
+IslandAnalysis analyzeIslands2D(const std::vector<cv::Mat>& volume, uchar body_value, int min_area,
+                                int planar_connectivity, const AnalysisControl& control) {
+    IslandAnalysis analysis;
+    analysis.min_area = min_area;
+    analysis.connectivity = planar_connectivity;
+    analysis.slices.resize(volume.size());
+    if (volume.empty()) return analysis;
+
+    const int depth = static_cast<int>(volume.size());
+    const int chunk = std::max(1, 2 * cv::getNumThreads());
+
+    // labels[0] — метки последнего среза предыдущей порции, labels[i] — среза first + i - 1
+    std::vector<cv::Mat> binary(chunk), labels(chunk + 1), stats(chunk), centroids(chunk);
+    std::vector<std::vector<Overlap>> overlaps(chunk);
+    long long islands_found = 0;
+
+    for (int first = 0; first < depth; first += chunk) {
+        const int count = std::min(chunk, depth - first);
+
+        cv::parallel_for_(cv::Range(0, count), [&](const cv::Range& range) {
+            for (int i = range.start; i < range.end; ++i) {
+                const int z = first + i;
+                cv::compare(volume[z], body_value, binary[i], cv::CMP_EQ);
+                int n = cv::connectedComponentsWithStats(binary[i], labels[i + 1], stats[i], centroids[i],
+                                                         planar_connectivity, CV_32S);
+                auto& islands = analysis.slices[z];
+                islands.resize(n - 1);
+                for (int label = 1; label < n; ++label) {
+                    SliceIsland& island = islands[label - 1];
+                    island.slice = z;
+                    island.area = stats[i].at<int>(label, cv::CC_STAT_AREA);
+                    island.centroid = {centroids[i].at<double>(label, 0), centroids[i].at<double>(label, 1)};
+                    island.box = {stats[i].at<int>(label, cv::CC_STAT_LEFT), stats[i].at<int>(label, cv::CC_STAT_TOP),
+                                  stats[i].at<int>(label, cv::CC_STAT_WIDTH), stats[i].at<int>(label, cv::CC_STAT_HEIGHT)};
+                }
+            }
+        });
+
+        // Пары (z - 1, z) внутри порции и на стыке с предыдущей
+        const int pair_begin = first == 0 ? 1 : 0;
+        cv::parallel_for_(cv::Range(pair_begin, count), [&](const cv::Range& range) {
+            for (int i = range.start; i < range.end; ++i) {
+                overlaps[i] = countOverlaps(labels[i], labels[i + 1]);
+            }
+        });
+
+        for (int i = 0; i < count; ++i) {
+            const int z = first + i;
+            if (z == 0) {
+                for (SliceIsland& island : analysis.slices[0]) {
+                    island.track = static_cast<int>(analysis.tracks.size());
+                    analysis.tracks.emplace_back();
+                    analysis.tracks.back().first_slice = 0;
+                    appendToTrack(analysis.tracks.back(), island);
+                }
+            } else {
+                linkSlices(analysis.slices[z - 1], analysis.slices[z], std::move(overlaps[i]), analysis.tracks);
+            }
+        }
+
+        std::swap(labels[0], labels[count]);
+
+        for (int i = 0; i < count; ++i) islands_found += static_cast<long long>(analysis.slices[first + i].size());
+        control.report({"висячие 2D", first + count, depth, islands_found});
+    }
+
+    return analysis;
+}
+
+nlohmann::json islandAnalysisToJson(const IslandAnalysis& analysis) {
+    nlohmann::json per_slice = nlohmann::json::array();
+    nlohmann::json small = nlohmann::json::array();
+    for (const auto& slice : analysis.slices) {
+        per_slice.push_back(slice.size());
+        for (const auto& island : slice) {
+            if (island.area >= analysis.min_area) continue;
+            small.push_back({
+                    {"slice", island.slice},
+                    {"area", island.area},
+                    {"centroid", {island.centroid.x, island.centroid.y}},
+                    {"box", {island.box.x, island.box.y, island.box.width, island.box.height}},
+                    {"track", island.track}
+            });
+        }
+    }
+
+    nlohmann::json tracks = nlohmann::json::array();
+    for (const auto& track : analysis.tracks) {
+        tracks.push_back({
+                {"first_slice", track.first_slice},
+                {"last_slice", track.last_slice},
+                {"areas", track.areas},
+                {"drift", track.drift()},
+                {"max_step", track.maxStep()},
+                {"merges", track.merges},
+                {"splits", track.splits}
+        });
+    }
+
+    return {
+            {"min_area", analysis.min_area},
+            {"connectivity", analysis.connectivity},
+            {"islands", analysis.islandCount()},
+            {"small_islands", small.size()},
+            {"per_slice", per_slice},
+            {"small", small},
+            {"tracks", tracks}
+    };
+}
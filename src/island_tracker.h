@@ -0,0 +1,59 @@
+#ifndef ISLAND_TRACKER_H
+#define ISLAND_TRACKER_H
+
+#include "analysis_progress.h"
+#include <opencv2/opencv.hpp>
+#include <nlohmann/json.hpp>
+#include <vector>
+
+// Связная область тела на одном срезе
+struct SliceIsland {
+    int slice = 0;
+    int area = 0;
+    cv::Point2d centroid;
+    cv::Rect box;
+    int track = -1; // номер трека в IslandAnalysis::tracks
+};
+
+// Цепочка островов соседних срезов, связанных перекрытием
+struct IslandTrack {
+    int first_slice = 0;
+    int last_slice = 0;
+    std::vector<int> areas;              // площадь на каждом срезе трека
+    std::vector<cv::Point2d> centroids;
+    int merges = 0; // остров трека перекрывался с несколькими островами предыдущего среза
+    int splits = 0; // ... с несколькими островами следующего среза
+
+    // Смещение центра от первого среза к последнему и наибольшее смещение за один срез
+    double drift() const;
+    double maxStep() const;
+};
+
+struct IslandAnalysis {
+    int min_area = 0;
+    int connectivity = 8; // связность на срезе: 4 или 8
+    std::vector<std::vector<SliceIsland>> slices; // острова по срезам
+    std::vector<IslandTrack> tracks;
+
+    size_t islandCount() const;
+    size_t smallIslandCount() const; // острова площадью меньше min_area
+};
+
+/**
+ * @brief Находит острова тела на всех срезах и связывает их в треки по перекрытию
+ *
+ * Срезы размечаются параллельно порциями; буферы бинарных масок и меток
+ * выделяются один раз на порцию и переиспользуются. Перекрытия соседних срезов
+ * считаются параллельно по парам срезов, после чего острова сопоставляются
+ * жадно по убыванию площади перекрытия: каждый остров продолжает не больше
+ * одного трека, остальные перекрытия учитываются как слияния и разделения.
+ * Прогресс сообщается и отмена проверяется после каждой порции.
+ * @param planar_connectivity Связность на срезе, 4 или 8; не зависит от 3D-связности тела
+ */
+IslandAnalysis analyzeIslands2D(const std::vector<cv::Mat>& volume, uchar body_value, int min_area = 30,
+                                int planar_connectivity = 8, const AnalysisControl& control = {});
+
+// Раздел результатов: число островов по срезам, мелкие острова и треки
+nlohmann::json islandAnalysisToJson(const IslandAnalysis& analysis);
+
+#endif
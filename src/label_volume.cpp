@@ -0,0 +1,405 @@
+#include "label_volume.h"
+#include "binary_io.h"
+#include "padded_mask.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <queue>
+
+static constexpr char kLabelMagic[4] = {'V', 'L', 'B', 'L'};
+static constexpr uint32_t kLabelVersion = 1;
+static constexpr uint32_t kBvhLeafSize = 4;
+
+// Обходит все компоненты маски, записывая метки в дополненный буфер
+template <int N>
+static void labelMaskComponents(PaddedMask& mask, ComponentKind kind, ScratchVector<uint32_t>& padded,
+                                std::vector<LabelComponent>& components) {
+    ScratchVector<size_t> stack;
+    stack.reserve(mask.plane);
+
+    for (int z = 0; z < mask.depth; ++z) {
+        for (int y = 0; y < mask.height; ++y) {
+            for (int x = 0; x < mask.width; ++x) {
+                size_t idx = mask.index(z, y, x);
+                if (mask.cells[idx] != kCellTarget) continue;
+
+                const uint32_t id = components.size() + 1;
+                FillResult fill = floodFill<N>(mask, idx, stack, [&](size_t cell) { padded[cell] = id; });
+
+                LabelComponent component;
+                component.kind = kind;
+                component.voxels = fill.voxels;
+                component.touches_border = fill.touches_border;
+                component.touches_z0 = fill.touches_z0;
+                components.push_back(component);
+            }
+        }
+    }
+}
+
+LabelVolume labelVolume(const std::vector<cv::Mat>& volume, uchar body_value,
+                        Connectivity body_connectivity, Connectivity pore_connectivity) {
+    LabelVolume result;
+    if (volume.empty()) return result;
+
+    ScratchArena::Scope scratch;
+    PaddedMask body = buildPaddedMask(volume, [body_value](uchar v) { return v == body_value; });
+    ScratchVector<uint32_t> padded(body.cells.size(), 0);
+
+    dispatchConnectivity(body_connectivity, [&](auto n) {
+        labelMaskComponents<decltype(n)::value>(body, ComponentKind::Body, padded, result.components);
+    });
+
+    // Поры размечаются той же маской: непосещённые внутренние ячейки — пустые воксели
+    for (uchar& cell : body.cells) {
+        if (cell == kCellOther) cell = kCellTarget;
+        else if (cell == kCellVisited) cell = kCellOther;
+    }
+    dispatchConnectivity(pore_connectivity, [&](auto n) {
+        labelMaskComponents<decltype(n)::value>(body, ComponentKind::Pore, padded, result.components);
+    });
+
+    result.depth = body.depth;
+    result.height = body.height;
+    result.width = body.width;
+    result.labels.resize(static_cast<size_t>(result.depth) * result.height * result.width);
+
+    for (LabelComponent& component : result.components) {
+        component.box.min = cv::Point3i(std::numeric_limits<int>::max(), std::numeric_limits<int>::max(),
+                                        std::numeric_limits<int>::max());
+        component.box.max = cv::Point3i(-1, -1, -1);
+    }
+
+    // Перенос меток в компактный объём; заодно вычисляются границы компонент
+    for (int z = 0; z < result.depth; ++z) {
+        for (int y = 0; y < result.height; ++y) {
+            const uint32_t* src = &padded[body.index(z, y, 0)];
+            uint32_t* dst = &result.labels[(static_cast<size_t>(z) * result.height + y) * result.width];
+            for (int x = 0; x < result.width; ++x) {
+                dst[x] = src[x];
+                Box3& box = result.components[src[x] - 1].box;
+                box.min.x = std::min(box.min.x, x);
+                box.min.y = std::min(box.min.y, y);
+                box.min.z = std::min(box.min.z, z);
+                box.max.x = std::max(box.max.x, x);
+                box.max.y = std::max(box.max.y, y);
+                box.max.z = std::max(box.max.z, z);
+            }
+        }
+    }
+
+    buildComponentBvh(result);
+    return result;
+}
+
+static Box3 mergeBoxes(const Box3& a, const Box3& b) {
+    return {cv::Point3i(std::min(a.min.x, b.min.x), std::min(a.min.y, b.min.y), std::min(a.min.z, b.min.z)),
+            cv::Point3i(std::max(a.max.x, b.max.x), std::max(a.max.y, b.max.y), std::max(a.max.z, b.max.z))};
+}
+
+static uint32_t buildBvhNode(LabelVolume& labels, uint32_t first, uint32_t count) {
+    const uint32_t node_index = labels.bvh.size();
+    labels.bvh.emplace_back();
+
+    Box3 box = labels.components[labels.bvh_order[first] - 1].box;
+    for (uint32_t i = first + 1; i < first + count; ++i) {
+        box = mergeBoxes(box, labels.components[labels.bvh_order[i] - 1].box);
+    }
+    labels.bvh[node_index].box = box;
+
+    if (count <= kBvhLeafSize) {
+        labels.bvh[node_index].first = first;
+        labels.bvh[node_index].count = count;
+        return node_index;
+    }
+
+    // Разбиение по медиане центров вдоль самой длинной оси
+    const cv::Point3i extent(box.max.x - box.min.x, box.max.y - box.min.y, box.max.z - box.min.z);
+    const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+    auto center = [&](uint32_t id) {
+        const Box3& b = labels.components[id - 1].box;
+        return axis == 0 ? b.min.x + b.max.x : (axis == 1 ? b.min.y + b.max.y : b.min.z + b.max.z);
+    };
+    auto begin = labels.bvh_order.begin() + first;
+    std::nth_element(begin, begin + count / 2, begin + count,
+                     [&](uint32_t a, uint32_t b) { return center(a) < center(b); });
+
+    const uint32_t left = buildBvhNode(labels, first, count / 2);
+    const uint32_t right = buildBvhNode(labels, first + count / 2, count - count / 2);
+    labels.bvh[node_index].first = left;
+    labels.bvh[node_index].second = right;
+    labels.bvh[node_index].count = 0;
+    return node_index;
+}
+
+void buildComponentBvh(LabelVolume& labels) {
+    labels.bvh.clear();
+    labels.bvh_order.resize(labels.components.size());
+    for (uint32_t i = 0; i < labels.bvh_order.size(); ++i) {
+        labels.bvh_order[i] = i + 1;
+    }
+    if (!labels.components.empty()) {
+        labels.bvh.reserve(2 * labels.components.size() / kBvhLeafSize + 1);
+        buildBvhNode(labels, 0, labels.components.size());
+    }
+}
+
+template <typename Label>
+static void writeLabels(std::ofstream& out, const std::vector<uint32_t>& labels, bool compress) {
+    if (!compress) {
+        std::vector<Label> narrow(labels.begin(), labels.end());
+        out.write(reinterpret_cast<const char*>(narrow.data()), narrow.size() * sizeof(Label));
+        return;
+    }
+
+    // Серии: значение метки и длина серии
+    uint64_t runs = 0;
+    std::streampos count_position = out.tellp();
+    writeValue<uint64_t>(out, 0);
+    for (size_t i = 0; i < labels.size();) {
+        size_t j = i;
+        while (j < labels.size() && labels[j] == labels[i] && j - i < UINT32_MAX) ++j;
+        writeValue(out, static_cast<Label>(labels[i]));
+        writeValue(out, static_cast<uint32_t>(j - i));
+        runs++;
+        i = j;
+    }
+    std::streampos end = out.tellp();
+    out.seekp(count_position);
+    writeValue(out, runs);
+    out.seekp(end);
+}
+
+template <typename Label>
+static bool readLabels(std::ifstream& in, std::vector<uint32_t>& labels, bool compressed) {
+    if (!compressed) {
+        std::vector<Label> narrow(labels.size());
+        if (!in.read(reinterpret_cast<char*>(narrow.data()), narrow.size() * sizeof(Label))) return false;
+        std::copy(narrow.begin(), narrow.end(), labels.begin());
+        return true;
+    }
+
+    uint64_t runs = 0;
+    if (!readValue(in, runs)) return false;
+    size_t position = 0;
+    for (uint64_t r = 0; r < runs; ++r) {
+        Label value;
+        uint32_t length;
+        if (!readValue(in, value) || !readValue(in, length) || position + length > labels.size()) return false;
+        std::fill_n(labels.begin() + position, length, value);
+        position += length;
+    }
+    return position == labels.size();
+}
+
+static void writeBox(std::ofstream& out, const Box3& box) {
+    for (const cv::Point3i& p : {box.min, box.max}) {
+        writeValue<int32_t>(out, p.z);
+        writeValue<int32_t>(out, p.y);
+        writeValue<int32_t>(out, p.x);
+    }
+}
+
+static bool readBox(std::ifstream& in, Box3& box) {
+    for (cv::Point3i* p : {&box.min, &box.max}) {
+        if (!readValue(in, p->z) || !readValue(in, p->y) || !readValue(in, p->x)) return false;
+    }
+    return true;
+}
+
+bool saveLabelVolume(const LabelVolume& labels, const std::string& file, bool compress) {
+    std::ofstream out(file, std::ios::binary);
+    if (!out) {
+        std::cerr << "❌ Не удалось открыть файл для записи меток: " << file << std::endl;
+        return false;
+    }
+
+    const size_t count = labels.components.size();
+    const uint8_t label_bytes = count <= UINT8_MAX ? 1 : (count <= UINT16_MAX ? 2 : 4);
+
+    out.write(kLabelMagic, sizeof(kLabelMagic));
+    writeValue(out, kLabelVersion);
+    writeValue<int32_t>(out, labels.depth);
+    writeValue<int32_t>(out, labels.height);
+    writeValue<int32_t>(out, labels.width);
+    writeValue(out, label_bytes);
+    writeValue<uint8_t>(out, compress ? 1 : 0);
+
+    writeValue<uint64_t>(out, count);
+    for (const LabelComponent& component : labels.components) {
+        writeValue(out, static_cast<uint8_t>(component.kind));
+        writeValue<uint8_t>(out, component.touches_border);
+        writeValue<uint8_t>(out, component.touches_z0);
+        writeValue(out, component.voxels);
+        writeBox(out, component.box);
+    }
+
+    if (label_bytes == 1) writeLabels<uint8_t>(out, labels.labels, compress);
+    else if (label_bytes == 2) writeLabels<uint16_t>(out, labels.labels, compress);
+    else writeLabels<uint32_t>(out, labels.labels, compress);
+    return static_cast<bool>(out);
+}
+
+bool loadLabelVolume(const std::string& file, LabelVolume& labels) {
+    std::ifstream in(file, std::ios::binary);
+    if (!in) {
+        std::cerr << "❌ Не удалось открыть файл меток: " << file << std::endl;
+        return false;
+    }
+
+    char magic[4];
+    uint32_t version = 0;
+    uint8_t label_bytes = 0, compressed = 0;
+    uint64_t count = 0;
+    bool ok = in.read(magic, sizeof(magic)) && std::equal(magic, magic + 4, kLabelMagic) &&
+              readValue(in, version) && version == kLabelVersion &&
+              readValue(in, labels.depth) && readValue(in, labels.height) && readValue(in, labels.width) &&
+              readValue(in, label_bytes) && readValue(in, compressed) && readValue(in, count);
+
+    if (ok) {
+        labels.components.resize(count);
+        for (LabelComponent& component : labels.components) {
+            uint8_t kind = 0, touches_border = 0, touches_z0 = 0;
+            ok = ok && readValue(in, kind) && readValue(in, touches_border) && readValue(in, touches_z0) &&
+                 readValue(in, component.voxels) && readBox(in, component.box);
+            component.kind = static_cast<ComponentKind>(kind);
+            component.touches_border = touches_border;
+            component.touches_z0 = touches_z0;
+        }
+    }
+
+    if (ok) {
+        labels.labels.resize(static_cast<size_t>(labels.depth) * labels.height * labels.width);
+        if (label_bytes == 1) ok = readLabels<uint8_t>(in, labels.labels, compressed);
+        else if (label_bytes == 2) ok = readLabels<uint16_t>(in, labels.labels, compressed);
+        else ok = label_bytes == 4 && readLabels<uint32_t>(in, labels.labels, compressed);
+    }
+
+    if (!ok) {
+        std::cerr << "❌ Некорректный файл меток: " << file << std::endl;
+        return false;
+    }
+    buildComponentBvh(labels);
+    return true;
+}
+
+uint32_t labelAt(const LabelVolume& labels, const cv::Point3i& voxel) {
+    if (voxel.z < 0 || voxel.z >= labels.depth || voxel.y < 0 || voxel.y >= labels.height ||
+        voxel.x < 0 || voxel.x >= labels.width) {
+        return 0;
+    }
+    return labels.at(voxel.z, voxel.y, voxel.x);
+}
+
+static bool boxesIntersect(const Box3& a, const Box3& b) {
+    return a.min.x <= b.max.x && b.min.x <= a.max.x &&
+           a.min.y <= b.max.y && b.min.y <= a.max.y &&
+           a.min.z <= b.max.z && b.min.z <= a.max.z;
+}
+
+std::vector<uint32_t> componentsInBox(const LabelVolume& labels, const Box3& box) {
+    std::vector<uint32_t> result;
+    if (labels.bvh.empty()) return result;
+
+    std::vector<uint32_t> pending = {0};
+    while (!pending.empty()) {
+        const BvhNode& node = labels.bvh[pending.back()];
+        pending.pop_back();
+        if (!boxesIntersect(node.box, box)) continue;
+
+        if (node.count == 0) {
+            pending.push_back(node.first);
+            pending.push_back(node.second);
+            continue;
+        }
+
+        // Пересечение параллелепипедов не гарантирует наличия вокселей компоненты внутри
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            const uint32_t id = labels.bvh_order[i];
+            const Box3& cbox = labels.components[id - 1].box;
+            if (!boxesIntersect(cbox, box)) continue;
+
+            bool found = false;
+            for (int z = std::max(box.min.z, cbox.min.z); z <= std::min(box.max.z, cbox.max.z) && !found; ++z) {
+                for (int y = std::max(box.min.y, cbox.min.y); y <= std::min(box.max.y, cbox.max.y) && !found; ++y) {
+                    for (int x = std::max(box.min.x, cbox.min.x); x <= std::min(box.max.x, cbox.max.x); ++x) {
+                        if (labels.at(z, y, x) == id) {
+                            found = true;
+                            break;
+                        }
+                    }
+                }
+            }
+            if (found) result.push_back(id);
+        }
+    }
+
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+// Квадрат расстояния от точки до параллелепипеда
+static int64_t boxDistance2(const Box3& box, const cv::Point3i& p) {
+    auto axis = [](int v, int lo, int hi) -> int64_t {
+        int d = v < lo ? lo - v : (v > hi ? v - hi : 0);
+        return static_cast<int64_t>(d) * d;
+    };
+    return axis(p.x, box.min.x, box.max.x) + axis(p.y, box.min.y, box.max.y) + axis(p.z, box.min.z, box.max.z);
+}
+
+bool nearestPore(const LabelVolume& labels, const cv::Point3i& point, uint32_t& pore, cv::Point3i& voxel,
+                 double& distance) {
+    if (labels.bvh.empty()) return false;
+
+    // Обход узлов в порядке нижней оценки расстояния; поддеревья дальше найденного отбрасываются
+    using Entry = std::pair<int64_t, uint32_t>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    queue.push({boxDistance2(labels.bvh[0].box, point), 0});
+    int64_t best = std::numeric_limits<int64_t>::max();
+    pore = 0;
+
+    while (!queue.empty()) {
+        auto [bound, index] = queue.top();
+        queue.pop();
+        if (bound >= best) break;
+
+        const BvhNode& node = labels.bvh[index];
+        if (node.count == 0) {
+            for (uint32_t child : {node.first, node.second}) {
+                int64_t d = boxDistance2(labels.bvh[child].box, point);
+                if (d < best) queue.push({d, child});
+            }
+            continue;
+        }
+
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            const uint32_t id = labels.bvh_order[i];
+            const LabelComponent& component = labels.components[id - 1];
+            if (component.kind != ComponentKind::Pore || component.touches_border) continue;
+            if (boxDistance2(component.box, point) >= best) continue;
+
+            const Box3& b = component.box;
+            for (int z = b.min.z; z <= b.max.z; ++z) {
+                int64_t dz2 = static_cast<int64_t>(z - point.z) * (z - point.z);
+                if (dz2 >= best) continue;
+                for (int y = b.min.y; y <= b.max.y; ++y) {
+                    int64_t dzy2 = dz2 + static_cast<int64_t>(y - point.y) * (y - point.y);
+                    if (dzy2 >= best) continue;
+                    for (int x = b.min.x; x <= b.max.x; ++x) {
+                        int64_t d = dzy2 + static_cast<int64_t>(x - point.x) * (x - point.x);
+                        if (d < best && labels.at(z, y, x) == id) {
+                            best = d;
+                            pore = id;
+                            voxel = cv::Point3i(x, y, z);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    if (pore == 0) return false;
+    distance = std::sqrt(static_cast<double>(best));
+    return true;
+}
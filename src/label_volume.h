@@ -0,0 +1,88 @@
+#ifndef LABEL_VOLUME_H
+#define LABEL_VOLUME_H
+
+#include "neighborhood.h"
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Ограничивающий параллелепипед в координатах (z, y, x); границы включаются
+struct Box3 {
+    cv::Point3i min, max;
+};
+
+enum class ComponentKind : uchar {
+    Body = 0,
+    Pore = 1
+};
+
+struct LabelComponent {
+    ComponentKind kind = ComponentKind::Body;
+    bool touches_border = false; // поры, касающиеся границы объёма, — не внутренние
+    bool touches_z0 = false;
+    uint64_t voxels = 0;
+    Box3 box;
+};
+
+struct BvhNode {
+    Box3 box;
+    uint32_t first = 0; // лист: первый элемент в bvh_order; внутренний узел: левый потомок
+    uint32_t second = 0; // внутренний узел: правый потомок
+    uint32_t count = 0; // число компонент в листе, 0 — внутренний узел
+};
+
+/**
+ * @brief Объём меток: компоненты тела и пор пронумерованы подряд, 0 — нет компоненты
+ *
+ * Компонента с меткой id описывается components[id - 1]. Для пространственных
+ * запросов по ограничивающим параллелепипедам компонент строится BVH.
+ */
+struct LabelVolume {
+    int depth = 0, height = 0, width = 0;
+    std::vector<uint32_t> labels;
+    std::vector<LabelComponent> components;
+
+    std::vector<BvhNode> bvh;
+    std::vector<uint32_t> bvh_order; // метки компонент в порядке листьев BVH
+
+    uint32_t at(int z, int y, int x) const {
+        return labels[(static_cast<size_t>(z) * height + y) * width + x];
+    }
+};
+
+/**
+ * @brief Размечает компоненты тела (body_connectivity) и пор (pore_connectivity)
+ * тем же обходом, что и основной анализ, и строит BVH
+ */
+LabelVolume labelVolume(const std::vector<cv::Mat>& volume, uchar body_value,
+                        Connectivity body_connectivity, Connectivity pore_connectivity);
+
+void buildComponentBvh(LabelVolume& labels);
+
+/**
+ * @brief Сохраняет объём меток в наименьшей подходящей разрядности (1, 2 или 4 байта)
+ * @param compress Сжатие серий одинаковых меток (RLE)
+ */
+bool saveLabelVolume(const LabelVolume& labels, const std::string& file, bool compress);
+
+// Загружает объём меток и строит BVH
+bool loadLabelVolume(const std::string& file, LabelVolume& labels);
+
+// Метка вокселя; 0 — вне объёма или фон
+uint32_t labelAt(const LabelVolume& labels, const cv::Point3i& voxel);
+
+// Метки компонент, у которых есть воксели внутри параллелепипеда
+std::vector<uint32_t> componentsInBox(const LabelVolume& labels, const Box3& box);
+
+/**
+ * @brief Ближайшая к точке внутренняя пора
+ * @param pore Метка поры
+ * @param voxel Ближайший воксель поры
+ * @param distance Евклидово расстояние в вокселях
+ * @return false, если внутренних пор нет
+ */
+bool nearestPore(const LabelVolume& labels, const cv::Point3i& point, uint32_t& pore, cv::Point3i& voxel,
+                 double& distance);
+
+#endif
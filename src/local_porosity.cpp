@@ -0,0 +1,276 @@
+#include "local_porosity.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Накопленные по окнам величины одного слоя положений окна
+struct WindowStats {
+    size_t windows = 0;
+    double sum = 0.0;
+    double sum_sq = 0.0;
+    double min = std::numeric_limits<double>::max();
+    double max = 0.0;
+
+    void add(double value) {
+        windows++;
+        sum += value;
+        sum_sq += value * value;
+        min = std::min(min, value);
+        max = std::max(max, value);
+    }
+
+    void merge(const WindowStats& other) {
+        windows += other.windows;
+        sum += other.sum;
+        sum_sq += other.sum_sq;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+
+    double mean() const { return windows ? sum / windows : 0.0; }
+
+    double variance() const {
+        if (!windows) return 0.0;
+        const double m = mean();
+        return std::max(0.0, sum_sq / windows - m * m);
+    }
+};
+
+// Число положений окна вдоль оси с шагом stride
+int windowPositions(int size, int window, int stride) {
+    return (size - window) / stride + 1;
+}
+
+// Пористость всех окон с началами на сетке шага stride: слои положений по z обрабатываются параллельно
+template <typename Visitor>
+WindowStats scanWindows(const IntegralVolume& integral, const cv::Point3i& window, int stride,
+                        const std::string& stage, const AnalysisControl& control, Visitor visit) {
+    const int nz = windowPositions(integral.depth, window.z, stride);
+    const int ny = windowPositions(integral.height, window.y, stride);
+    const int nx = windowPositions(integral.width, window.x, stride);
+    std::vector<WindowStats> layers(nz);
+
+    const int chunk = std::max(1, 2 * cv::getNumThreads());
+    for (int first = 0; first < nz; first += chunk) {
+        const int count = std::min(chunk, nz - first);
+        cv::parallel_for_(cv::Range(first, first + count), [&](const cv::Range& range) {
+            for (int iz = range.start; iz < range.end; ++iz) {
+                for (int iy = 0; iy < ny; ++iy) {
+                    for (int ix = 0; ix < nx; ++ix) {
+                        const cv::Point3i from(ix * stride, iy * stride, iz * stride);
+                        const cv::Point3i to(from.x + window.x, from.y + window.y, from.z + window.z);
+                        const double value = integral.porosity(from, to);
+                        layers[iz].add(value);
+                        visit(iz, iy, ix, value);
+                    }
+                }
+            }
+        });
+        control.report({stage, first + count, nz});
+    }
+
+    WindowStats total;
+    for (const WindowStats& layer : layers) total.merge(layer);
+    return total;
+}
+
+cv::Point3i clampWindow(const IntegralVolume& integral, int window) {
+    return {std::min(window, integral.width), std::min(window, integral.height), std::min(window, integral.depth)};
+}
+
+} // namespace
+
+uint64_t IntegralVolume::count(const cv::Point3i& from, const cv::Point3i& to) const {
+    // Включения-исключения по восьми вершинам окна; промежуточные переполнения uint64 взаимно сокращаются
+    return at(to.z, to.y, to.x) - at(from.z, to.y, to.x) - at(to.z, from.y, to.x) - at(to.z, to.y, from.x) +
+           at(from.z, from.y, to.x) + at(from.z, to.y, from.x) + at(to.z, from.y, from.x) -
+           at(from.z, from.y, from.x);
+}
+
+double IntegralVolume::porosity(const cv::Point3i& from, const cv::Point3i& to) const {
+    const double voxels = static_cast<double>(to.z - from.z) * (to.y - from.y) * (to.x - from.x);
+    return voxels > 0.0 ? count(from, to) / voxels : 0.0;
+}
+
+IntegralVolume buildIntegralVolume(const std::vector<cv::Mat>& volume, uchar body_value,
+                                   const AnalysisControl& control) {
+    IntegralVolume integral;
+    if (volume.empty()) return integral;
+
+    integral.depth = static_cast<int>(volume.size());
+    integral.height = volume[0].rows;
+    integral.width = volume[0].cols;
+    const size_t row_size = integral.width + 1;
+    const size_t plane_size = (integral.height + 1) * row_size;
+    integral.sums.assign((integral.depth + 1) * plane_size, 0);
+    uint64_t* sums = integral.sums.data();
+
+    // Двумерные накопленные суммы каждого среза независимы
+    const int chunk = std::max(1, 2 * cv::getNumThreads());
+    for (int first = 0; first < integral.depth; first += chunk) {
+        const int count = std::min(chunk, integral.depth - first);
+        cv::parallel_for_(cv::Range(first, first + count), [&](const cv::Range& range) {
+            for (int z = range.start; z < range.end; ++z) {
+                uint64_t* plane = sums + (z + 1) * plane_size;
+                for (int y = 0; y < integral.height; ++y) {
+                    const uchar* src = volume[z].ptr<uchar>(y);
+                    const uint64_t* above = plane + y * row_size;
+                    uint64_t* row = plane + (y + 1) * row_size;
+                    uint64_t running = 0;
+                    for (int x = 0; x < integral.width; ++x) {
+                        running += src[x] != body_value;
+                        row[x + 1] = above[x + 1] + running;
+                    }
+                }
+            }
+        });
+        control.report({"интегральный объём", first + count, integral.depth});
+    }
+
+    // Накопление по z: строки разных y не пересекаются, внутренний цикл векторизуется
+    cv::parallel_for_(cv::Range(1, integral.height + 1), [&](const cv::Range& range) {
+        for (int z = 1; z <= integral.depth; ++z) {
+            const uint64_t* below = sums + (z - 1) * plane_size;
+            uint64_t* plane = sums + z * plane_size;
+            for (int y = range.start; y < range.end; ++y) {
+                const uint64_t* prev = below + y * row_size;
+                uint64_t* row = plane + y * row_size;
+                for (size_t x = 1; x < row_size; ++x) row[x] += prev[x];
+            }
+        }
+    });
+    control.check();
+    return integral;
+}
+
+LocalPorosityMap computeLocalPorosityMap(const IntegralVolume& integral, int window, int stride,
+                                         const AnalysisControl& control) {
+    LocalPorosityMap map;
+    if (integral.depth == 0 || window <= 0 || stride <= 0) return map;
+
+    const cv::Point3i box = clampWindow(integral, window);
+    map.window = window;
+    map.stride = stride;
+    map.slices.resize(windowPositions(integral.depth, box.z, stride));
+    const int rows = windowPositions(integral.height, box.y, stride);
+    const int cols = windowPositions(integral.width, box.x, stride);
+    for (cv::Mat& slice : map.slices) slice.create(rows, cols, CV_32F);
+
+    WindowStats stats = scanWindows(integral, box, stride, "локальная пористость", control,
+                                    [&](int iz, int iy, int ix, double value) {
+                                        map.slices[iz].at<float>(iy, ix) = static_cast<float>(value);
+                                    });
+    map.mean = stats.mean();
+    map.stddev = std::sqrt(stats.variance());
+    map.min = stats.min;
+    map.max = stats.max;
+    return map;
+}
+
+std::vector<RevPoint> computeRevCurve(const IntegralVolume& integral, std::vector<int> windows,
+                                      const AnalysisControl& control) {
+    std::vector<RevPoint> curve;
+    if (integral.depth == 0) return curve;
+
+    const int smallest = std::min({integral.depth, integral.height, integral.width});
+    if (windows.empty()) {
+        for (int window = 4; window < smallest; window *= 2) windows.push_back(window);
+        windows.push_back(smallest);
+    }
+
+    for (int window : windows) {
+        if (window <= 0) continue;
+        const cv::Point3i box = clampWindow(integral, window);
+        const int stride = std::max(1, window / 4);
+        WindowStats stats = scanWindows(integral, box, stride, "REV", control, [](int, int, int, double) {});
+
+        RevPoint point;
+        point.window = window;
+        point.stride = stride;
+        point.windows = stats.windows;
+        point.mean = stats.mean();
+        point.variance = stats.variance();
+        point.min = stats.min;
+        point.max = stats.max;
+        curve.push_back(point);
+    }
+    return curve;
+}
+
+int representativeWindow(const std::vector<RevPoint>& curve, double tolerance) {
+    // Окно представительно, если и все большие окна с достаточным числом положений укладываются в допуск
+    int window = 0;
+    for (auto it = curve.rbegin(); it != curve.rend(); ++it) {
+        if (it->windows < kMinRevWindows) continue;
+        if (std::sqrt(it->variance) > tolerance) break;
+        window = it->window;
+    }
+    return window;
+}
+
+std::string localPorosityFolder(const std::string& folder, int window) {
+    fs::path base(folder);
+    // Для многостраничного TIFF карта кладётся рядом с файлом
+    if (!fs::is_directory(base)) base = base.parent_path() / (base.stem().string() + "_local_porosity");
+    else base /= "local_porosity";
+    return (base / ("window_" + std::to_string(window))).string();
+}
+
+bool saveLocalPorosityMap(const LocalPorosityMap& map, const std::string& out_dir) {
+    fs::create_directories(out_dir);
+
+    for (size_t i = 0; i < map.slices.size(); ++i) {
+        cv::Mat scaled;
+        map.slices[i].convertTo(scaled, CV_8U, 255.0);
+        std::string filename = out_dir + "/slice_" + std::to_string(i) + ".png";
+        if (!cv::imwrite(filename, scaled)) {
+            std::cerr << "Не удалось сохранить " << filename << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+nlohmann::json localPorosityToJson(double porosity, const LocalPorosityMap& map, const std::vector<RevPoint>& curve,
+                                   double tolerance) {
+    nlohmann::json rev = nlohmann::json::array();
+    for (const RevPoint& point : curve) {
+        rev.push_back({
+                {"window", point.window},
+                {"stride", point.stride},
+                {"windows", point.windows},
+                {"mean", point.mean},
+                {"variance", point.variance},
+                {"std", std::sqrt(point.variance)},
+                {"min", point.min},
+                {"max", point.max}
+        });
+    }
+
+    const int representative = representativeWindow(curve, tolerance);
+    nlohmann::json result = {
+            {"porosity", porosity},
+            {"rev", rev},
+            {"rev_tolerance", tolerance},
+            {"rev_min_windows", kMinRevWindows},
+            {"rev_window", representative > 0 ? nlohmann::json(representative) : nlohmann::json()}
+    };
+    if (!map.slices.empty()) {
+        result["map"] = {
+                {"window", map.window},
+                {"stride", map.stride},
+                {"size", {map.slices.size(), map.slices[0].rows, map.slices[0].cols}},
+                {"mean", map.mean},
+                {"std", map.stddev},
+                {"min", map.min},
+                {"max", map.max}
+        };
+    }
+    return result;
+}
@@ -0,0 +1,92 @@
+#ifndef LOCAL_POROSITY_H
+#define LOCAL_POROSITY_H
+
+#include "analysis_progress.h"
+#include <opencv2/opencv.hpp>
+#include <nlohmann/json.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Интегральный объём (3D-таблица накопленных сумм) числа пор
+ *
+ * sums[z][y][x] — число пор в параллелепипеде [0, z) × [0, y) × [0, x), поэтому
+ * число пор в любом окне получается по восьми значениям таблицы за O(1).
+ * Счётчики 64-битные: переполнения нет на объёмах любого размера.
+ */
+struct IntegralVolume {
+    int depth = 0, height = 0, width = 0;
+    std::vector<uint64_t> sums; // (depth + 1) × (height + 1) × (width + 1)
+
+    uint64_t at(int z, int y, int x) const {
+        return sums[(static_cast<size_t>(z) * (height + 1) + y) * (width + 1) + x];
+    }
+
+    // Число пор в окне [from, to) по каждой оси
+    uint64_t count(const cv::Point3i& from, const cv::Point3i& to) const;
+
+    double porosity(const cv::Point3i& from, const cv::Point3i& to) const;
+};
+
+/**
+ * @brief Строит интегральный объём
+ *
+ * Суммы по строкам и столбцам считаются для срезов параллельно, затем
+ * накопление по z идёт параллельно по строкам.
+ * @param body_value Значение тела; остальные воксели считаются порами
+ */
+IntegralVolume buildIntegralVolume(const std::vector<cv::Mat>& volume, uchar body_value,
+                                   const AnalysisControl& control = {});
+
+// Пористость окон window³ с шагом stride; окно ограничено размерами объёма по каждой оси
+struct LocalPorosityMap {
+    int window = 0;
+    int stride = 0;
+    std::vector<cv::Mat> slices; // CV_32F, значение — пористость окна с началом в (z, y, x) * stride
+    double mean = 0.0, stddev = 0.0, min = 0.0, max = 0.0;
+};
+
+LocalPorosityMap computeLocalPorosityMap(const IntegralVolume& integral, int window, int stride,
+                                         const AnalysisControl& control = {});
+
+// Точка кривой представительного объёма: разброс пористости окон одного размера
+struct RevPoint {
+    int window = 0;
+    int stride = 0;
+    size_t windows = 0;
+    double mean = 0.0, variance = 0.0, min = 0.0, max = 0.0;
+};
+
+/**
+ * @brief Кривая представительного элементарного объёма (REV)
+ *
+ * Для каждого размера окна перебираются все положения окна с шагом window / 4,
+ * так что число окон на размер не зависит от объёма кубически. Пустой список
+ * размеров — степени двойки от 4 до наименьшего размера объёма и сам этот размер.
+ */
+std::vector<RevPoint> computeRevCurve(const IntegralVolume& integral, std::vector<int> windows = {},
+                                      const AnalysisControl& control = {});
+
+// Размеры окон, у которых положений меньше этого числа, не участвуют в выборе REV:
+// окно размером с образец занимает одно положение, и его разброс всегда нулевой
+constexpr size_t kMinRevWindows = 8;
+
+/**
+ * @brief Наименьшее окно, начиная с которого стандартное отклонение не превышает tolerance
+ *
+ * Точки кривой меньше чем с kMinRevWindows положениями пропускаются.
+ * @return 0, если такого окна нет
+ */
+int representativeWindow(const std::vector<RevPoint>& curve, double tolerance);
+
+// Папка, в которой карта хранится рядом с исходными срезами
+std::string localPorosityFolder(const std::string& folder, int window);
+
+// Сохраняет карту как 8-битные срезы: 255 — окно целиком из пор
+bool saveLocalPorosityMap(const LocalPorosityMap& map, const std::string& out_dir);
+
+nlohmann::json localPorosityToJson(double porosity, const LocalPorosityMap& map, const std::vector<RevPoint>& curve,
+                                   double tolerance);
+
+#endif
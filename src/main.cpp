@@ -1,5 +1,10 @@
+#include "project_paths.h"
+#include "stochastic_generator.h"
 #include "volume_generator.h"
+#include <cstdio>
 #include <filesystem>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <opencv2/opencv.hpp>
 
@@ -48,8 +53,141 @@ void createBorderedCollage(const std::vector<cv::Mat>& slices, const std::string
     cv::imwrite(outputPath, collage);
 }
 
-int main() {
-    fs::path project_root = fs::current_path().parent_path();
+static void printUsage(const char* program) {
+    std::cerr << "Пример использования: " << program << " [--random MODE [опции]]\n"
+              << "Без аргументов генерируются эталонные кубы 50³ в data/slices.\n"
+              << "  --random spheres|ellipsoids|stones|slabs  случайный объём с известными метриками\n"
+              << "  --size N | D,H,W             размер объёма (по умолчанию 128)\n"
+              << "  --seed N                     зерно генератора (по умолчанию 1)\n"
+              << "  --density D                  доля объёма, занятая порами (по умолчанию 0.2)\n"
+              << "  --radius MIN:MAX             радиусы пор и полостей (по умолчанию 2:6)\n"
+              << "  --fractures K                число трещин для slabs (по умолчанию 3)\n"
+              << "  --fracture-thickness T       толщина трещин в вокселях (по умолчанию 2)\n"
+              << "  --out DIR                    папка срезов (по умолчанию data/slices/random_MODE_SEED)\n"
+              << "  --update-reference           записать метрики в src/reference_metrics.json\n";
+}
+
+static bool parseStochasticOptions(int argc, char** argv, StochasticOptions& options, std::string& out_dir,
+                                   bool& update_reference) {
+    bool mode_set = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--update-reference") {
+            update_reference = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Ошибка: для опции " << arg << " не указано значение." << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+        try {
+            if (arg == "--random") {
+                if (!parseStochasticMode(value, options.mode)) {
+                    std::cerr << "Ошибка: неизвестный режим " << value << std::endl;
+                    return false;
+                }
+                mode_set = true;
+            } else if (arg == "--size") {
+                int d = 0, h = 0, w = 0;
+                if (std::sscanf(value.c_str(), "%d,%d,%d", &d, &h, &w) == 3) {
+                    options.depth = d, options.height = h, options.width = w;
+                } else {
+                    options.depth = options.height = options.width = std::stoi(value);
+                }
+            } else if (arg == "--seed") {
+                options.seed = std::stoull(value);
+            } else if (arg == "--density") {
+                options.density = std::stod(value);
+            } else if (arg == "--radius") {
+                if (std::sscanf(value.c_str(), "%lf:%lf", &options.min_radius, &options.max_radius) != 2) {
+                    std::cerr << "Ошибка: радиусы задаются как MIN:MAX, получено: " << value << std::endl;
+                    return false;
+                }
+            } else if (arg == "--fractures") {
+                options.fractures = std::stoi(value);
+            } else if (arg == "--fracture-thickness") {
+                options.fracture_thickness = std::stoi(value);
+            } else if (arg == "--out") {
+                out_dir = value;
+            } else {
+                std::cerr << "Ошибка: неизвестная опция " << arg << std::endl;
+                return false;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Ошибка: некорректное значение " << value << " для опции " << arg << std::endl;
+            return false;
+        }
+    }
+    if (!mode_set) {
+        std::cerr << "Ошибка: укажите режим --random." << std::endl;
+        return false;
+    }
+    if (out_dir.empty()) {
+        out_dir = projectPath("data/slices/random_" + std::string(stochasticModeName(options.mode)) + "_" +
+                              std::to_string(options.seed));
+    }
+    return true;
+}
+
+// Случайный объём: срезы, коллаж и точные метрики в ground_truth.json
+static int runStochastic(int argc, char** argv) {
+    StochasticOptions options;
+    std::string out_dir;
+    bool update_reference = false;
+    if (!parseStochasticOptions(argc, argv, options, out_dir, update_reference)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    StochasticVolume volume;
+    try {
+        volume = generateStochasticVolume(options);
+    } catch (const std::invalid_argument& e) {
+        std::cerr << "Ошибка: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (!VolumeGenerator::saveSlices(volume.slices, out_dir)) {
+        return 1;
+    }
+    nlohmann::json truth = groundTruthToJson(volume.truth, options);
+    std::ofstream(fs::path(out_dir) / "ground_truth.json") << std::setw(4) << truth << std::endl;
+
+    const GroundTruth& t = volume.truth;
+    std::cout << "Объём " << stochasticModeName(options.mode) << " сохранён в: " << out_dir << std::endl;
+    std::cout << "Объектов: " << t.objects << ", пористость: " << t.porosity * 100 << "%"
+              << ", внутренних пор: " << t.internal_pores << ", висячих тел: " << t.floating_parts
+              << ", связный: " << (t.connected ? "да" : "нет") << ", время генерации: " << t.seconds << " с"
+              << std::endl;
+
+    if (update_reference) {
+        std::string json_path = projectPath("src/reference_metrics.json");
+        nlohmann::json reference;
+        if (std::ifstream in(json_path); in) {
+            in >> reference;
+        }
+        reference[fs::path(out_dir).filename().string()] = {
+                {"connected", t.connected},
+                {"floating_parts", t.floating_parts},
+                {"internal_pores", t.internal_pores},
+                {"porosity", t.porosity}
+        };
+        std::ofstream(json_path) << std::setw(4) << reference << std::endl;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        if (std::string(argv[1]) == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        }
+        return runStochastic(argc, argv);
+    }
+
+    fs::path project_root = projectRoot();
     std::string outputDir = (project_root / "data/slices").string();
     int size = 50;
     std::cout << "Saving slices to: " << outputDir << std::endl;
@@ -0,0 +1,85 @@
+#ifndef NEIGHBORHOOD_H
+#define NEIGHBORHOOD_H
+
+#include <array>
+#include <string>
+#include <type_traits>
+
+// Тип 3D-связности: 6 — соседи по граням, 18 — по граням и рёбрам, 26 — ещё и по вершинам
+enum class Connectivity {
+    Six = 6,
+    Eighteen = 18,
+    TwentySix = 26
+};
+
+struct Offset3 {
+    int dz, dy, dx;
+};
+
+/**
+ * @brief Строит таблицу смещений соседей на этапе компиляции
+ * @tparam N Число соседей (6, 18 или 26)
+ * @return Смещения в порядке обхода z → y → x
+ */
+template <int N>
+constexpr std::array<Offset3, N> makeNeighborOffsets() {
+    static_assert(N == 6 || N == 18 || N == 26, "Поддерживается только 6-, 18- и 26-связность");
+
+    // Порядок соседа — число ненулевых компонент смещения
+    constexpr int max_order = N == 6 ? 1 : (N == 18 ? 2 : 3);
+
+    std::array<Offset3, N> offsets{};
+    int i = 0;
+    for (int dz = -1; dz <= 1; ++dz) {
+        for (int dy = -1; dy <= 1; ++dy) {
+            for (int dx = -1; dx <= 1; ++dx) {
+                int order = (dz != 0) + (dy != 0) + (dx != 0);
+                if (order == 0 || order > max_order) continue;
+                offsets[i++] = Offset3{dz, dy, dx};
+            }
+        }
+    }
+    return offsets;
+}
+
+template <int N>
+struct Neighborhood {
+    static constexpr std::array<Offset3, N> offsets = makeNeighborOffsets<N>();
+};
+
+/**
+ * @brief Вызывает f со специализацией под выбранную связность
+ * @param connectivity Связность, выбранная во время выполнения
+ * @param f Обобщённая лямбда, принимающая std::integral_constant<int, N>
+ */
+template <typename F>
+decltype(auto) dispatchConnectivity(Connectivity connectivity, F&& f) {
+    switch (connectivity) {
+        case Connectivity::Six:
+            return f(std::integral_constant<int, 6>{});
+        case Connectivity::Eighteen:
+            return f(std::integral_constant<int, 18>{});
+        default:
+            return f(std::integral_constant<int, 26>{});
+    }
+}
+
+// Дополнительная связность для фона: пары (6, 26) и (18/26, 6) сохраняют топологию
+inline Connectivity complementaryConnectivity(Connectivity connectivity) {
+    return connectivity == Connectivity::Six ? Connectivity::TwentySix : Connectivity::Six;
+}
+
+// Связность внутри одного среза, соответствующая 3D-шаблону (4 или 8)
+inline int planarConnectivity(Connectivity connectivity) {
+    return connectivity == Connectivity::Six ? 4 : 8;
+}
+
+inline bool parseConnectivity(const std::string& text, Connectivity& connectivity) {
+    if (text == "6") connectivity = Connectivity::Six;
+    else if (text == "18") connectivity = Connectivity::Eighteen;
+    else if (text == "26") connectivity = Connectivity::TwentySix;
+    else return false;
+    return true;
+}
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef PADDED_MASK_H
+#define PADDED_MASK_H
+
+#include "neighborhood.h"
+#include "scratch_arena.h"
+#include <opencv2/opencv.hpp>
+#include <array>
+#include <cstddef>
+#include <vector>
+
+// Состояния ячеек дополненной маски объёма
+enum : uchar {
+    kCellOther = 0,
+    kCellTarget = 1,
+    kCellVisited = 2,
+    kCellOutside = 3
+};
+
+// Плоская маска объёма с рамкой в один воксель: соседи любого вокселя всегда
+// лежат внутри буфера, поэтому во внутреннем цикле обхода нет проверок границ
+struct PaddedMask {
+    int depth, height, width;
+    size_t row, plane;
+    ScratchVector<uchar> cells;
+
+    size_t index(int z, int y, int x) const {
+        return (z + 1) * plane + (y + 1) * row + (x + 1);
+    }
+};
+
+// Грани объёма в виде битов; грань z0 — первый срез
+enum : uchar {
+    kFaceZ0 = 1 << 0,
+    kFaceZ1 = 1 << 1,
+    kFaceY0 = 1 << 2,
+    kFaceY1 = 1 << 3,
+    kFaceX0 = 1 << 4,
+    kFaceX1 = 1 << 5,
+    kAllFaces = 0x3f
+};
+
+struct FillResult {
+    size_t voxels = 0;
+    bool touches_border = false;
+    bool touches_z0 = false;
+    uchar faces = 0; // грани объёма, которых касается компонента
+};
+
+template <typename Predicate>
+PaddedMask buildPaddedMask(const std::vector<cv::Mat>& volume, Predicate is_target) {
+    PaddedMask mask;
+    mask.depth = volume.size();
+    mask.height = volume[0].rows;
+    mask.width = volume[0].cols;
+    mask.row = mask.width + 2;
+    mask.plane = mask.row * (mask.height + 2);
+
+    // Маска и стек обхода занимают один блок арены, который переиспользуется следующими анализами
+    const size_t cells = mask.plane * (mask.depth + 2);
+    ScratchArena::local().reserve(cells + 2 * mask.plane * sizeof(size_t) + 4096);
+    mask.cells.assign(cells, kCellOutside);
+
+    for (int z = 0; z < mask.depth; ++z) {
+        for (int y = 0; y < mask.height; ++y) {
+            const uchar* src = volume[z].ptr<uchar>(y);
+            uchar* dst = &mask.cells[mask.index(z, y, 0)];
+            for (int x = 0; x < mask.width; ++x) {
+                dst[x] = is_target(src[x]) ? kCellTarget : kCellOther;
+            }
+        }
+    }
+    return mask;
+}
+
+template <int N>
+std::array<std::ptrdiff_t, N> linearOffsets(const PaddedMask& mask) {
+    std::array<std::ptrdiff_t, N> result{};
+    for (int i = 0; i < N; ++i) {
+        const Offset3& o = Neighborhood<N>::offsets[i];
+        result[i] = o.dz * static_cast<std::ptrdiff_t>(mask.plane) +
+                    o.dy * static_cast<std::ptrdiff_t>(mask.row) + o.dx;
+    }
+    return result;
+}
+
+// Грань, за которую выходит сосед по смещению; у диагональных соседей — 0: если такой
+// сосед снаружи, то снаружи и один из соседей по граням, и грань уже учтена
+template <int N>
+constexpr std::array<uchar, N> outsideFaces() {
+    std::array<uchar, N> result{};
+    for (int i = 0; i < N; ++i) {
+        const Offset3& o = Neighborhood<N>::offsets[i];
+        if ((o.dz != 0) + (o.dy != 0) + (o.dx != 0) != 1) continue;
+        result[i] = o.dz < 0 ? kFaceZ0 : o.dz > 0 ? kFaceZ1 : o.dy < 0 ? kFaceY0 : o.dy > 0 ? kFaceY1
+                  : o.dx < 0 ? kFaceX0 : kFaceX1;
+    }
+    return result;
+}
+
+// Обход компоненты целевых ячеек от seed; посещённые ячейки помечаются kCellVisited,
+// для каждой ячейки компоненты вызывается visit(индекс ячейки)
+template <int N, typename Visitor>
+FillResult floodFill(PaddedMask& mask, size_t seed, ScratchVector<size_t>& stack, Visitor visit) {
+    const std::array<std::ptrdiff_t, N> offsets = linearOffsets<N>(mask);
+    constexpr std::array<uchar, N> faces = outsideFaces<N>();
+    const size_t first_layer_end = 2 * mask.plane;
+    uchar* cells = mask.cells.data();
+
+    FillResult result;
+    stack.clear();
+    stack.push_back(seed);
+    cells[seed] = kCellVisited;
+
+    while (!stack.empty()) {
+        size_t current = stack.back();
+        stack.pop_back();
+        visit(current);
+        result.voxels++;
+        if (current < first_layer_end) result.touches_z0 = true;
+
+        for (int i = 0; i < N; ++i) {
+            size_t next = current + offsets[i];
+            uchar cell = cells[next];
+            if (cell == kCellTarget) {
+                cells[next] = kCellVisited;
+                stack.push_back(next);
+            } else if (cell == kCellOutside) {
+                result.touches_border = true;
+                result.faces |= faces[i];
+            }
+        }
+    }
+    return result;
+}
+
+template <int N>
+FillResult floodFill(PaddedMask& mask, size_t seed, ScratchVector<size_t>& stack) {
+    return floodFill<N>(mask, seed, stack, [](size_t) {});
+}
+
+#endif
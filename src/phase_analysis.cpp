@@ -0,0 +1,167 @@
+#include "phase_analysis.h"
+#include "scratch_arena.h"
+#include <array>
+#include <cstdint>
+
+// Система непересекающихся множеств для предварительных меток; флаг границы
+// объединяется вместе с множествами
+struct LabelForest {
+    ScratchVector<int32_t> parent;
+    ScratchVector<uchar> phase;
+    ScratchVector<uchar> touches_border;
+
+    void reserve(size_t labels) {
+        parent.reserve(labels);
+        phase.reserve(labels);
+        touches_border.reserve(labels);
+    }
+
+    int32_t create(uchar value) {
+        int32_t label = parent.size();
+        parent.push_back(label);
+        phase.push_back(value);
+        touches_border.push_back(0);
+        return label;
+    }
+
+    int32_t find(int32_t label) {
+        while (parent[label] != label) {
+            parent[label] = parent[parent[label]];
+            label = parent[label];
+        }
+        return label;
+    }
+
+    int32_t unite(int32_t a, int32_t b) {
+        a = find(a);
+        b = find(b);
+        if (a == b) return a;
+        if (b < a) std::swap(a, b);
+        parent[b] = a;
+        touches_border[a] |= touches_border[b];
+        return a;
+    }
+};
+
+template <int N>
+static PhaseAnalysis analyzePhasesImpl(const std::vector<cv::Mat>& volume) {
+    const int depth = volume.size();
+    const int height = volume[0].rows;
+    const int width = volume[0].cols;
+
+    // Смещения упорядочены лексикографически, поэтому первая половина таблицы —
+    // соседи, уже пройденные при обходе z → y → x
+    constexpr int kBackward = N / 2;
+    const auto& offsets = Neighborhood<N>::offsets;
+
+    // Метки хранятся только для текущего и предыдущего срезов, с рамкой в один пиксель
+    const size_t row = width + 2;
+    const size_t plane = row * (height + 2);
+    ScratchArena::Scope scratch;
+    ScratchArena::local().reserve(plane * (2 * sizeof(int32_t) + sizeof(int32_t) + 2) +
+                                  256 * 256 * sizeof(size_t) + 4096);
+    ScratchVector<int32_t> labels_prev(plane, 0), labels_cur(plane, 0);
+
+    LabelForest forest;
+    forest.reserve(plane);
+    forest.create(0); // метка 0 — «нет соседа»
+
+    std::array<size_t, 256> voxels{};
+    ScratchVector<size_t> contacts(256 * 256, 0);
+
+    for (int z = 0; z < depth; ++z) {
+        const bool border_z = (z == 0 || z == depth - 1);
+
+        for (int y = 0; y < height; ++y) {
+            const uchar* src = volume[z].ptr<uchar>(y);
+            const uchar* src_up = y > 0 ? volume[z].ptr<uchar>(y - 1) : nullptr;
+            const uchar* src_prev = z > 0 ? volume[z - 1].ptr<uchar>(y) : nullptr;
+            int32_t* cur = &labels_cur[(y + 1) * row + 1];
+
+            for (int x = 0; x < width; ++x) {
+                const uchar v = src[x];
+                voxels[v]++;
+
+                // Контакты фаз по граням считаются один раз — с уже пройденной стороны
+                if (x > 0 && src[x - 1] != v) contacts[std::min(v, src[x - 1]) * 256 + std::max(v, src[x - 1])]++;
+                if (src_up && src_up[x] != v) contacts[std::min(v, src_up[x]) * 256 + std::max(v, src_up[x])]++;
+                if (src_prev && src_prev[x] != v) contacts[std::min(v, src_prev[x]) * 256 + std::max(v, src_prev[x])]++;
+
+                int32_t label = 0;
+                for (int i = 0; i < kBackward; ++i) {
+                    const Offset3& o = offsets[i];
+                    const ScratchVector<int32_t>& layer = o.dz < 0 ? labels_prev : labels_cur;
+                    int32_t neighbor = layer[(y + 1 + o.dy) * row + (x + 1 + o.dx)];
+                    if (neighbor == 0 || forest.phase[neighbor] != v) continue;
+                    label = label == 0 ? neighbor : forest.unite(label, neighbor);
+                }
+                if (label == 0) {
+                    label = forest.create(v);
+                }
+                if (border_z || y == 0 || y == height - 1 || x == 0 || x == width - 1) {
+                    forest.touches_border[forest.find(label)] = 1;
+                }
+                cur[x] = label;
+            }
+        }
+        std::swap(labels_prev, labels_cur);
+    }
+
+    PhaseAnalysis analysis;
+    analysis.total_voxels = static_cast<size_t>(depth) * height * width;
+
+    std::array<int, 256> components{}, inclusions{};
+    for (int32_t label = 1; label < static_cast<int32_t>(forest.parent.size()); ++label) {
+        if (forest.find(label) != label) continue;
+        components[forest.phase[label]]++;
+        if (!forest.touches_border[label]) inclusions[forest.phase[label]]++;
+    }
+
+    for (int v = 0; v < 256; ++v) {
+        if (voxels[v] == 0) continue;
+        analysis.phases.push_back({static_cast<uchar>(v), voxels[v],
+                                   static_cast<double>(voxels[v]) / analysis.total_voxels,
+                                   components[v], inclusions[v]});
+    }
+    for (int a = 0; a < 256; ++a) {
+        for (int b = a + 1; b < 256; ++b) {
+            if (contacts[a * 256 + b] > 0) {
+                analysis.adjacency.push_back({static_cast<uchar>(a), static_cast<uchar>(b), contacts[a * 256 + b]});
+            }
+        }
+    }
+    return analysis;
+}
+
+PhaseAnalysis analyzePhases(const std::vector<cv::Mat>& volume, Connectivity connectivity) {
+    if (volume.empty()) return {};
+    return dispatchConnectivity(connectivity, [&](auto n) {
+        return analyzePhasesImpl<decltype(n)::value>(volume);
+    });
+}
+
+nlohmann::json phaseAnalysisToJson(const PhaseAnalysis& analysis) {
+    nlohmann::json phases = nlohmann::json::object();
+    for (const auto& phase : analysis.phases) {
+        phases[std::to_string(phase.value)] = {
+                {"voxels", phase.voxels},
+                {"volume_fraction", phase.fraction},
+                {"components", phase.components},
+                {"enclosed_inclusions", phase.enclosed_inclusions}
+        };
+    }
+
+    nlohmann::json adjacency = nlohmann::json::array();
+    for (const auto& pair : analysis.adjacency) {
+        adjacency.push_back({
+                {"phases", {pair.a, pair.b}},
+                {"face_contacts", pair.contacts}
+        });
+    }
+
+    return {
+            {"total_voxels", analysis.total_voxels},
+            {"phases", phases},
+            {"adjacency", adjacency}
+    };
+}
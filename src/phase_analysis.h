@@ -0,0 +1,41 @@
+#ifndef PHASE_ANALYSIS_H
+#define PHASE_ANALYSIS_H
+
+#include "neighborhood.h"
+#include <opencv2/opencv.hpp>
+#include <nlohmann/json.hpp>
+#include <cstddef>
+#include <vector>
+
+// Метрики одной фазы (одного значения метки) многофазной сегментации
+struct PhaseStats {
+    uchar value;
+    size_t voxels;
+    double fraction;
+    int components;
+    int enclosed_inclusions; // компоненты, не касающиеся границы объёма
+};
+
+// Число пар соседних по грани вокселей разных фаз
+struct PhaseAdjacency {
+    uchar a, b;
+    size_t contacts;
+};
+
+struct PhaseAnalysis {
+    size_t total_voxels = 0;
+    std::vector<PhaseStats> phases;
+    std::vector<PhaseAdjacency> adjacency;
+};
+
+/**
+ * @brief Анализирует все фазы объёма меток за один проход
+ * @param volume Срезы, значение пикселя — номер фазы
+ * @param connectivity Связность, с которой выделяются компоненты каждой фазы
+ * @return Доли фаз, число компонент и включений, контакты между фазами
+ */
+PhaseAnalysis analyzePhases(const std::vector<cv::Mat>& volume, Connectivity connectivity = Connectivity::Six);
+
+nlohmann::json phaseAnalysisToJson(const PhaseAnalysis& analysis);
+
+#endif
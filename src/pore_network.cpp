@@ -0,0 +1,571 @@
+#include "pore_network.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+namespace {
+
+constexpr float kFar = 1e20f;
+constexpr int kThinSlab = 8; // срезов в пачке утончения; пачки одной чётности разделены пачкой другой
+
+// Одномерное квадратичное преобразование расстояний (Фельценшвальб — Хуттенлохер):
+// d[q] = min_p ((q - p)^2 + f[p]); v и z — рабочие буферы на n и n + 1 элементов
+void distanceTransform1D(const float* f, int n, float* d, int* v, float* z) {
+    int k = 0;
+    v[0] = 0;
+    z[0] = -kFar;
+    z[1] = kFar;
+    for (int q = 1; q < n; ++q) {
+        // Пересечение параболы q с параболой v[k]; z[0] = -∞ останавливает цикл
+        auto intersect = [&](int p) {
+            return ((f[q] + static_cast<float>(q) * q) - (f[p] + static_cast<float>(p) * p)) / (2.0f * (q - p));
+        };
+        float s = intersect(v[k]);
+        while (s <= z[k]) {
+            --k;
+            s = intersect(v[k]);
+        }
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = kFar;
+    }
+    k = 0;
+    for (int q = 0; q < n; ++q) {
+        while (z[k + 1] < q) ++k;
+        const float dq = static_cast<float>(q - v[k]);
+        d[q] = dq * dq + f[v[k]];
+    }
+}
+
+// Проход преобразования вдоль оси: lines линий длины n, line(i) — начало линии, stride — шаг между её элементами.
+// Соседние по номеру линии, лежащие в памяти подряд, обрабатываются блоком: при шаге в строку
+// или срез каждая прочитанная кэш-линия используется целиком.
+template <typename LineStart>
+void distancePass(float* data, int lines, int n, size_t stride, LineStart line) {
+    constexpr int kBlock = 16;
+    const int blocks = (lines + kBlock - 1) / kBlock;
+    cv::parallel_for_(cv::Range(0, blocks), [&](const cv::Range& range) {
+        std::vector<float> f(static_cast<size_t>(kBlock) * n), d(n), z(n + 1);
+        std::vector<int> v(n);
+        for (int block = range.start; block < range.end; ++block) {
+            const int first = block * kBlock;
+            float* start = data + line(first);
+            int width = 1;
+            while (width < kBlock && first + width < lines && line(first + width) == line(first) + width) ++width;
+
+            for (int q = 0; q < n; ++q) {
+                const float* src = start + q * stride;
+                for (int b = 0; b < width; ++b) f[b * n + q] = src[b];
+            }
+            for (int b = 0; b < width; ++b) {
+                distanceTransform1D(&f[b * n], n, d.data(), v.data(), z.data());
+                std::copy(d.begin(), d.end(), &f[b * n]);
+            }
+            for (int q = 0; q < n; ++q) {
+                float* dst = start + q * stride;
+                for (int b = 0; b < width; ++b) dst[b] = f[b * n + q];
+            }
+            // Линии блока, не попавшие в непрерывный отрезок, — по одной
+            for (int i = first + width; i < std::min(lines, first + kBlock); ++i) {
+                float* single = data + line(i);
+                for (int q = 0; q < n; ++q) f[q] = single[q * stride];
+                distanceTransform1D(f.data(), n, d.data(), v.data(), z.data());
+                for (int q = 0; q < n; ++q) single[q * stride] = d[q];
+            }
+        }
+    });
+}
+
+// Номер соседа со смещением (dz, dy, dx) в Neighborhood<26>::offsets (порядок z → y → x без центра)
+constexpr int neighborIndex(int dz, int dy, int dx) {
+    const int linear = (dz + 1) * 9 + (dy + 1) * 3 + dx + 1;
+    return linear > 13 ? linear - 1 : linear;
+}
+
+// Соседи октанта: для октанта (sz, sy, sx) бит b = 4bz + 2by + bx (1..7) — сосед (bz·sz, by·sy, bx·sx)
+struct OctantTables {
+    std::array<std::array<int, 8>, 8> neighbors{};
+    std::array<int, 128> euler{};           // 8 × вклад октанта в изменение эйлеровой характеристики
+    std::array<uint32_t, 26> adjacent{};    // соседи из окрестности, 26-смежные с данным
+};
+
+constexpr OctantTables makeOctantTables() {
+    OctantTables tables{};
+    for (int octant = 0; octant < 8; ++octant) {
+        const int sz = octant & 4 ? 1 : -1, sy = octant & 2 ? 1 : -1, sx = octant & 1 ? 1 : -1;
+        for (int b = 1; b < 8; ++b) {
+            tables.neighbors[octant][b] = neighborIndex(b & 4 ? sz : 0, b & 2 ? sy : 0, b & 1 ? sx : 0);
+        }
+    }
+
+    // Куб вокселя как клеточный комплекс: вершина октанта принадлежит октанту целиком, ребро —
+    // двум октантам, грань — четырём, сам куб — восьми. Вклад умножен на 8, чтобы остаться в целых.
+    for (int m = 0; m < 128; ++m) {
+        auto has = [m](int b) { return (m >> (b - 1) & 1) != 0; };
+        const int vertex = m == 0;
+        const int edges_x = !has(2) && !has(4) && !has(6) ? 1 : 0;
+        const int edges_y = !has(1) && !has(4) && !has(5) ? 1 : 0;
+        const int edges_z = !has(1) && !has(2) && !has(3) ? 1 : 0;
+        const int faces = !has(1) + !has(2) + !has(4);
+        tables.euler[m] = 8 * vertex - 4 * (edges_x + edges_y + edges_z) + 2 * faces - 1;
+    }
+
+    for (int i = 0; i < 26; ++i) {
+        const Offset3& a = Neighborhood<26>::offsets[i];
+        for (int j = 0; j < 26; ++j) {
+            const Offset3& b = Neighborhood<26>::offsets[j];
+            const int dz = a.dz - b.dz, dy = a.dy - b.dy, dx = a.dx - b.dx;
+            if (i != j && dz >= -1 && dz <= 1 && dy >= -1 && dy <= 1 && dx >= -1 && dx <= 1) {
+                tables.adjacent[i] |= 1u << j;
+            }
+        }
+    }
+    return tables;
+}
+
+constexpr OctantTables kOctants = makeOctantTables();
+
+// Направления подытераций: верх, низ, север, юг, запад, восток
+constexpr std::array<int, 6> kBorderDirections = {neighborIndex(-1, 0, 0), neighborIndex(1, 0, 0),
+                                                  neighborIndex(0, -1, 0), neighborIndex(0, 1, 0),
+                                                  neighborIndex(0, 0, -1), neighborIndex(0, 0, 1)};
+
+uint32_t neighborBits(const uchar* cells, size_t idx, const std::array<std::ptrdiff_t, 26>& offsets) {
+    uint32_t bits = 0;
+    for (int k = 0; k < 26; ++k) bits |= static_cast<uint32_t>(cells[idx + offsets[k]] == kCellTarget) << k;
+    return bits;
+}
+
+bool isEulerInvariant(uint32_t bits) {
+    int change = 0;
+    for (int octant = 0; octant < 8; ++octant) {
+        int m = 0;
+        for (int b = 1; b < 8; ++b) m |= static_cast<int>(bits >> kOctants.neighbors[octant][b] & 1) << (b - 1);
+        change += kOctants.euler[m];
+    }
+    return change == 0;
+}
+
+// Объектные соседи образуют одну 26-связную компоненту
+bool isSingleComponent(uint32_t bits) {
+    uint32_t component = bits & (~bits + 1);
+    uint32_t front = component;
+    while (front != 0) {
+        const int k = __builtin_ctz(front);
+        front &= front - 1;
+        const uint32_t added = kOctants.adjacent[k] & bits & ~component;
+        component |= added;
+        front |= added;
+    }
+    return component == bits;
+}
+
+bool isSimplePoint(uint32_t bits) {
+    return bits != 0 && isEulerInvariant(bits) && isSingleComponent(bits);
+}
+
+cv::Point3i maskCoords(const PaddedMask& mask, size_t idx) {
+    const int z = static_cast<int>(idx / mask.plane) - 1;
+    const size_t rest = idx % mask.plane;
+    return {static_cast<int>(rest % mask.row) - 1, static_cast<int>(rest / mask.row) - 1, z};
+}
+
+} // namespace
+
+std::vector<float> poreDistanceMap(const std::vector<cv::Mat>& volume, uchar body_value,
+                                   const AnalysisControl& control) {
+    if (volume.empty()) return {};
+    const int depth = static_cast<int>(volume.size());
+    const int height = volume[0].rows;
+    const int width = volume[0].cols;
+    const size_t plane = static_cast<size_t>(height) * width;
+    std::vector<float> distance(plane * depth);
+
+    cv::parallel_for_(cv::Range(0, depth), [&](const cv::Range& range) {
+        for (int z = range.start; z < range.end; ++z) {
+            for (int y = 0; y < height; ++y) {
+                const uchar* src = volume[z].ptr<uchar>(y);
+                float* dst = &distance[z * plane + static_cast<size_t>(y) * width];
+                for (int x = 0; x < width; ++x) dst[x] = src[x] == body_value ? 0.0f : kFar;
+            }
+        }
+    });
+
+    float* data = distance.data();
+    distancePass(data, depth * height, width, 1, [&](int i) { return static_cast<size_t>(i) * width; });
+    control.report({"карта расстояний", 1, 3});
+    distancePass(data, depth * width, height, width,
+                 [&](int i) { return (i / width) * plane + i % width; });
+    control.report({"карта расстояний", 2, 3});
+    distancePass(data, static_cast<int>(plane), depth, plane, [](int i) { return static_cast<size_t>(i); });
+
+    cv::parallel_for_(cv::Range(0, depth), [&](const cv::Range& range) {
+        for (size_t i = range.start * plane; i < range.end * plane; ++i) distance[i] = std::sqrt(distance[i]);
+    });
+    control.report({"карта расстояний", 3, 3});
+    return distance;
+}
+
+PaddedMask skeletonizePores(const std::vector<cv::Mat>& volume, uchar body_value, const AnalysisControl& control) {
+    PaddedMask mask = buildPaddedMask(volume, [body_value](uchar v) { return v != body_value; });
+    const std::array<std::ptrdiff_t, 26> offsets = linearOffsets<26>(mask);
+    uchar* cells = mask.cells.data();
+
+    // Воксели пор по возрастанию индекса: пачка срезов — непрерывный отрезок списка
+    std::vector<size_t> objects;
+    for (size_t idx = 0; idx < mask.cells.size(); ++idx) {
+        if (cells[idx] == kCellTarget) objects.push_back(idx);
+    }
+
+    const int slabs = (mask.depth + kThinSlab - 1) / kThinSlab;
+    std::vector<std::vector<size_t>> candidates(slabs);
+    std::vector<size_t> removed(slabs);
+
+    for (bool changed = true; changed;) {
+        changed = false;
+        std::vector<size_t> bounds(slabs + 1);
+        for (int s = 0; s <= slabs; ++s) {
+            const size_t first = (static_cast<size_t>(std::min(s * kThinSlab, mask.depth)) + 1) * mask.plane;
+            bounds[s] = std::lower_bound(objects.begin(), objects.end(), first) - objects.begin();
+        }
+
+        for (int direction = 0; direction < 6; ++direction) {
+            const std::ptrdiff_t border = offsets[kBorderDirections[direction]];
+
+            // Кандидаты собираются без изменений маски, все пачки параллельно
+            cv::parallel_for_(cv::Range(0, slabs), [&](const cv::Range& range) {
+                for (int s = range.start; s < range.end; ++s) {
+                    candidates[s].clear();
+                    for (size_t i = bounds[s]; i < bounds[s + 1]; ++i) {
+                        const size_t idx = objects[i];
+                        if (cells[idx] != kCellTarget || cells[idx + border] == kCellTarget) continue;
+                        const uint32_t bits = neighborBits(cells, idx, offsets);
+                        // Концы линий сохраняются: иначе скелет стягивается в точки
+                        if (__builtin_popcount(bits) == 1 || !isSimplePoint(bits)) continue;
+                        candidates[s].push_back(idx);
+                    }
+                }
+            });
+
+            // Удаление последовательно внутри пачки; пачки одной чётности не касаются друг друга
+            for (int parity = 0; parity < 2; ++parity) {
+                cv::parallel_for_(cv::Range(0, (slabs - parity + 1) / 2), [&](const cv::Range& range) {
+                    for (int i = range.start; i < range.end; ++i) {
+                        const int s = 2 * i + parity;
+                        removed[s] = 0;
+                        for (size_t idx : candidates[s]) {
+                            const uint32_t bits = neighborBits(cells, idx, offsets);
+                            if (__builtin_popcount(bits) == 1 || !isSimplePoint(bits)) continue;
+                            cells[idx] = kCellOther;
+                            removed[s]++;
+                        }
+                    }
+                });
+            }
+
+            size_t total = 0;
+            for (size_t count : removed) total += count;
+            changed = changed || total > 0;
+            control.report({"скелет", direction + 1, 6, static_cast<long long>(objects.size())});
+        }
+
+        objects.erase(std::remove_if(objects.begin(), objects.end(), [&](size_t idx) {
+            return cells[idx] != kCellTarget;
+        }), objects.end());
+    }
+    return mask;
+}
+
+PoreNetwork extractPoreNetwork(const PaddedMask& skeleton, const std::vector<float>& distance) {
+    PoreNetwork network;
+    const std::array<std::ptrdiff_t, 26> offsets = linearOffsets<26>(skeleton);
+    const uchar* cells = skeleton.cells.data();
+
+    std::vector<size_t> voxels;
+    std::unordered_map<size_t, int> position;
+    for (size_t idx = 0; idx < skeleton.cells.size(); ++idx) {
+        if (cells[idx] != kCellTarget) continue;
+        position.emplace(idx, static_cast<int>(voxels.size()));
+        voxels.push_back(idx);
+    }
+    network.skeleton_voxels = voxels.size();
+
+    auto neighborsOf = [&](int v) {
+        std::vector<int> result;
+        for (std::ptrdiff_t offset : offsets) {
+            const size_t idx = voxels[v] + offset;
+            if (cells[idx] == kCellTarget) result.push_back(position.at(idx));
+        }
+        return result;
+    };
+    auto radiusOf = [&](int v) {
+        const cv::Point3i p = maskCoords(skeleton, voxels[v]);
+        return distance[(static_cast<size_t>(p.z) * skeleton.height + p.y) * skeleton.width + p.x];
+    };
+    auto stepLength = [&](int a, int b) {
+        const cv::Point3i pa = maskCoords(skeleton, voxels[a]), pb = maskCoords(skeleton, voxels[b]);
+        const int order = (pa.x != pb.x) + (pa.y != pb.y) + (pa.z != pb.z);
+        return static_cast<float>(std::sqrt(static_cast<double>(order)));
+    };
+
+    std::vector<std::vector<int>> adjacency(voxels.size());
+    for (size_t v = 0; v < voxels.size(); ++v) adjacency[v] = neighborsOf(static_cast<int>(v));
+
+    // Узлы: связные группы вокселей с числом соседей, отличным от двух
+    std::vector<int> node_of(voxels.size(), -1);
+    std::vector<std::vector<int>> node_voxels;
+    auto addNode = [&](int seed) {
+        const int id = static_cast<int>(node_voxels.size());
+        node_voxels.emplace_back();
+        std::vector<int> stack = {seed};
+        node_of[seed] = id;
+        while (!stack.empty()) {
+            const int v = stack.back();
+            stack.pop_back();
+            node_voxels[id].push_back(v);
+            for (int w : adjacency[v]) {
+                if (node_of[w] < 0 && adjacency[w].size() != 2) {
+                    node_of[w] = id;
+                    stack.push_back(w);
+                }
+            }
+        }
+    };
+    for (size_t v = 0; v < voxels.size(); ++v) {
+        if (node_of[v] < 0 && adjacency[v].size() != 2) addNode(static_cast<int>(v));
+    }
+
+    // Горла: цепочки от вокселя узла до следующего узла; для каждого — наибольший радиус вдоль него
+    std::vector<uchar> traced(voxels.size(), 0);
+    std::vector<float> throat_peak;
+    auto traceFrom = [&](int node) {
+        for (size_t i = 0; i < node_voxels[node].size(); ++i) {
+            const int start = node_voxels[node][i];
+            for (int first : adjacency[start]) {
+                if (node_of[first] >= 0 || traced[first]) continue;
+                PoreThroat throat;
+                throat.a = node;
+                throat.length = stepLength(start, first);
+                throat.radius = radiusOf(first);
+                float peak = throat.radius;
+                int interior = 1;
+                int prev = start, current = first;
+                traced[current] = 1;
+                while (true) {
+                    int next = -1;
+                    for (int w : adjacency[current]) {
+                        if (w != prev) next = w;
+                    }
+                    if (next < 0 || (node_of[next] < 0 && traced[next])) {
+                        // Цепочка оборвалась на уже пройденном вокселе: её конец становится узлом
+                        node_of[current] = static_cast<int>(node_voxels.size());
+                        node_voxels.push_back({current});
+                        throat.b = node_of[current];
+                        break;
+                    }
+                    throat.length += stepLength(current, next);
+                    if (node_of[next] >= 0) {
+                        throat.b = node_of[next];
+                        break;
+                    }
+                    traced[next] = 1;
+                    throat.radius = std::min(throat.radius, radiusOf(next));
+                    peak = std::max(peak, radiusOf(next));
+                    interior++;
+                    prev = current;
+                    current = next;
+                }
+                // Петли из одного-двух вокселей возникают на углах узлов и горлами не являются
+                if (throat.a == throat.b && interior < 3) continue;
+                network.throats.push_back(throat);
+                throat_peak.push_back(peak);
+            }
+        }
+    };
+    for (int node = 0; node < static_cast<int>(node_voxels.size()); ++node) traceFrom(node);
+
+    // Замкнутые петли без развилок
+    for (size_t v = 0; v < voxels.size(); ++v) {
+        if (node_of[v] >= 0 || traced[v]) continue;
+        node_of[v] = static_cast<int>(node_voxels.size());
+        node_voxels.push_back({static_cast<int>(v)});
+        traceFrom(node_of[v]);
+    }
+
+    // Шпоры и узлы внутри одной поры: горло не длиннее локального радиуса стягивается в узел.
+    // Для шпоры радиус — наибольший вдоль неё и на её концах (шпора внутри вписанной сферы
+    // поры), для двух развилок — меньший из их радиусов (каждая во вписанной сфере другой).
+    // Цепочка между двумя концами ни с чем не связана и целиком — одна пора
+    std::vector<int> parent(node_voxels.size());
+    std::vector<float> group_radius(node_voxels.size(), 0.0f);
+    std::vector<int> group_degree(node_voxels.size(), 0);
+    for (size_t id = 0; id < node_voxels.size(); ++id) {
+        parent[id] = static_cast<int>(id);
+        for (int v : node_voxels[id]) group_radius[id] = std::max(group_radius[id], radiusOf(v));
+    }
+    for (const PoreThroat& throat : network.throats) {
+        group_degree[throat.a]++;
+        group_degree[throat.b]++;
+    }
+    auto findGroup = [&](int id) {
+        while (parent[id] != id) id = parent[id] = parent[parent[id]];
+        return id;
+    };
+    for (bool merged = true; merged;) {
+        merged = false;
+        std::vector<PoreThroat> kept;
+        std::vector<float> kept_peak;
+        kept.reserve(network.throats.size());
+        for (size_t t = 0; t < network.throats.size(); ++t) {
+            PoreThroat throat = network.throats[t];
+            throat.a = findGroup(throat.a);
+            throat.b = findGroup(throat.b);
+            const int a = throat.a, b = throat.b;
+            const bool isolated = group_degree[a] == 1 && group_degree[b] == 1;
+            const bool spur = group_degree[a] == 1 || group_degree[b] == 1;
+            const float local = spur ? std::max({group_radius[a], group_radius[b], throat_peak[t]})
+                                     : std::min(group_radius[a], group_radius[b]);
+            if (a == b || (!isolated && throat.length > local)) {
+                kept.push_back(throat);
+                kept_peak.push_back(throat_peak[t]);
+                continue;
+            }
+            parent[a] = b;
+            group_radius[b] = std::max(group_radius[a], group_radius[b]);
+            group_degree[b] += group_degree[a] - 2;
+            merged = true;
+        }
+        network.throats = std::move(kept);
+        throat_peak = std::move(kept_peak);
+    }
+    std::vector<int> compact(node_voxels.size(), -1);
+    std::vector<std::vector<int>> merged_voxels;
+    for (size_t id = 0; id < node_voxels.size(); ++id) {
+        const int group = findGroup(static_cast<int>(id));
+        if (compact[group] < 0) {
+            compact[group] = static_cast<int>(merged_voxels.size());
+            merged_voxels.emplace_back();
+        }
+        std::vector<int>& target = merged_voxels[compact[group]];
+        target.insert(target.end(), node_voxels[id].begin(), node_voxels[id].end());
+    }
+    for (PoreThroat& throat : network.throats) {
+        throat.a = compact[findGroup(throat.a)];
+        throat.b = compact[findGroup(throat.b)];
+    }
+    node_voxels = std::move(merged_voxels);
+
+    network.nodes.resize(node_voxels.size());
+    for (size_t id = 0; id < node_voxels.size(); ++id) {
+        PoreNode& node = network.nodes[id];
+        cv::Point3d sum(0, 0, 0);
+        for (int v : node_voxels[id]) {
+            const cv::Point3i p = maskCoords(skeleton, voxels[v]);
+            sum.x += p.x;
+            sum.y += p.y;
+            sum.z += p.z;
+            node.radius = std::max(node.radius, radiusOf(v));
+            node.border = node.border || p.x == 0 || p.y == 0 || p.z == 0 || p.x == skeleton.width - 1 ||
+                          p.y == skeleton.height - 1 || p.z == skeleton.depth - 1;
+        }
+        node.voxels = static_cast<int>(node_voxels[id].size());
+        node.center = cv::Point3f(static_cast<float>(sum.x / node.voxels), static_cast<float>(sum.y / node.voxels),
+                                  static_cast<float>(sum.z / node.voxels));
+    }
+    for (const PoreThroat& throat : network.throats) {
+        network.nodes[throat.a].degree++;
+        network.nodes[throat.b].degree++;
+    }
+    return network;
+}
+
+static bool savePoreNetworkGraphml(const PoreNetwork& network, std::ofstream& out) {
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        << "<graphml xmlns=\"http://graphml.graphdrawing.org/xmlns\">\n"
+        << "  <key id=\"x\" for=\"node\" attr.name=\"x\" attr.type=\"float\"/>\n"
+        << "  <key id=\"y\" for=\"node\" attr.name=\"y\" attr.type=\"float\"/>\n"
+        << "  <key id=\"z\" for=\"node\" attr.name=\"z\" attr.type=\"float\"/>\n"
+        << "  <key id=\"node_radius\" for=\"node\" attr.name=\"radius\" attr.type=\"float\"/>\n"
+        << "  <key id=\"voxels\" for=\"node\" attr.name=\"voxels\" attr.type=\"int\"/>\n"
+        << "  <key id=\"border\" for=\"node\" attr.name=\"border\" attr.type=\"boolean\"/>\n"
+        << "  <key id=\"length\" for=\"edge\" attr.name=\"length\" attr.type=\"float\"/>\n"
+        << "  <key id=\"throat_radius\" for=\"edge\" attr.name=\"radius\" attr.type=\"float\"/>\n"
+        << "  <graph id=\"pore_network\" edgedefault=\"undirected\">\n";
+    for (size_t id = 0; id < network.nodes.size(); ++id) {
+        const PoreNode& node = network.nodes[id];
+        out << "    <node id=\"n" << id << "\">"
+            << "<data key=\"x\">" << node.center.x << "</data>"
+            << "<data key=\"y\">" << node.center.y << "</data>"
+            << "<data key=\"z\">" << node.center.z << "</data>"
+            << "<data key=\"node_radius\">" << node.radius << "</data>"
+            << "<data key=\"voxels\">" << node.voxels << "</data>"
+            << "<data key=\"border\">" << (node.border ? "true" : "false") << "</data></node>\n";
+    }
+    for (size_t id = 0; id < network.throats.size(); ++id) {
+        const PoreThroat& throat = network.throats[id];
+        out << "    <edge id=\"e" << id << "\" source=\"n" << throat.a << "\" target=\"n" << throat.b << "\">"
+            << "<data key=\"length\">" << throat.length << "</data>"
+            << "<data key=\"throat_radius\">" << throat.radius << "</data></edge>\n";
+    }
+    out << "  </graph>\n</graphml>\n";
+    return static_cast<bool>(out);
+}
+
+bool savePoreNetwork(const PoreNetwork& network, const std::string& file) {
+    std::ofstream out(file);
+    if (!out) {
+        std::cerr << "❌ Не удалось открыть файл для записи сети: " << file << std::endl;
+        return false;
+    }
+
+    if (file.size() >= 8 && file.compare(file.size() - 8, 8, ".graphml") == 0) {
+        return savePoreNetworkGraphml(network, out);
+    }
+
+    nlohmann::json nodes = nlohmann::json::array();
+    for (const PoreNode& node : network.nodes) {
+        nodes.push_back({
+                {"center", {node.center.x, node.center.y, node.center.z}},
+                {"radius", node.radius},
+                {"voxels", node.voxels},
+                {"degree", node.degree},
+                {"border", node.border}
+        });
+    }
+    nlohmann::json throats = nlohmann::json::array();
+    for (const PoreThroat& throat : network.throats) {
+        throats.push_back({{"nodes", {throat.a, throat.b}}, {"length", throat.length}, {"radius", throat.radius}});
+    }
+    out << nlohmann::json{{"nodes", nodes}, {"throats", throats}}.dump() << std::endl;
+    return static_cast<bool>(out);
+}
+
+nlohmann::json poreNetworkSummaryToJson(const PoreNetwork& network) {
+    double node_radius = 0.0, throat_radius = 0.0, throat_length = 0.0;
+    size_t border = 0, isolated = 0;
+    for (const PoreNode& node : network.nodes) {
+        node_radius += node.radius;
+        border += node.border;
+        isolated += node.degree == 0;
+    }
+    for (const PoreThroat& throat : network.throats) {
+        throat_radius += throat.radius;
+        throat_length += throat.length;
+    }
+    const double nodes = std::max<size_t>(1, network.nodes.size());
+    const double throats = std::max<size_t>(1, network.throats.size());
+    return {
+            {"skeleton_voxels", network.skeleton_voxels},
+            {"nodes", network.nodes.size()},
+            {"throats", network.throats.size()},
+            {"border_nodes", border},
+            {"isolated_nodes", isolated},
+            {"coordination", 2.0 * network.throats.size() / nodes},
+            {"mean_node_radius", node_radius / nodes},
+            {"mean_throat_radius", throat_radius / throats},
+            {"mean_throat_length", throat_length / throats}
+    };
+}
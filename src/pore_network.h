@@ -0,0 +1,79 @@
+#ifndef PORE_NETWORK_H
+#define PORE_NETWORK_H
+
+#include "analysis_progress.h"
+#include "padded_mask.h"
+#include <opencv2/opencv.hpp>
+#include <nlohmann/json.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Точная евклидова карта расстояний от вокселей пор до ближайшего вокселя тела
+ *
+ * Квадраты расстояний считаются тремя проходами одномерного преобразования
+ * (Фельценшвальб — Хуттенлохер) по x, y и z; строки каждого прохода независимы и
+ * обрабатываются параллельно. Воксели тела получают 0; за границей объёма тела нет.
+ * @return Расстояния в вокселях, индекс (z * height + y) * width + x
+ */
+std::vector<float> poreDistanceMap(const std::vector<cv::Mat>& volume, uchar body_value,
+                                   const AnalysisControl& control = {});
+
+/**
+ * @brief Параллельное утончение пор до срединного скелета (Lee, Kashyap, Chu, 1994)
+ *
+ * Каждая итерация — шесть направленных подытераций. Граничные в данном направлении
+ * воксели, которые не являются концами линий и простые (сохраняется эйлерова
+ * характеристика — по таблице на 128 конфигураций октанта — и связность соседей),
+ * собираются по пачкам срезов параллельно. Затем они повторно проверяются и удаляются:
+ * сначала во всех чётных пачках одновременно, потом во всех нечётных. Пачки одной
+ * чётности не соседствуют, поэтому результат не зависит от числа потоков.
+ * @return Маска, в которой kCellTarget — воксели скелета
+ */
+PaddedMask skeletonizePores(const std::vector<cv::Mat>& volume, uchar body_value,
+                            const AnalysisControl& control = {});
+
+struct PoreNode {
+    cv::Point3f center;     // среднее вокселей узла (x, y, z)
+    float radius = 0.0f;    // наибольшее расстояние до тела среди вокселей узла
+    int voxels = 0;         // вокселей скелета в узле
+    int degree = 0;         // число горл
+    bool border = false;    // узел касается границы объёма
+};
+
+struct PoreThroat {
+    int a = 0, b = 0;       // номера узлов
+    float length = 0.0f;    // длина пути по скелету между узлами, в вокселях
+    float radius = 0.0f;    // наименьшее расстояние до тела вдоль горла
+};
+
+/**
+ * @brief Поровая сеть: узлы — развилки и концы скелета, горла — цепочки между ними
+ */
+struct PoreNetwork {
+    std::vector<PoreNode> nodes;
+    std::vector<PoreThroat> throats;
+    size_t skeleton_voxels = 0;
+};
+
+/**
+ * @brief Строит поровую сеть по скелету и карте расстояний
+ *
+ * Соседние (26-связность) воксели скелета с числом соседей, отличным от двух,
+ * объединяются в один узел; цепочки вокселей с двумя соседями становятся горлами.
+ * Замкнутые петли без развилок получают узел в первом вокселе. Затем горла не длиннее
+ * локального радиуса стягиваются: шпора к концевому узлу — если короче наибольшего
+ * радиуса вдоль неё и на её концах, горло между развилками — если короче меньшего из
+ * их радиусов; цепочка между двумя концами стягивается всегда. Стянутые узлы
+ * объединяются, так что изолированная пора даёт один узел без горл.
+ */
+PoreNetwork extractPoreNetwork(const PaddedMask& skeleton, const std::vector<float>& distance);
+
+// Сохраняет сеть в JSON или GraphML (по расширению .graphml)
+bool savePoreNetwork(const PoreNetwork& network, const std::string& file);
+
+// Сводка для хранилища результатов: число узлов и горл, координационное число, радиусы
+nlohmann::json poreNetworkSummaryToJson(const PoreNetwork& network);
+
+#endif
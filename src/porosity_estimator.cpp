@@ -0,0 +1,252 @@
+#include "porosity_estimator.h"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+bool parseSampleMode(const std::string& text, SampleMode& mode) {
+    if (text == "voxels") mode = SampleMode::Voxels;
+    else if (text == "rows") mode = SampleMode::Rows;
+    else if (text == "blocks") mode = SampleMode::Blocks;
+    else return false;
+    return true;
+}
+
+std::string sampleModeName(SampleMode mode) {
+    switch (mode) {
+        case SampleMode::Voxels: return "voxels";
+        case SampleMode::Blocks: return "blocks";
+        default: return "rows";
+    }
+}
+
+// Квантиль стандартного нормального распределения для двустороннего интервала
+static double normalQuantile(double confidence) {
+    double target = 0.5 + confidence / 2.0;
+    double lo = 0.0, hi = 10.0;
+    for (int i = 0; i < 100; ++i) {
+        double mid = (lo + hi) / 2.0;
+        double cdf = 0.5 * std::erfc(-mid / std::sqrt(2.0));
+        (cdf < target ? lo : hi) = mid;
+    }
+    return (lo + hi) / 2.0;
+}
+
+// Накопитель среднего и дисперсии по алгоритму Уэлфорда
+struct RunningStats {
+    size_t n = 0;
+    double mean = 0.0;
+    double m2 = 0.0;
+
+    void add(double value) {
+        n++;
+        double delta = value - mean;
+        mean += delta / n;
+        m2 += delta * (value - mean);
+    }
+
+    double variance() const { return n > 1 ? m2 / (n - 1) : 0.0; }
+};
+
+// Доля пор в случайных единицах одного среза; возвращает число просмотренных вокселей
+static size_t sampleSlice(const cv::Mat& slice, uchar body_value, const PorosityEstimateOptions& options,
+                          cv::RNG& rng, double& pore_fraction) {
+    const int height = slice.rows;
+    const int width = slice.cols;
+    size_t pores = 0;
+    size_t seen = 0;
+
+    switch (options.mode) {
+        case SampleMode::Voxels: {
+            const int count = 256;
+            for (int i = 0; i < count; ++i) {
+                int y = rng.uniform(0, height);
+                int x = rng.uniform(0, width);
+                pores += slice.at<uchar>(y, x) != body_value;
+            }
+            seen = count;
+            break;
+        }
+        case SampleMode::Rows: {
+            const int count = std::min(height, 8);
+            for (int i = 0; i < count; ++i) {
+                const uchar* row = slice.ptr<uchar>(rng.uniform(0, height));
+                for (int x = 0; x < width; ++x) {
+                    pores += row[x] != body_value;
+                }
+            }
+            seen = static_cast<size_t>(count) * width;
+            break;
+        }
+        case SampleMode::Blocks: {
+            // Блоки берутся из фиксированной сетки: каждый воксель покрыт ровно одним блоком,
+            // поэтому оценка (число блоков / выборка) · сумма пор несмещённая и для краевых блоков
+            const int count = 4;
+            const int block = std::max(1, options.block_size);
+            const int blocks_y = (height + block - 1) / block;
+            const int blocks_x = (width + block - 1) / block;
+            for (int i = 0; i < count; ++i) {
+                int y0 = rng.uniform(0, blocks_y) * block;
+                int x0 = rng.uniform(0, blocks_x) * block;
+                for (int y = y0; y < std::min(y0 + block, height); ++y) {
+                    const uchar* row = slice.ptr<uchar>(y);
+                    for (int x = x0; x < std::min(x0 + block, width); ++x) {
+                        pores += row[x] != body_value;
+                        seen++;
+                    }
+                }
+            }
+            double total_blocks = static_cast<double>(blocks_y) * blocks_x;
+            pore_fraction = total_blocks / count * pores / (static_cast<double>(height) * width);
+            return seen;
+        }
+    }
+
+    pore_fraction = static_cast<double>(pores) / seen;
+    return seen;
+}
+
+// LRU-кэш прочитанных срезов, ограниченный по памяти
+class SliceCache {
+public:
+    SliceCache(const SliceStack& stack, size_t capacity_bytes)
+        : stack_(stack), capacity_bytes_(capacity_bytes), read_(stack.size(), 0) {}
+
+    // Срез из кэша или с диска; пустая матрица, если срез не читается
+    const cv::Mat& acquire(int index) {
+        auto it = index_.find(index);
+        if (it != index_.end()) {
+            entries_.splice(entries_.begin(), entries_, it->second);
+            return entries_.front().second;
+        }
+
+        cv::Mat slice = readStackSlice(stack_, index);
+        reads_++;
+        distinct_ += !read_[index];
+        read_[index] = 1;
+        if (slice.empty()) {
+            return empty_;
+        }
+
+        bytes_ += slice.total() * slice.elemSize();
+        entries_.emplace_front(index, std::move(slice));
+        index_[index] = entries_.begin();
+        // Только что прочитанный срез остаётся, даже если он один больше лимита
+        while (entries_.size() > 1 && bytes_ > capacity_bytes_) {
+            const cv::Mat& oldest = entries_.back().second;
+            bytes_ -= oldest.total() * oldest.elemSize();
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+        }
+        return entries_.front().second;
+    }
+
+    size_t reads() const { return reads_; }
+    int distinct() const { return distinct_; }
+
+private:
+    using Entry = std::pair<int, cv::Mat>;
+
+    const SliceStack& stack_;
+    size_t capacity_bytes_;
+    size_t bytes_ = 0;
+    size_t reads_ = 0;
+    int distinct_ = 0;
+    std::vector<uchar> read_;
+    std::list<Entry> entries_; // в начале — последний использованный
+    std::unordered_map<int, std::list<Entry>::iterator> index_;
+    cv::Mat empty_;
+};
+
+PorosityEstimate estimatePorosity(const std::string& path, const StackLoadOptions& load, uchar body_value,
+                                  const PorosityEstimateOptions& options) {
+    auto start = std::chrono::steady_clock::now();
+    PorosityEstimate estimate;
+    estimate.confidence = options.confidence;
+
+    SliceStack stack;
+    if (!openSliceStack(path, load, stack)) {
+        return estimate;
+    }
+    const int depth = stack.size();
+    estimate.total_slices = depth;
+
+    // Страты — равные группы соседних срезов
+    const int strata_count = std::min(depth, 16);
+    std::vector<int> strata_begin(strata_count + 1);
+    for (int h = 0; h <= strata_count; ++h) {
+        strata_begin[h] = static_cast<int>(static_cast<long long>(h) * depth / strata_count);
+    }
+
+    const double z = normalQuantile(options.confidence);
+    const size_t min_rounds = 5;
+    const size_t max_rounds = 100000;
+
+    cv::RNG rng(options.seed);
+    SliceCache cache(stack, options.cache_bytes);
+    std::vector<RunningStats> strata(strata_count);
+
+    for (size_t round = 1; round <= max_rounds; ++round) {
+        for (int h = 0; h < strata_count; ++h) {
+            int index = rng.uniform(strata_begin[h], strata_begin[h + 1]);
+            const cv::Mat& slice = cache.acquire(index);
+            if (slice.empty()) {
+                std::cerr << "Failed to read slice " << index << " of " << path << std::endl;
+                estimate.slice_draws = 0;
+                return estimate;
+            }
+
+            double fraction = 0.0;
+            estimate.voxels_sampled += sampleSlice(slice, body_value, options, rng, fraction);
+            estimate.slice_draws++;
+            strata[h].add(fraction);
+        }
+
+        // Стратифицированная оценка: веса страт пропорциональны числу срезов в них
+        double porosity = 0.0;
+        double variance = 0.0;
+        for (int h = 0; h < strata_count; ++h) {
+            double weight = static_cast<double>(strata_begin[h + 1] - strata_begin[h]) / depth;
+            porosity += weight * strata[h].mean;
+            variance += weight * weight * strata[h].variance() / strata[h].n;
+        }
+        estimate.porosity = porosity;
+        estimate.half_width = z * std::sqrt(variance);
+        estimate.slices_read = cache.distinct();
+        estimate.slice_reads = cache.reads();
+        estimate.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (round >= min_rounds && estimate.half_width <= options.precision) {
+            estimate.converged = true;
+            break;
+        }
+        if (options.time_budget > 0.0 && estimate.seconds >= options.time_budget) {
+            break;
+        }
+    }
+
+    return estimate;
+}
+
+nlohmann::json porosityEstimateToJson(const PorosityEstimate& estimate, const PorosityEstimateOptions& options) {
+    return {
+            {"approximate", true},
+            {"porosity", estimate.porosity},
+            {"half_width", estimate.half_width},
+            {"confidence", estimate.confidence},
+            {"interval", {estimate.porosity - estimate.half_width, estimate.porosity + estimate.half_width}},
+            {"converged", estimate.converged},
+            {"requested_precision", options.precision},
+            {"sample_mode", sampleModeName(options.mode)},
+            {"seed", options.seed},
+            {"slice_draws", estimate.slice_draws},
+            {"voxels_sampled", estimate.voxels_sampled},
+            {"slices_read", estimate.slices_read},
+            {"slice_reads", estimate.slice_reads},
+            {"total_slices", estimate.total_slices},
+            {"seconds", estimate.seconds}
+    };
+}
@@ -0,0 +1,61 @@
+#ifndef POROSITY_ESTIMATOR_H
+#define POROSITY_ESTIMATOR_H
+
+#include "stack_loader.h"
+#include <opencv2/opencv.hpp>
+#include <nlohmann/json.hpp>
+#include <cstdint>
+#include <string>
+
+// Единица выборки внутри выбранного среза
+enum class SampleMode {
+    Voxels,
+    Rows,
+    Blocks
+};
+
+bool parseSampleMode(const std::string& text, SampleMode& mode);
+std::string sampleModeName(SampleMode mode);
+
+struct PorosityEstimateOptions {
+    SampleMode mode = SampleMode::Rows;
+    double precision = 0.001;   // целевая полуширина доверительного интервала (доля, не проценты)
+    double confidence = 0.95;
+    double time_budget = 0.0;   // ограничение по времени в секундах, 0 — без ограничения
+    uint64_t seed = 12345;
+    int block_size = 16;
+    size_t cache_bytes = size_t(64) << 20; // прочитанные срезы хранятся в LRU-кэше не больше этого объёма
+};
+
+struct PorosityEstimate {
+    double porosity = 0.0;
+    double half_width = 0.0;
+    double confidence = 0.0;
+    bool converged = false;
+    size_t slice_draws = 0;     // число выбранных срезов (первичных единиц)
+    size_t voxels_sampled = 0;
+    int slices_read = 0;        // сколько различных срезов прочитано с диска
+    size_t slice_reads = 0;     // чтений срезов с диска, включая повторные после вытеснения из кэша
+    int total_slices = 0;
+    double seconds = 0.0;
+};
+
+/**
+ * @brief Оценивает пористость по случайной выборке, не загружая весь объём
+ *
+ * Срезы делятся на страты по глубине; в каждом раунде из каждой страты выбирается
+ * случайный срез, а в нём — случайные воксели, строки или блоки. Дисперсия оценивается
+ * по средним выбранных срезов, поэтому интервал учитывает и разброс внутри среза.
+ * Выборка останавливается, когда полуширина интервала не превышает precision.
+ *
+ * @param path Папка со срезами или многостраничный TIFF; с диска читаются только выбранные
+ *             срезы и бинаризуются так же, как в loadStack (кроме порога Оцу, которому
+ *             нужна гистограмма всего объёма)
+ * @param body_value Значение тела; остальные воксели считаются порами
+ */
+PorosityEstimate estimatePorosity(const std::string& path, const StackLoadOptions& load, uchar body_value,
+                                  const PorosityEstimateOptions& options);
+
+nlohmann::json porosityEstimateToJson(const PorosityEstimate& estimate, const PorosityEstimateOptions& options);
+
+#endif
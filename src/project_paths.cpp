@@ -0,0 +1,28 @@
+#include "project_paths.h"
+#include <cstdlib>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+static std::string resolveProjectRoot() {
+    if (const char* env = std::getenv("VOLUME_PROJECT_ROOT"); env && *env) {
+        return fs::absolute(env).lexically_normal().string();
+    }
+
+    std::error_code ec;
+#ifdef PROJECT_SOURCE_ROOT
+    if (fs::exists(fs::path(PROJECT_SOURCE_ROOT) / "src" / "reference_metrics.json", ec)) {
+        return PROJECT_SOURCE_ROOT;
+    }
+#endif
+    return fs::current_path(ec).parent_path().string();
+}
+
+const std::string& projectRoot() {
+    static const std::string root = resolveProjectRoot();
+    return root;
+}
+
+std::string projectPath(const std::string& relative) {
+    return (fs::path(projectRoot()) / relative).string();
+}
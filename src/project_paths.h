@@ -0,0 +1,18 @@
+#ifndef PROJECT_PATHS_H
+#define PROJECT_PATHS_H
+
+#include <string>
+
+/**
+ * @brief Корень проекта, от которого отсчитываются data/ и src/reference_metrics.json
+ *
+ * Порядок поиска: переменная окружения VOLUME_PROJECT_ROOT, каталог исходников,
+ * записанный при сборке, и, если его нет (сборка перенесена), родитель текущего
+ * каталога — прежнее поведение при запуске из build/.
+ */
+const std::string& projectRoot();
+
+// Путь внутри проекта, например projectPath("data/output/results")
+std::string projectPath(const std::string& relative);
+
+#endif
@@ -0,0 +1,331 @@
+#include "analysis_pipeline.h"
+#include "project_paths.h"
+#include "scratch_arena.h"
+#include "stack_loader.h"
+#include "volume_pyramid.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <nlohmann/json.hpp>
+#include <sstream>
+#include <sys/resource.h>
+
+namespace fs = std::filesystem;
+
+// Параметры запуска volume_regress
+struct RegressOptions {
+    std::string data_dir = projectPath("data/slices");
+    std::string reference_path = projectPath("src/reference_metrics.json");
+    std::string baseline_path = projectPath("data/output/regress_baseline.json");
+    std::vector<int> scales = {1, 2, 4};
+    int repeat = 3;
+    int jobs = 0;              // потоков пула этапов (0 — по числу ядер)
+    double tolerance = 0.25;   // допустимое относительное замедление
+    double min_delta_ms = 5.0; // замедления меньше этого порога считаются шумом
+    bool update_baseline = false;
+};
+
+// Результат одного прогона: метрики, лучшее время из повторов и пик памяти
+struct RegressRun {
+    bool connected = false;
+    double porosity = 0.0;
+    int internal_pores = 0;
+    int floating_parts = 0;
+    size_t islands_2d = 0;
+    double load_ms = 0.0;
+    double analysis_ms = 0.0;
+    long peak_memory_kb = 0;
+    bool bricks_match = true; // кирпичная раскладка дала те же метрики, что и срезы
+};
+
+static void printRegressUsage(const char* program) {
+    std::cerr << "Пример использования: " << program << " [опции]\n"
+              << "Опции:\n"
+              << "  --data DIR             папка с наборами срезов (по умолчанию data/slices проекта)\n"
+              << "  --reference FILE       эталонные метрики (по умолчанию src/reference_metrics.json)\n"
+              << "  --baseline FILE        базовая линия времени (по умолчанию data/output/regress_baseline.json)\n"
+              << "  --scales 1,2,4         коэффициенты увеличения наборов\n"
+              << "  --repeat N             число повторов анализа, берётся лучшее время (по умолчанию 3)\n"
+              << "  --jobs N               число потоков для этапов анализа (по умолчанию — по числу ядер)\n"
+              << "  --tolerance T          допустимое замедление, доля (по умолчанию 0.25)\n"
+              << "  --min-delta-ms MS      замедления меньше MS мс не считаются регрессией (по умолчанию 5)\n"
+              << "  --update-baseline      перезаписать базовую линию результатами этого запуска\n";
+}
+
+static bool parseRegressOptions(int argc, char** argv, RegressOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next_value = [&](std::string& value) {
+            if (i + 1 >= argc) {
+                std::cerr << "Ошибка: для " << arg << " требуется значение" << std::endl;
+                return false;
+            }
+            value = argv[++i];
+            return true;
+        };
+
+        std::string value;
+        try {
+            if (arg == "--data") {
+                if (!next_value(options.data_dir)) return false;
+            } else if (arg == "--reference") {
+                if (!next_value(options.reference_path)) return false;
+            } else if (arg == "--baseline") {
+                if (!next_value(options.baseline_path)) return false;
+            } else if (arg == "--scales") {
+                if (!next_value(value)) return false;
+                options.scales.clear();
+                std::stringstream list(value);
+                for (std::string item; std::getline(list, item, ',');) {
+                    int scale = std::stoi(item);
+                    if (scale < 1) throw std::invalid_argument(item);
+                    options.scales.push_back(scale);
+                }
+            } else if (arg == "--repeat") {
+                if (!next_value(value)) return false;
+                options.repeat = std::max(1, std::stoi(value));
+            } else if (arg == "--jobs") {
+                if (!next_value(value)) return false;
+                options.jobs = std::stoi(value);
+            } else if (arg == "--tolerance") {
+                if (!next_value(value)) return false;
+                options.tolerance = std::stod(value);
+            } else if (arg == "--min-delta-ms") {
+                if (!next_value(value)) return false;
+                options.min_delta_ms = std::stod(value);
+            } else if (arg == "--update-baseline") {
+                options.update_baseline = true;
+            } else {
+                std::cerr << "Ошибка: неизвестная опция " << arg << std::endl;
+                return false;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Ошибка: некорректное значение для " << arg << ": " << value << std::endl;
+            return false;
+        }
+    }
+    return !options.scales.empty();
+}
+
+// Пик резидентной памяти процесса в КБ; на Linux счётчик сбрасывается перед каждым прогоном
+static long peakMemoryKb() {
+    std::ifstream status("/proc/self/status");
+    for (std::string line; std::getline(status, line);) {
+        if (line.rfind("VmHWM:", 0) == 0) {
+            return std::stol(line.substr(6));
+        }
+    }
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static void resetPeakMemory() {
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5";
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool sameLayoutMetrics(const SampleMetrics& a, const SampleMetrics& b) {
+    return a.connected == b.connected && a.stats.porosity == b.stats.porosity &&
+           a.stats.pore_count == b.stats.pore_count && a.floating_3d_count == b.floating_3d_count;
+}
+
+// Кирпичная раскладка (--bricks) должна давать те же метрики, что и срезы, при любой связности тела
+static bool bricksMatchSlices(const std::vector<cv::Mat>& slices, int min_voxels, TaskScheduler& scheduler) {
+    for (Connectivity connectivity : {Connectivity::Six, Connectivity::Eighteen, Connectivity::TwentySix}) {
+        AnalyzerOptions options;
+        options.connectivity = connectivity;
+        options.pore_connectivity = complementaryConnectivity(connectivity);
+        SampleMetrics flat = analyzeLoadedVolume(options, slices, {}, min_voxels, scheduler);
+        options.bricks = true;
+        SampleMetrics bricked = analyzeLoadedVolume(options, {}, toBricks(slices), min_voxels, scheduler);
+        if (!sameLayoutMetrics(flat, bricked)) return false;
+    }
+    return true;
+}
+
+// Этапы те же, что и в volume_analyzer (граф этапов конвейера), без коллажа и записи результатов
+static RegressRun runDataset(const std::string& folder, int scale, int repeat, TaskScheduler& scheduler) {
+    RegressRun run;
+    resetPeakMemory();
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<cv::Mat> slices = upsampleVolume(loadStack(folder, StackLoadOptions{}), scale);
+    run.load_ms = millisecondsSince(start);
+    if (slices.empty()) return run;
+
+    // Порог висячих тел растёт вместе с объёмом, чтобы увеличенные наборы сохраняли эталонные метрики
+    const int min_voxels = kFloatingMinVoxels * scale * scale * scale;
+    const AnalyzerOptions options;
+    run.analysis_ms = INFINITY;
+
+    for (int i = 0; i < repeat; ++i) {
+        start = std::chrono::steady_clock::now();
+        SampleMetrics metrics = analyzeLoadedVolume(options, slices, {}, min_voxels, scheduler);
+        run.analysis_ms = std::min(run.analysis_ms, millisecondsSince(start));
+
+        run.connected = metrics.connected;
+        run.porosity = metrics.stats.porosity;
+        run.internal_pores = metrics.stats.pore_count;
+        run.floating_parts = metrics.floating_3d_count;
+        run.islands_2d = metrics.islands_2d;
+    }
+
+    run.peak_memory_kb = peakMemoryKb();
+    run.bricks_match = bricksMatchSlices(slices, min_voxels, scheduler);
+    return run;
+}
+
+static nlohmann::json runToJson(const RegressRun& run) {
+    return {
+            {"connected", run.connected},
+            {"porosity", run.porosity},
+            {"internal_pores", run.internal_pores},
+            {"floating_parts", run.floating_parts},
+            {"islands_2d", run.islands_2d},
+            {"load_ms", run.load_ms},
+            {"analysis_ms", run.analysis_ms},
+            {"peak_memory_kb", run.peak_memory_kb}
+    };
+}
+
+static bool sameMetrics(const RegressRun& run, const nlohmann::json& expected) {
+    return run.connected == expected.value("connected", !run.connected) &&
+           std::abs(run.porosity - expected.value("porosity", -1.0)) <= 0.001 &&
+           run.internal_pores == expected.value("internal_pores", -1) &&
+           run.floating_parts == expected.value("floating_parts", -1);
+}
+
+static nlohmann::json loadJsonFile(const std::string& path) {
+    std::ifstream in(path);
+    if (!in.is_open()) return nlohmann::json::object();
+    try {
+        nlohmann::json data;
+        in >> data;
+        return data;
+    } catch (const std::exception& e) {
+        std::cerr << "⚠️ Не удалось разобрать " << path << ": " << e.what() << std::endl;
+        return nlohmann::json::object();
+    }
+}
+
+int main(int argc, char** argv) {
+    RegressOptions options;
+    if (!parseRegressOptions(argc, argv, options)) {
+        printRegressUsage(argv[0]);
+        return 1;
+    }
+
+    nlohmann::json reference = loadJsonFile(options.reference_path);
+    nlohmann::json baseline = loadJsonFile(options.baseline_path);
+    const bool has_baseline = baseline.contains("runs");
+    if (reference.empty()) {
+        std::cerr << "❌ Не удалось открыть эталонные метрики: " << options.reference_path << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> datasets;
+    for (const auto& entry : fs::directory_iterator(options.data_dir)) {
+        if (entry.is_directory() && reference.contains(entry.path().filename().string())) {
+            datasets.push_back(entry.path().filename().string());
+        }
+    }
+    std::sort(datasets.begin(), datasets.end());
+
+    nlohmann::json runs = nlohmann::json::object();
+    int failures = 0;
+    TaskScheduler scheduler(options.jobs);
+
+    for (int scale : options.scales) {
+        for (const std::string& name : datasets) {
+            const std::string key = name + "@x" + std::to_string(scale);
+            RegressRun run;
+            try {
+                run = runDataset((fs::path(options.data_dir) / name).string(), scale, options.repeat, scheduler);
+            } catch (const std::exception& e) {
+                std::cout << key << ": ❌ " << e.what() << std::endl;
+                failures++;
+                continue;
+            }
+            runs[key] = runToJson(run);
+
+            const nlohmann::json* previous = nullptr;
+            if (has_baseline && baseline["runs"].contains(key)) {
+                previous = &baseline["runs"][key];
+            }
+
+            std::cout << key << ": анализ " << run.analysis_ms << " мс, загрузка " << run.load_ms
+                      << " мс, пик памяти " << run.peak_memory_kb / 1024 << " МБ";
+
+            // Метрики сверяются с эталоном; расхождение, принятое в базовую линию через
+            // --update-baseline, считается известным, пока метрики не изменятся
+            bool matches_reference = sameMetrics(run, reference[name]);
+            bool known_mismatch = !matches_reference &&
+                                  (options.update_baseline || (previous && sameMetrics(run, *previous)));
+            runs[key]["reference_mismatch"] = !matches_reference;
+
+            if (!matches_reference) {
+                std::cout << (known_mismatch ? " ⚠️ известное расхождение с эталоном" : " ❌ метрики не совпадают с эталоном")
+                          << " (связность " << run.connected << ", пористость " << run.porosity
+                          << ", пор " << run.internal_pores << ", висячих " << run.floating_parts << ")";
+                if (!known_mismatch) failures++;
+            }
+
+            // Острова на срезах не входят в эталон, поэтому сверяются с базовой линией
+            if (previous && !options.update_baseline && previous->contains("islands_2d") &&
+                (*previous)["islands_2d"].get<size_t>() != run.islands_2d) {
+                std::cout << " ❌ островов на срезах: " << run.islands_2d << ", было "
+                          << (*previous)["islands_2d"].get<size_t>();
+                failures++;
+            }
+
+            if (!run.bricks_match) {
+                std::cout << " ❌ метрики кирпичной раскладки не совпадают с метриками срезов";
+                failures++;
+            }
+
+            if (previous && !options.update_baseline) {
+                double before = previous->value("analysis_ms", 0.0);
+                double delta = run.analysis_ms - before;
+                if (delta > options.min_delta_ms && run.analysis_ms > before * (1.0 + options.tolerance)) {
+                    std::cout << " ❌ замедление: было " << before << " мс (+" << (run.analysis_ms / before - 1.0) * 100
+                              << "%)";
+                    failures++;
+                }
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    printArenaStats(std::cout, ScratchArena::aggregateStats());
+
+    // Без --update-baseline базовая линия создаётся только из успешного запуска
+    if (options.update_baseline || (!has_baseline && failures == 0)) {
+        nlohmann::json output = {
+                {"tolerance", options.tolerance},
+                {"repeat", options.repeat},
+                {"runs", runs}
+        };
+        fs::create_directories(fs::path(options.baseline_path).parent_path());
+        std::ofstream out(options.baseline_path);
+        out << output.dump(4);
+        std::cout << "Базовая линия записана в: " << options.baseline_path << std::endl;
+    }
+
+    if (failures > 0) {
+        std::cout << "\n❌ Регрессий: " << failures << std::endl;
+        if (!has_baseline) {
+            std::cout << "Чтобы принять текущие метрики как известные, запустите с --update-baseline" << std::endl;
+        }
+        return 1;
+    }
+    std::cout << "\n✅ Регрессий не обнаружено" << std::endl;
+    return 0;
+}
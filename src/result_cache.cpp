@@ -0,0 +1,83 @@
+#include "result_cache.h"
+#include "project_paths.h"
+#include "xxhash64.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <nlohmann/json.hpp>
+
+#ifndef ANALYZER_VERSION
+#define ANALYZER_VERSION "dev"
+#endif
+
+namespace fs = std::filesystem;
+
+static std::string cacheDir() {
+    return projectPath("data/output/cache/");
+}
+
+bool hashSliceStack(const std::vector<std::string>& paths, uint64_t& hash) {
+    std::vector<uint64_t> file_hashes(paths.size(), 0);
+    std::vector<uchar> ok(paths.size(), 0);
+
+    cv::parallel_for_(cv::Range(0, static_cast<int>(paths.size())), [&](const cv::Range& range) {
+        for (int i = range.start; i < range.end; ++i) {
+            ok[i] = hashFile(paths[i], file_hashes[i]);
+        }
+    });
+
+    for (size_t i = 0; i < paths.size(); ++i) {
+        if (!ok[i]) {
+            std::cerr << "Не удалось прочитать файл для хеширования: " << paths[i] << std::endl;
+            return false;
+        }
+    }
+
+    hash = XXHash64::hash(file_hashes.data(), file_hashes.size() * sizeof(uint64_t));
+    return true;
+}
+
+std::string makeResultCacheKey(uint64_t stack_hash, const std::string& parameters) {
+    std::string material = std::string("version=") + ANALYZER_VERSION +
+                           ";stack=" + hashToHex(stack_hash) + ";" + parameters;
+    return hashToHex(XXHash64::hash(material.data(), material.size()));
+}
+
+bool lookupCachedResult(const std::string& cube_name, const std::string& key, CachedMetrics& metrics) {
+    std::ifstream in(cacheDir() + cube_name + ".json");
+    if (!in) return false;
+
+    nlohmann::json entry;
+    try {
+        in >> entry;
+        if (entry.value("key", "") != key) return false;
+
+        const auto& m = entry.at("metrics");
+        metrics.connected = m.at("connected").get<bool>();
+        metrics.stats.porosity = m.at("porosity").get<double>();
+        metrics.stats.pore_count = m.at("internal_pores").get<int>();
+        metrics.floating_3d_count = m.at("floating_parts").get<int>();
+    } catch (const nlohmann::json::exception& e) {
+        std::cerr << "⚠️ Повреждённая запись кэша для " << cube_name << ": " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void storeCachedResult(const std::string& cube_name, const std::string& key, const CachedMetrics& metrics) {
+    fs::create_directories(cacheDir());
+
+    nlohmann::json entry = {
+            {"key", key},
+            {"analyzer_version", ANALYZER_VERSION},
+            {"metrics", {
+                    {"connected", metrics.connected},
+                    {"porosity", metrics.stats.porosity},
+                    {"internal_pores", metrics.stats.pore_count},
+                    {"floating_parts", metrics.floating_3d_count}
+            }}
+    };
+
+    std::ofstream out(cacheDir() + cube_name + ".json");
+    out << std::setw(4) << entry << std::endl;
+}
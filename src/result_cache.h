@@ -0,0 +1,34 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include "connectivity_checker.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Метрики, которые сохраняются в кэше результатов
+struct CachedMetrics {
+    bool connected = false;
+    PorosityStats stats{0.0, 0};
+    int floating_3d_count = 0;
+};
+
+/**
+ * @brief Хеш содержимого стопки срезов: файлы хешируются параллельно (XXH64),
+ * затем хеши объединяются в порядке индексов срезов
+ * @return false, если какой-либо файл не удалось прочитать
+ */
+bool hashSliceStack(const std::vector<std::string>& paths, uint64_t& hash);
+
+/**
+ * @brief Ключ кэша: содержимое срезов, параметры анализа и версия анализатора
+ * @param parameters Строка с параметрами анализа в каноническом виде
+ */
+std::string makeResultCacheKey(uint64_t stack_hash, const std::string& parameters);
+
+// Ищет запись для набора данных; true, если ключ совпал
+bool lookupCachedResult(const std::string& cube_name, const std::string& key, CachedMetrics& metrics);
+
+void storeCachedResult(const std::string& cube_name, const std::string& key, const CachedMetrics& metrics);
+
+#endif
@@ -0,0 +1,414 @@
+#include "results_store.h"
+#include "project_paths.h"
+#include "xxhash64.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <iostream>
+#include <set>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char kIndexMagic[4] = {'V', 'R', 'I', 'X'};
+constexpr uint32_t kIndexVersion = 2;
+
+// Заголовок results.idx: сколько первых элементов уже разнесено по индексам наборов
+struct IndexHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t synced;
+};
+static_assert(sizeof(IndexHeader) == 16, "заголовок индекса хранится на диске как есть");
+constexpr off_t kIndexHeaderSize = sizeof(IndexHeader);
+
+// Элемент индекса: где в журнале лежит строка записи, когда и для какого набора она сделана
+struct IndexEntry {
+    uint64_t offset;
+    uint32_t length; // без завершающего перевода строки
+    uint32_t reserved;
+    int64_t time_ms;
+    uint64_t dataset_hash;
+};
+static_assert(sizeof(IndexEntry) == 32, "элемент индекса хранится на диске как есть");
+
+// Дескрипторы журнала и индекса; блокировка flock снимается при закрытии журнала
+struct StoreFiles {
+    int log = -1;
+    int index = -1;
+
+    ~StoreFiles() {
+        if (index >= 0) close(index);
+        if (log >= 0) close(log);
+    }
+};
+
+// Состояние хранилища после открытия: читаются только заголовок и последний элемент индекса
+struct StoreState {
+    uint64_t indexed = 0;            // целых элементов в results.idx
+    uint64_t covered = 0;            // байт журнала, покрытых этими элементами
+    int64_t last_time_ms = 0;        // время последней записи
+    bool datasets_valid = true;      // индексам наборов можно верить (results.idx не пришлось перестраивать)
+    std::vector<IndexEntry> pending; // записи, ещё не разнесённые по индексам наборов: хвост results.idx и журнала
+};
+
+std::string logPath(const std::string& dir) {
+    return (fs::path(dir) / "results.ndjson").string();
+}
+
+std::string indexPath(const std::string& dir) {
+    return (fs::path(dir) / "results.idx").string();
+}
+
+std::string datasetsDir(const std::string& dir) {
+    return (fs::path(dir) / "datasets").string();
+}
+
+// Индекс набора: элементы results.idx этого набора в порядке записи
+std::string datasetIndexPath(const std::string& dir, uint64_t hash) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.idx", static_cast<unsigned long long>(hash));
+    return (fs::path(datasetsDir(dir)) / name).string();
+}
+
+uint64_t datasetHash(const std::string& dataset) {
+    return XXHash64::hash(dataset.data(), dataset.size());
+}
+
+int64_t nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool readAt(int fd, char* data, size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t n = pread(fd, data, size, offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+off_t fileSize(int fd) {
+    struct stat st {};
+    return fstat(fd, &st) == 0 ? st.st_size : 0;
+}
+
+// Элементы [first, first + count) файла элементов, начинающихся со смещения base
+bool readEntries(int fd, off_t base, uint64_t first, uint64_t count, std::vector<IndexEntry>& entries) {
+    const size_t old_size = entries.size();
+    entries.resize(old_size + count);
+    if (count == 0 || readAt(fd, reinterpret_cast<char*>(entries.data() + old_size), count * sizeof(IndexEntry),
+                             base + static_cast<off_t>(first * sizeof(IndexEntry)))) {
+        return true;
+    }
+    entries.resize(old_size);
+    return false;
+}
+
+// Заголовок индекса; пустой файл — новый индекс. false, если файл чужой или испорчен
+bool readHeader(int fd, IndexHeader& header) {
+    std::memcpy(header.magic, kIndexMagic, 4);
+    header.version = kIndexVersion;
+    header.synced = 0;
+    off_t size = fileSize(fd);
+    if (size == 0) return true;
+    if (size < kIndexHeaderSize || !readAt(fd, reinterpret_cast<char*>(&header), sizeof(header), 0)) return false;
+    return std::memcmp(header.magic, kIndexMagic, 4) == 0 && header.version == kIndexVersion;
+}
+
+// Элементы индекса для строк журнала начиная с from; незавершённая последняя строка и
+// строки, которые не разбираются как запись, пропускаются
+void scanLog(int fd, uint64_t from, uint64_t size, std::vector<IndexEntry>& entries) {
+    if (from >= size) return;
+    std::string tail(size - from, '\0');
+    if (!readAt(fd, tail.data(), tail.size(), static_cast<off_t>(from))) return;
+
+    size_t begin = 0;
+    while (true) {
+        size_t end = tail.find('\n', begin);
+        if (end == std::string::npos) break;
+        try {
+            auto record = nlohmann::json::parse(tail.begin() + begin, tail.begin() + end);
+            entries.push_back({from + begin, static_cast<uint32_t>(end - begin), 0,
+                               record.at("time").get<int64_t>(),
+                               datasetHash(record.at("dataset").get<std::string>())});
+        } catch (const nlohmann::json::exception&) {
+        }
+        begin = end + 1;
+    }
+}
+
+// Дописывает элемент в индекс набора; элемент, который там уже есть (повтор после сбоя), пропускается
+bool appendDatasetEntry(const std::string& dir, const IndexEntry& entry) {
+    int fd = open(datasetIndexPath(dir, entry.dataset_hash).c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    // Недописанный при сбое элемент перезаписывается
+    const off_t end = fileSize(fd) / static_cast<off_t>(sizeof(IndexEntry)) * static_cast<off_t>(sizeof(IndexEntry));
+    IndexEntry last{};
+    bool ok = end > 0 && readAt(fd, reinterpret_cast<char*>(&last), sizeof(last), end - sizeof(last)) &&
+              last.offset >= entry.offset;
+    if (!ok) ok = pwrite(fd, &entry, sizeof(entry), end) == static_cast<ssize_t>(sizeof(entry));
+    close(fd);
+    return ok;
+}
+
+// Все элементы индекса набора
+std::vector<IndexEntry> loadDatasetEntries(const std::string& dir, uint64_t hash) {
+    std::vector<IndexEntry> entries;
+    int fd = open(datasetIndexPath(dir, hash).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return entries;
+    if (!readEntries(fd, 0, 0, fileSize(fd) / sizeof(IndexEntry), entries)) entries.clear();
+    close(fd);
+    return entries;
+}
+
+/**
+ * Открывает хранилище под блокировкой flock. Читаются только заголовок и последний
+ * элемент results.idx и строки журнала после него, поэтому стоимость не зависит от
+ * длины истории. Для записи хвост журнала дописывается в results.idx, а записи, не
+ * разнесённые по индексам наборов, — в них; индекс, который пришлось перестроить,
+ * перестраивается по всему журналу вместе с индексами наборов.
+ */
+bool openStore(const std::string& dir, bool writable, StoreFiles& files, StoreState& state) {
+    if (writable) {
+        std::error_code ec;
+        fs::create_directories(dir, ec);
+        files.log = open(logPath(dir).c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        files.index = open(indexPath(dir).c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    } else {
+        files.log = open(logPath(dir).c_str(), O_RDONLY | O_CLOEXEC);
+        files.index = open(indexPath(dir).c_str(), O_RDONLY | O_CLOEXEC);
+    }
+    if (files.log < 0) {
+        if (writable) {
+            std::cerr << "Не удалось открыть журнал результатов " << logPath(dir) << ": " << std::strerror(errno)
+                      << std::endl;
+        }
+        return false;
+    }
+    while (flock(files.log, writable ? LOCK_EX : LOCK_SH) != 0) {
+        if (errno != EINTR) return false;
+    }
+
+    IndexHeader header{};
+    const off_t index_size = files.index >= 0 ? fileSize(files.index) : 0;
+    bool index_ok = files.index >= 0 && readHeader(files.index, header);
+    if (index_ok && index_size >= kIndexHeaderSize) {
+        state.indexed = (index_size - kIndexHeaderSize) / sizeof(IndexEntry);
+    }
+    std::vector<IndexEntry> last;
+    if (state.indexed > 0 && !readEntries(files.index, kIndexHeaderSize, state.indexed - 1, 1, last)) {
+        index_ok = false;
+    }
+    if (!index_ok || header.synced > state.indexed) {
+        header.synced = state.indexed = 0;
+        last.clear();
+        index_ok = false;
+    }
+    // Новый индекс — тоже перестройка: индексы наборов от прежнего журнала не годятся
+    state.datasets_valid = index_ok && index_size > 0;
+    // Без каталога индексов наборов они строятся заново по results.idx
+    std::error_code ec;
+    if (header.synced > 0 && !fs::exists(datasetsDir(dir), ec)) header.synced = 0;
+    if (!last.empty()) {
+        state.covered = last[0].offset + last[0].length + 1;
+        state.last_time_ms = last[0].time_ms;
+    }
+
+    // Элементы results.idx, не разнесённые по индексам наборов (обычно их нет), и хвост журнала
+    if (!readEntries(files.index, kIndexHeaderSize, header.synced, state.indexed - header.synced, state.pending)) {
+        return false;
+    }
+    const size_t unindexed = state.pending.size();
+    int reader = writable ? open(logPath(dir).c_str(), O_RDONLY | O_CLOEXEC) : files.log;
+    scanLog(reader, state.covered, fileSize(files.log), state.pending);
+    if (writable) close(reader);
+    for (size_t i = unindexed; i < state.pending.size(); ++i) {
+        state.last_time_ms = std::max(state.last_time_ms, state.pending[i].time_ms);
+    }
+    if (!writable || files.index < 0) return true;
+
+    if (!state.datasets_valid) fs::remove_all(datasetsDir(dir), ec);
+    fs::create_directories(datasetsDir(dir), ec);
+
+    // Хвост журнала дописывается в results.idx (недописанный при сбое элемент отбрасывается)
+    const off_t tail = kIndexHeaderSize + static_cast<off_t>(state.indexed * sizeof(IndexEntry));
+    const size_t bytes = (state.pending.size() - unindexed) * sizeof(IndexEntry);
+    if (ftruncate(files.index, tail) != 0 ||
+        (bytes > 0 && pwrite(files.index, state.pending.data() + unindexed, bytes, tail) !=
+                      static_cast<ssize_t>(bytes))) {
+        return false;
+    }
+    state.indexed += state.pending.size() - unindexed;
+    if (!state.pending.empty()) state.covered = state.pending.back().offset + state.pending.back().length + 1;
+
+    for (const IndexEntry& entry : state.pending) {
+        if (!appendDatasetEntry(dir, entry)) {
+            std::cerr << "Не удалось обновить индекс набора в " << datasetsDir(dir) << std::endl;
+            return false;
+        }
+    }
+    state.pending.clear();
+    state.datasets_valid = true;
+    header.synced = state.indexed;
+    return pwrite(files.index, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header));
+}
+
+// Элементы набора: его индекс и ещё не разнесённые записи; без индексов наборов — только последние
+std::vector<IndexEntry> datasetEntries(const std::string& dir, const StoreState& state, uint64_t hash) {
+    std::vector<IndexEntry> entries;
+    if (state.datasets_valid) entries = loadDatasetEntries(dir, hash);
+    const uint64_t listed = entries.empty() ? 0 : entries.back().offset + 1;
+    for (const IndexEntry& entry : state.pending) {
+        if (entry.dataset_hash == hash && entry.offset >= listed) entries.push_back(entry);
+    }
+    return entries;
+}
+
+bool readRecord(int fd, const IndexEntry& entry, ResultRecord& record) {
+    std::string line(entry.length, '\0');
+    if (!readAt(fd, line.data(), line.size(), static_cast<off_t>(entry.offset))) return false;
+    try {
+        auto json = nlohmann::json::parse(line);
+        record.dataset = json.at("dataset").get<std::string>();
+        record.section = json.value("section", "");
+        record.time_ms = json.at("time").get<int64_t>();
+        record.data = json.value("data", nlohmann::json());
+    } catch (const nlohmann::json::exception&) {
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+std::string defaultResultsDir() {
+    return projectPath("data/output/results");
+}
+
+bool appendResultRecord(const std::string& dir, const std::string& dataset, const std::string& section,
+                        const nlohmann::json& data) {
+    StoreFiles files;
+    StoreState state;
+    if (!openStore(dir, true, files, state)) return false;
+
+    // Строка, оборванная прерванной записью, закрывается, чтобы новая запись начиналась с начала строки
+    uint64_t offset = fileSize(files.log);
+    if (offset > state.covered) {
+        char last = '\n';
+        int reader = open(logPath(dir).c_str(), O_RDONLY | O_CLOEXEC);
+        bool read_ok = reader >= 0 && readAt(reader, &last, 1, static_cast<off_t>(offset - 1));
+        if (reader >= 0) close(reader);
+        if (read_ok && last != '\n') {
+            if (!writeAll(files.log, "\n", 1)) return false;
+            offset++;
+        }
+    }
+
+    // Время записей не убывает даже при переводе часов назад: на этом держится поиск по времени
+    int64_t time_ms = std::max(nowMs(), state.last_time_ms);
+    std::string line = nlohmann::json{{"dataset", dataset}, {"section", section}, {"time", time_ms}, {"data", data}}
+                               .dump();
+    line.push_back('\n');
+    if (!writeAll(files.log, line.data(), line.size())) {
+        std::cerr << "Ошибка записи в журнал результатов: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    // Журнал уже содержит запись; индексы, которые не удалось обновить, достраиваются при следующем открытии
+    IndexEntry entry{offset, static_cast<uint32_t>(line.size() - 1), 0, time_ms, datasetHash(dataset)};
+    off_t index_end = kIndexHeaderSize + static_cast<off_t>(state.indexed * sizeof(IndexEntry));
+    if (files.index < 0 || pwrite(files.index, &entry, sizeof(entry), index_end) != sizeof(entry)) {
+        std::cerr << "⚠️ Не удалось обновить индекс результатов " << indexPath(dir) << std::endl;
+        return true;
+    }
+    const uint64_t synced = state.indexed + 1;
+    if (!appendDatasetEntry(dir, entry) ||
+        pwrite(files.index, &synced, sizeof(synced), offsetof(IndexHeader, synced)) != sizeof(synced)) {
+        std::cerr << "⚠️ Не удалось обновить индекс набора в " << datasetsDir(dir) << std::endl;
+    }
+    return true;
+}
+
+std::vector<ResultRecord> readResultHistory(const std::string& dir, const std::string& dataset,
+                                            const std::string& section, int64_t since_ms) {
+    std::vector<ResultRecord> records;
+    StoreFiles files;
+    StoreState state;
+    if (!openStore(dir, false, files, state)) return records;
+
+    // Время в индексе набора не убывает: записи раньше since_ms отсекаются двоичным поиском
+    std::vector<IndexEntry> entries = datasetEntries(dir, state, datasetHash(dataset));
+    auto first = std::lower_bound(entries.begin(), entries.end(), since_ms,
+                                  [](const IndexEntry& entry, int64_t time) { return entry.time_ms < time; });
+    for (auto it = first; it != entries.end(); ++it) {
+        ResultRecord record;
+        if (!readRecord(files.log, *it, record) || record.dataset != dataset) continue;
+        if (!section.empty() && record.section != section) continue;
+        records.push_back(std::move(record));
+    }
+    return records;
+}
+
+nlohmann::json latestResults(const std::string& dir, const std::string& dataset) {
+    nlohmann::json latest = nlohmann::json::object();
+    for (auto& record : readResultHistory(dir, dataset)) {
+        latest[record.section] = std::move(record.data);
+        latest["updated"] = record.time_ms;
+    }
+    return latest;
+}
+
+std::vector<std::string> listResultDatasets(const std::string& dir) {
+    StoreFiles files;
+    StoreState state;
+    if (!openStore(dir, false, files, state)) return {};
+
+    // Имя читается из первой записи каждого хеша: из индекса набора или из ещё не разнесённых записей
+    std::vector<IndexEntry> firsts;
+    std::error_code ec;
+    if (state.datasets_valid) {
+        for (const auto& file : fs::directory_iterator(datasetsDir(dir), ec)) {
+            if (file.path().extension() != ".idx") continue;
+            int fd = open(file.path().c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) continue;
+            readEntries(fd, 0, 0, fileSize(fd) >= static_cast<off_t>(sizeof(IndexEntry)) ? 1 : 0, firsts);
+            close(fd);
+        }
+    }
+    firsts.insert(firsts.end(), state.pending.begin(), state.pending.end());
+
+    std::set<uint64_t> seen;
+    std::set<std::string> names;
+    for (const IndexEntry& entry : firsts) {
+        if (!seen.insert(entry.dataset_hash).second) continue;
+        ResultRecord record;
+        if (readRecord(files.log, entry, record)) names.insert(record.dataset);
+    }
+    return {names.begin(), names.end()};
+}
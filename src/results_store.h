@@ -0,0 +1,52 @@
+#ifndef RESULTS_STORE_H
+#define RESULTS_STORE_H
+
+#include <nlohmann/json.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Запись хранилища: раздел результатов анализа набора данных на момент time_ms
+struct ResultRecord {
+    std::string dataset;
+    std::string section;
+    int64_t time_ms = 0; // миллисекунды от эпохи Unix
+    nlohmann::json data;
+};
+
+// Каталог хранилища по умолчанию: data/output/results проекта
+std::string defaultResultsDir();
+
+/**
+ * @brief Дописывает запись в журнал results.ndjson (одна JSON-строка на запись)
+ *
+ * Журнал, общий индекс results.idx и индекс набора datasets/<хеш имени>.idx только
+ * дописываются; перед записью читаются лишь заголовок и последний элемент results.idx,
+ * поэтому запись не зависит от размера уже накопленной истории. Процессы пакетного
+ * анализа пишут одновременно: журнал открыт с O_APPEND, а запись строки и её элементов
+ * индексов выполняется под исключительной блокировкой flock. Если индексы отстали от
+ * журнала (процесс прервался между записями), недостающие элементы достраиваются здесь же.
+ *
+ * @return false при ошибке ввода-вывода (сообщение выводится в std::cerr)
+ */
+bool appendResultRecord(const std::string& dir, const std::string& dataset, const std::string& section,
+                        const nlohmann::json& data);
+
+/**
+ * @brief История записей набора данных по его индексу, в порядке записи
+ *
+ * Читаются только элементы индекса этого набора; время в нём не убывает, поэтому
+ * начало истории с since_ms находится двоичным поиском.
+ * @param section Только указанный раздел; пустая строка — все разделы
+ * @param since_ms Только записи, сделанные не раньше этого момента
+ */
+std::vector<ResultRecord> readResultHistory(const std::string& dir, const std::string& dataset,
+                                            const std::string& section = "", int64_t since_ms = 0);
+
+// Последняя запись каждого раздела: {"раздел": данные, ..., "updated": время последней записи}
+nlohmann::json latestResults(const std::string& dir, const std::string& dataset);
+
+// Имена наборов данных, для которых есть записи (по одному индексу набора на имя)
+std::vector<std::string> listResultDatasets(const std::string& dir);
+
+#endif
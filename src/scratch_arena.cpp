@@ -0,0 +1,133 @@
+#include "scratch_arena.h"
+#include <algorithm>
+#include <mutex>
+
+static constexpr size_t kMinChunkSize = 1 << 20;
+
+// Реестр арен всех потоков для суммарной статистики
+static std::mutex registry_mutex;
+static std::vector<ScratchArena*>& registry() {
+    static std::vector<ScratchArena*> arenas;
+    return arenas;
+}
+
+ArenaStats& ArenaStats::operator+=(const ArenaStats& other) {
+    allocations += other.allocations;
+    bytes_allocated += other.bytes_allocated;
+    bytes_in_use += other.bytes_in_use;
+    peak_bytes += other.peak_bytes;
+    capacity_bytes += other.capacity_bytes;
+    system_allocations += other.system_allocations;
+    resets += other.resets;
+    return *this;
+}
+
+ScratchArena::Scope::Scope(ScratchArena& arena)
+        : arena_(arena), chunk_(arena.current_),
+          used_(arena.chunks_.empty() ? 0 : arena.chunks_[arena.current_].used) {}
+
+ScratchArena::Scope::~Scope() {
+    arena_.rewind(chunk_, used_);
+}
+
+ScratchArena::ScratchArena() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    registry().push_back(this);
+}
+
+ScratchArena::~ScratchArena() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    auto& arenas = registry();
+    arenas.erase(std::remove(arenas.begin(), arenas.end(), this), arenas.end());
+}
+
+ScratchArena& ScratchArena::local() {
+    thread_local ScratchArena arena;
+    return arena;
+}
+
+ArenaStats ScratchArena::aggregateStats() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    ArenaStats total;
+    for (const ScratchArena* arena : registry()) {
+        total += arena->stats_;
+    }
+    return total;
+}
+
+void* ScratchArena::allocate(size_t bytes, size_t alignment) {
+    stats_.allocations++;
+    stats_.bytes_allocated += bytes;
+
+    // Ищем место в текущем и следующих блоках, иначе добавляем новый
+    for (; current_ < chunks_.size(); ++current_) {
+        Chunk& chunk = chunks_[current_];
+        size_t offset = (chunk.used + alignment - 1) & ~(alignment - 1);
+        if (offset + bytes <= chunk.size) {
+            stats_.bytes_in_use += offset + bytes - chunk.used;
+            chunk.used = offset + bytes;
+            stats_.peak_bytes = std::max(stats_.peak_bytes, stats_.bytes_in_use);
+            return chunk.data.get() + offset;
+        }
+        if (current_ + 1 == chunks_.size()) break;
+    }
+
+    // Блок под размер запроса: после сброса блоки всё равно сольются в один
+    size_t size = std::max(bytes + alignment, kMinChunkSize);
+    chunks_.push_back({std::unique_ptr<unsigned char[]>(new unsigned char[size]), size, 0});
+    stats_.system_allocations++;
+    stats_.capacity_bytes += size;
+    current_ = chunks_.size() - 1;
+    return allocate(bytes, alignment);
+}
+
+void ScratchArena::deallocate(void* ptr, size_t bytes) {
+    if (chunks_.empty()) return;
+    Chunk& chunk = chunks_[current_];
+    const unsigned char* top = chunk.data.get() + chunk.used;
+    if (static_cast<unsigned char*>(ptr) + bytes == top) {
+        chunk.used -= bytes;
+        stats_.bytes_in_use -= bytes;
+    }
+}
+
+void ScratchArena::reserve(size_t bytes) {
+    if (stats_.bytes_in_use != 0 || stats_.capacity_bytes >= bytes) return;
+    chunks_.clear();
+    chunks_.push_back({std::unique_ptr<unsigned char[]>(new unsigned char[bytes]), bytes, 0});
+    current_ = 0;
+    stats_.system_allocations++;
+    stats_.capacity_bytes = bytes;
+}
+
+void ScratchArena::rewind(size_t chunk, size_t used) {
+    if (chunks_.empty()) return;
+
+    for (size_t i = chunk + 1; i < chunks_.size(); ++i) {
+        stats_.bytes_in_use -= chunks_[i].used;
+        chunks_[i].used = 0;
+    }
+    stats_.bytes_in_use -= chunks_[chunk].used - used;
+    chunks_[chunk].used = used;
+    current_ = chunk;
+
+    // Полный сброс: несколько блоков заменяются одним, вмещающим их все
+    if (chunk == 0 && used == 0) {
+        stats_.resets++;
+        if (chunks_.size() > 1) {
+            size_t total = stats_.capacity_bytes;
+            chunks_.clear();
+            chunks_.push_back({std::unique_ptr<unsigned char[]>(new unsigned char[total]), total, 0});
+            stats_.system_allocations++;
+        }
+    }
+}
+
+void printArenaStats(std::ostream& out, const ArenaStats& stats) {
+    out << "Временная память (арена): выделений " << stats.allocations
+        << ", запрошено " << stats.bytes_allocated / 1024 << " КБ"
+        << ", пик " << stats.peak_bytes / 1024 << " КБ"
+        << ", ёмкость " << stats.capacity_bytes / 1024 << " КБ"
+        << ", системных выделений " << stats.system_allocations
+        << ", сбросов " << stats.resets << std::endl;
+}
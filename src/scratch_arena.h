@@ -0,0 +1,114 @@
+#ifndef SCRATCH_ARENA_H
+#define SCRATCH_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+// Счётчики арены; system_allocations — сколько раз память бралась у системного аллокатора
+struct ArenaStats {
+    size_t allocations = 0;
+    size_t bytes_allocated = 0;
+    size_t bytes_in_use = 0;
+    size_t peak_bytes = 0;
+    size_t capacity_bytes = 0;
+    size_t system_allocations = 0;
+    size_t resets = 0;
+
+    ArenaStats& operator+=(const ArenaStats& other);
+};
+
+/**
+ * @brief Линейная арена для временной памяти анализов
+ *
+ * У каждого потока своя арена (ScratchArena::local()). Память выделяется сдвигом
+ * указателя и освобождается целиком при выходе из Scope, а блоки остаются в арене
+ * и переиспользуются следующим анализом. После сброса несколько блоков сливаются
+ * в один, поэтому в пакетном режиме арена быстро выходит на один непрерывный блок.
+ */
+class ScratchArena {
+public:
+    // Область временной памяти: при разрушении всё, что выделено внутри, освобождается
+    class Scope {
+    public:
+        explicit Scope(ScratchArena& arena = ScratchArena::local());
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        ScratchArena& arena_;
+        size_t chunk_;
+        size_t used_;
+    };
+
+    ScratchArena();
+    ~ScratchArena();
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    static ScratchArena& local();
+
+    // Сумма счётчиков арен всех потоков
+    static ArenaStats aggregateStats();
+
+    void* allocate(size_t bytes, size_t alignment);
+    // Освобождает память, только если это последнее выделение; иначе ждёт выхода из Scope
+    void deallocate(void* ptr, size_t bytes);
+
+    // Заранее резервирует непрерывный блок, если арена пуста (например, по размерам объёма)
+    void reserve(size_t bytes);
+
+    const ArenaStats& stats() const { return stats_; }
+
+private:
+    struct Chunk {
+        std::unique_ptr<unsigned char[]> data;
+        size_t size;
+        size_t used;
+    };
+
+    void rewind(size_t chunk, size_t used);
+
+    std::vector<Chunk> chunks_;
+    size_t current_ = 0;
+    ArenaStats stats_;
+};
+
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    ArenaAllocator() : arena_(&ScratchArena::local()) {}
+    explicit ArenaAllocator(ScratchArena& arena) : arena_(&arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* ptr, size_t n) {
+        arena_->deallocate(ptr, n * sizeof(T));
+    }
+
+    ScratchArena* arena() const { return arena_; }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena_ == other.arena(); }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena_ != other.arena(); }
+
+private:
+    ScratchArena* arena_;
+};
+
+// Вектор во временной памяти; должен быть разрушен до выхода из Scope, в котором создан
+template <typename T>
+using ScratchVector = std::vector<T, ArenaAllocator<T>>;
+
+void printArenaStats(std::ostream& out, const ArenaStats& stats);
+
+#endif
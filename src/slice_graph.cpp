@@ -0,0 +1,338 @@
+#include "slice_graph.h"
+#include "binary_io.h"
+#include "result_cache.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+
+namespace fs = std::filesystem;
+
+static constexpr char kGraphMagic[4] = {'V', 'S', 'G', 'I'};
+static constexpr uint32_t kGraphVersion = 1;
+
+// Разметка одного среза: площади областей и отрезки строк с локальными метками
+struct SliceLabels {
+    std::vector<uint32_t> area;
+    std::vector<SliceRun> runs;
+    std::vector<uint32_t> row_runs; // число отрезков в каждой строке
+};
+
+static SliceLabels labelSlice(const cv::Mat& slice, uchar body_value, int planar) {
+    SliceLabels result;
+    cv::Mat binary, labels, stats, centroids;
+    cv::compare(slice, body_value, binary, cv::CMP_EQ);
+    int n = cv::connectedComponentsWithStats(binary, labels, stats, centroids, planar, CV_32S);
+
+    result.area.resize(n - 1);
+    for (int i = 1; i < n; ++i) {
+        result.area[i - 1] = stats.at<int>(i, cv::CC_STAT_AREA);
+    }
+
+    result.row_runs.assign(slice.rows, 0);
+    for (int y = 0; y < slice.rows; ++y) {
+        const int* row = labels.ptr<int>(y);
+        for (int x = 0; x < slice.cols;) {
+            if (row[x] == 0) {
+                ++x;
+                continue;
+            }
+            int begin = x;
+            while (x < slice.cols && row[x] == row[begin]) ++x;
+            result.runs.push_back({begin, x, static_cast<uint32_t>(row[begin] - 1)});
+            result.row_runs[y]++;
+        }
+    }
+    return result;
+}
+
+// Допустимые сдвиги по x для каждого dy между соседними срезами (смещения с dz = +1)
+template <int N>
+static std::array<std::pair<int, int>, 3> crossSliceShifts() {
+    std::array<std::pair<int, int>, 3> shifts;
+    shifts.fill({1, -1}); // пустой диапазон
+    for (const Offset3& o : Neighborhood<N>::offsets) {
+        if (o.dz != 1) continue;
+        auto& range = shifts[o.dy + 1];
+        range.first = std::min(range.first, o.dx);
+        range.second = std::max(range.second, o.dx);
+    }
+    return shifts;
+}
+
+// Рёбра между срезами z и z + 1: отрезки касаются, если сдвинутый отрезок нижнего
+// среза пересекается с отрезком верхнего
+static std::vector<std::pair<uint32_t, uint32_t>> linkSlices(const SliceGraph& graph, int z,
+                                                             const std::array<std::pair<int, int>, 3>& shifts) {
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    const size_t h = graph.height;
+
+    for (int y = 0; y < graph.height; ++y) {
+        const SliceRun* a_begin = graph.runs.data() + graph.row_runs[z * h + y];
+        const SliceRun* a_end = graph.runs.data() + graph.row_runs[z * h + y + 1];
+        if (a_begin == a_end) continue;
+
+        for (int dy = -1; dy <= 1; ++dy) {
+            const auto [dx_min, dx_max] = shifts[dy + 1];
+            const int ny = y + dy;
+            if (dx_min > dx_max || ny < 0 || ny >= graph.height) continue;
+
+            const SliceRun* b = graph.runs.data() + graph.row_runs[(z + 1) * h + ny];
+            const SliceRun* b_end = graph.runs.data() + graph.row_runs[(z + 1) * h + ny + 1];
+            for (const SliceRun* a = a_begin; a != a_end; ++a) {
+                while (b != b_end && b->x_end <= a->x_begin + dx_min) ++b;
+                for (const SliceRun* c = b; c != b_end && c->x_begin < a->x_end + dx_max; ++c) {
+                    edges.emplace_back(a->node, c->node);
+                }
+            }
+        }
+    }
+
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    return edges;
+}
+
+// 3D-компоненты — связные компоненты графа (объединение по рёбрам)
+static void finalizeSliceGraph(SliceGraph& graph) {
+    const size_t nodes = graph.node_area.size();
+    std::vector<uint32_t> parent(nodes);
+    std::iota(parent.begin(), parent.end(), 0);
+    auto find = [&](uint32_t v) {
+        while (parent[v] != v) {
+            parent[v] = parent[parent[v]];
+            v = parent[v];
+        }
+        return v;
+    };
+    for (const auto& [a, b] : graph.edges) {
+        uint32_t ra = find(a), rb = find(b);
+        if (ra != rb) parent[std::max(ra, rb)] = std::min(ra, rb);
+    }
+
+    graph.component.assign(nodes, 0);
+    graph.component_voxels.clear();
+    graph.component_touches_z0.clear();
+    std::vector<uint32_t> root_component(nodes, UINT32_MAX);
+    for (uint32_t v = 0; v < nodes; ++v) {
+        uint32_t root = find(v);
+        if (root_component[root] == UINT32_MAX) {
+            root_component[root] = graph.component_voxels.size();
+            graph.component_voxels.push_back(0);
+            graph.component_touches_z0.push_back(0);
+        }
+        uint32_t c = root_component[root];
+        graph.component[v] = c;
+        graph.component_voxels[c] += graph.node_area[v];
+        if (graph.depth > 0 && v < graph.slice_nodes[1]) graph.component_touches_z0[c] = 1;
+    }
+}
+
+SliceGraph buildSliceGraph(const std::vector<cv::Mat>& volume, uchar body_value, Connectivity connectivity) {
+    SliceGraph graph;
+    graph.body_value = body_value;
+    graph.connectivity = connectivity;
+    if (volume.empty()) return graph;
+
+    graph.depth = volume.size();
+    graph.height = volume[0].rows;
+    graph.width = volume[0].cols;
+
+    // Срезы размечаются независимо
+    std::vector<SliceLabels> slices(graph.depth);
+    const int planar = planarConnectivity(connectivity);
+    cv::parallel_for_(cv::Range(0, graph.depth), [&](const cv::Range& range) {
+        for (int z = range.start; z < range.end; ++z) {
+            slices[z] = labelSlice(volume[z], body_value, planar);
+        }
+    });
+
+    // Локальные метки переводятся в сквозную нумерацию узлов
+    graph.slice_nodes.assign(graph.depth + 1, 0);
+    for (int z = 0; z < graph.depth; ++z) {
+        graph.slice_nodes[z + 1] = graph.slice_nodes[z] + slices[z].area.size();
+    }
+    graph.row_runs.assign(static_cast<size_t>(graph.depth) * graph.height + 1, 0);
+    for (int z = 0; z < graph.depth; ++z) {
+        for (int y = 0; y < graph.height; ++y) {
+            size_t row = static_cast<size_t>(z) * graph.height + y;
+            graph.row_runs[row + 1] = graph.row_runs[row] + slices[z].row_runs[y];
+        }
+    }
+
+    graph.node_area.reserve(graph.slice_nodes.back());
+    graph.runs.reserve(graph.row_runs.back());
+    for (int z = 0; z < graph.depth; ++z) {
+        graph.node_area.insert(graph.node_area.end(), slices[z].area.begin(), slices[z].area.end());
+        for (SliceRun run : slices[z].runs) {
+            run.node += graph.slice_nodes[z];
+            graph.runs.push_back(run);
+        }
+        slices[z] = SliceLabels();
+    }
+
+    // Рёбра ищутся параллельно по парам соседних срезов
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> slice_edges(std::max(0, graph.depth - 1));
+    dispatchConnectivity(connectivity, [&](auto n) {
+        const auto shifts = crossSliceShifts<decltype(n)::value>();
+        cv::parallel_for_(cv::Range(0, static_cast<int>(slice_edges.size())), [&](const cv::Range& range) {
+            for (int z = range.start; z < range.end; ++z) {
+                slice_edges[z] = linkSlices(graph, z, shifts);
+            }
+        });
+    });
+    for (const auto& edges : slice_edges) {
+        graph.edges.insert(graph.edges.end(), edges.begin(), edges.end());
+    }
+
+    finalizeSliceGraph(graph);
+    return graph;
+}
+
+std::string sliceGraphPath(const std::string& path, Connectivity connectivity) {
+    std::string name = "component_graph_" + std::to_string(static_cast<int>(connectivity)) + ".bin";
+    if (fs::is_directory(path)) {
+        return (fs::path(path) / name).string();
+    }
+    return path + "." + name;
+}
+
+bool saveSliceGraph(const SliceGraph& graph, const std::string& file) {
+    std::ofstream out(file, std::ios::binary);
+    if (!out) {
+        std::cerr << "⚠️ Не удалось сохранить индекс компонент: " << file << std::endl;
+        return false;
+    }
+    out.write(kGraphMagic, sizeof(kGraphMagic));
+    writeValue(out, kGraphVersion);
+    writeValue<uint32_t>(out, graph.key.size());
+    out.write(graph.key.data(), graph.key.size());
+    writeValue(out, graph.body_value);
+    writeValue<int32_t>(out, static_cast<int32_t>(graph.connectivity));
+    writeValue<int32_t>(out, graph.depth);
+    writeValue<int32_t>(out, graph.height);
+    writeValue<int32_t>(out, graph.width);
+    writeArray(out, graph.slice_nodes);
+    writeArray(out, graph.node_area);
+    writeArray(out, graph.row_runs);
+    writeArray(out, graph.runs);
+    writeArray(out, graph.edges);
+    return static_cast<bool>(out);
+}
+
+bool loadSliceGraph(const std::string& file, SliceGraph& graph) {
+    std::ifstream in(file, std::ios::binary);
+    if (!in) return false;
+
+    char magic[4];
+    uint32_t version = 0, key_size = 0;
+    int32_t connectivity = 0;
+    if (!in.read(magic, sizeof(magic)) || !std::equal(magic, magic + 4, kGraphMagic)) return false;
+    if (!readValue(in, version) || version != kGraphVersion) return false;
+    if (!readValue(in, key_size)) return false;
+    graph.key.resize(key_size);
+    if (!in.read(graph.key.data(), key_size)) return false;
+
+    bool ok = readValue(in, graph.body_value) && readValue(in, connectivity) &&
+              readValue(in, graph.depth) && readValue(in, graph.height) && readValue(in, graph.width) &&
+              readArray(in, graph.slice_nodes) && readArray(in, graph.node_area) &&
+              readArray(in, graph.row_runs) && readArray(in, graph.runs) && readArray(in, graph.edges);
+    if (!ok || graph.slice_nodes.size() != static_cast<size_t>(graph.depth) + 1 ||
+        graph.row_runs.size() != static_cast<size_t>(graph.depth) * graph.height + 1) {
+        return false;
+    }
+    graph.connectivity = static_cast<Connectivity>(connectivity);
+    finalizeSliceGraph(graph);
+    return true;
+}
+
+bool loadOrBuildSliceGraph(const std::string& path, const StackLoadOptions& load, uchar body_value,
+                           Connectivity connectivity, SliceGraph& graph) {
+    // Ключ индекса — содержимое срезов и параметры, от которых зависит разметка
+    std::string key;
+    uint64_t stack_hash = 0;
+    std::vector<std::string> files = listStackFiles(path);
+    if (!files.empty() && hashSliceStack(files, stack_hash)) {
+        key = makeResultCacheKey(stack_hash,
+                                 "graph;body=" + std::to_string(body_value) +
+                                 ";connectivity=" + std::to_string(static_cast<int>(connectivity)) +
+                                 ";threshold=" + std::to_string(static_cast<int>(load.threshold_mode)) +
+                                 ":" + std::to_string(load.threshold));
+    }
+
+    const std::string file = sliceGraphPath(path, connectivity);
+    if (!key.empty() && loadSliceGraph(file, graph) && graph.key == key) {
+        std::cout << "Индекс компонент загружен: " << file << std::endl;
+        return true;
+    }
+
+    auto slices = loadStack(path, load);
+    if (slices.empty()) return false;
+
+    graph = buildSliceGraph(slices, body_value, connectivity);
+    graph.key = key;
+    std::cout << "Индекс компонент построен: " << graph.node_area.size() << " областей, "
+              << graph.edges.size() << " связей, " << graph.component_voxels.size() << " 3D-компонент" << std::endl;
+    if (!key.empty() && saveSliceGraph(graph, file)) {
+        std::cout << "Индекс сохранён в: " << file << std::endl;
+    }
+    return true;
+}
+
+int64_t sliceGraphNodeAt(const SliceGraph& graph, int z, int y, int x) {
+    if (z < 0 || z >= graph.depth || y < 0 || y >= graph.height || x < 0 || x >= graph.width) return -1;
+
+    const size_t row = static_cast<size_t>(z) * graph.height + y;
+    auto begin = graph.runs.begin() + graph.row_runs[row];
+    auto end = graph.runs.begin() + graph.row_runs[row + 1];
+    auto it = std::upper_bound(begin, end, x, [](int value, const SliceRun& run) { return value < run.x_begin; });
+    if (it == begin || (--it)->x_end <= x) return -1;
+    return it->node;
+}
+
+bool sliceGraphIsConnected(const SliceGraph& graph) {
+    if (graph.depth == 0 || graph.slice_nodes[1] == 0) return false;
+
+    // Первый отрезок нижнего среза содержит первый воксель тела в порядке обхода строк
+    const uint32_t base = graph.component[graph.runs[0].node];
+    const int top = graph.depth - 1;
+    for (uint32_t v = graph.slice_nodes[top]; v < graph.slice_nodes[top + 1]; ++v) {
+        if (graph.component[v] != base) return false;
+    }
+    return true;
+}
+
+bool sliceGraphSlicesConnected(const SliceGraph& graph, int a, int b) {
+    if (a < 0 || b < 0 || a >= graph.depth || b >= graph.depth) return false;
+
+    std::vector<uchar> in_a(graph.component_voxels.size(), 0);
+    for (uint32_t v = graph.slice_nodes[a]; v < graph.slice_nodes[a + 1]; ++v) {
+        in_a[graph.component[v]] = 1;
+    }
+    for (uint32_t v = graph.slice_nodes[b]; v < graph.slice_nodes[b + 1]; ++v) {
+        if (in_a[graph.component[v]]) return true;
+    }
+    return false;
+}
+
+int sliceGraphFloatingCount(const SliceGraph& graph, int min_voxels) {
+    int count = 0;
+    for (size_t c = 0; c < graph.component_voxels.size(); ++c) {
+        if (!graph.component_touches_z0[c] && graph.component_voxels[c] >= static_cast<uint64_t>(min_voxels)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+bool sliceGraphAttachedToBase(const SliceGraph& graph, int z, int y, int x) {
+    int64_t node = sliceGraphNodeAt(graph, z, y, x);
+    return node >= 0 && graph.component_touches_z0[graph.component[node]];
+}
+
+bool sliceGraphReachable(const SliceGraph& graph, const cv::Point3i& from, const cv::Point3i& to) {
+    int64_t a = sliceGraphNodeAt(graph, from.z, from.y, from.x);
+    int64_t b = sliceGraphNodeAt(graph, to.z, to.y, to.x);
+    return a >= 0 && b >= 0 && graph.component[a] == graph.component[b];
+}
@@ -0,0 +1,81 @@
+#ifndef SLICE_GRAPH_H
+#define SLICE_GRAPH_H
+
+#include "neighborhood.h"
+#include "stack_loader.h"
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Отрезок строки среза, принадлежащий одной 2D-компоненте тела; x_end не включается
+struct SliceRun {
+    int32_t x_begin;
+    int32_t x_end;
+    uint32_t node;
+};
+
+/**
+ * @brief Граф 2D-компонент срезов
+ *
+ * Узлы — связные области тела на каждом срезе, рёбра — касания областей соседних
+ * срезов с учётом выбранной 3D-связности. Области хранятся отрезками строк, поэтому
+ * запросы по точкам не требуют повторной загрузки срезов. 3D-компоненты объёма —
+ * связные компоненты этого графа.
+ */
+struct SliceGraph {
+    std::string key;                       // ключ содержимого срезов и параметров построения
+    uchar body_value = 255;
+    Connectivity connectivity = Connectivity::Six;
+    int depth = 0, height = 0, width = 0;
+
+    std::vector<uint32_t> slice_nodes;     // первый узел среза z; размер depth + 1
+    std::vector<uint32_t> node_area;
+    std::vector<uint64_t> row_runs;        // первый отрезок строки z * height + y; размер depth * height + 1
+    std::vector<SliceRun> runs;
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+
+    // Вычисляется после построения или загрузки
+    std::vector<uint32_t> component;       // 3D-компонента узла
+    std::vector<uint64_t> component_voxels;
+    std::vector<uchar> component_touches_z0;
+};
+
+/**
+ * @brief Строит граф: срезы размечаются cv::connectedComponentsWithStats параллельно,
+ * затем параллельно по парам соседних срезов ищутся касания отрезков
+ */
+SliceGraph buildSliceGraph(const std::vector<cv::Mat>& volume, uchar body_value, Connectivity connectivity);
+
+// Файл индекса рядом с набором данных (в папке срезов или рядом с TIFF)
+std::string sliceGraphPath(const std::string& path, Connectivity connectivity);
+
+bool saveSliceGraph(const SliceGraph& graph, const std::string& file);
+bool loadSliceGraph(const std::string& file, SliceGraph& graph);
+
+/**
+ * @brief Загружает сохранённый индекс, если срезы и параметры не изменились, иначе строит и сохраняет новый
+ * @return false, если срезы не удалось загрузить
+ */
+bool loadOrBuildSliceGraph(const std::string& path, const StackLoadOptions& load, uchar body_value,
+                           Connectivity connectivity, SliceGraph& graph);
+
+// Узел, содержащий воксель, или -1, если воксель не принадлежит телу
+int64_t sliceGraphNodeAt(const SliceGraph& graph, int z, int y, int x);
+
+// Тот же критерий, что и is3DConnected: первая область нижнего среза связана со всем телом верхнего
+bool sliceGraphIsConnected(const SliceGraph& graph);
+
+// Связаны ли тело среза a и тело среза b хотя бы одной 3D-компонентой
+bool sliceGraphSlicesConnected(const SliceGraph& graph, int a, int b);
+
+// Тот же критерий, что и countFloatingComponents
+int sliceGraphFloatingCount(const SliceGraph& graph, int min_voxels);
+
+// Связан ли воксель тела с основанием (срезом z == 0)
+bool sliceGraphAttachedToBase(const SliceGraph& graph, int z, int y, int x);
+
+// Достижим ли один воксель тела из другого
+bool sliceGraphReachable(const SliceGraph& graph, const cv::Point3i& from, const cv::Point3i& to);
+
+#endif
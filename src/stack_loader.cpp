@@ -0,0 +1,368 @@
+#include "stack_loader.h"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <regex>
+
+namespace fs = std::filesystem;
+
+bool parseThreshold(const std::string& text, StackLoadOptions& options) {
+    if (text == "otsu") {
+        options.threshold_mode = ThresholdMode::Otsu;
+        return true;
+    }
+    try {
+        size_t used = 0;
+        options.threshold = std::stod(text, &used);
+        if (used != text.size()) return false;
+    } catch (const std::exception&) {
+        return false;
+    }
+    options.threshold_mode = ThresholdMode::Fixed;
+    return true;
+}
+
+std::vector<std::string> listSliceFiles(const std::string& folder) {
+    std::vector<std::pair<int, std::string>> files;
+    std::regex re("slice_(\\d+)\\.(png|tif|tiff)");
+
+    try {
+        for (const auto& entry : fs::directory_iterator(folder)) {
+            std::string filename = entry.path().filename().string();
+            std::smatch match;
+            if (std::regex_match(filename, match, re)) {
+                files.emplace_back(std::stoi(match[1]), entry.path().string());
+            }
+        }
+    } catch (const fs::filesystem_error& e) {
+        std::cerr << "Error accessing directory: " << e.what() << std::endl;
+        return {};
+    }
+
+    // Сортируем по индексу
+    std::sort(files.begin(), files.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    std::vector<std::string> paths;
+    paths.reserve(files.size());
+    for (auto& [index, path] : files) {
+        paths.push_back(std::move(path));
+    }
+    return paths;
+}
+
+std::vector<std::string> listStackFiles(const std::string& path) {
+    std::error_code ec;
+    if (fs::is_regular_file(path, ec)) {
+        return {path};
+    }
+    return listSliceFiles(path);
+}
+
+static std::vector<SliceSource> enumerateSources(const std::string& path) {
+    std::vector<SliceSource> sources;
+    std::error_code ec;
+
+    if (fs::is_directory(path, ec)) {
+        for (auto& file : listSliceFiles(path)) {
+            sources.push_back({std::move(file), -1});
+        }
+    } else if (fs::is_regular_file(path, ec)) {
+        int pages = static_cast<int>(cv::imcount(path, cv::IMREAD_ANYDEPTH));
+        for (int page = 0; page < pages; ++page) {
+            sources.push_back({path, page});
+        }
+    }
+    return sources;
+}
+
+// Декодирование в оттенки серого с сохранением разрядности; страница TIFF ищется с начала файла,
+// поэтому для чтения всей стопки используется decodeAllSources
+static cv::Mat decodeSource(const SliceSource& source) {
+    if (source.page < 0) {
+        return cv::imread(source.path, cv::IMREAD_ANYDEPTH);
+    }
+    std::vector<cv::Mat> pages;
+    if (!cv::imreadmulti(source.path, pages, source.page, 1, cv::IMREAD_ANYDEPTH) || pages.empty()) {
+        return cv::Mat();
+    }
+    return pages[0];
+}
+
+// Последовательно декодирует страницы [begin, end) многостраничного TIFF из одного открытого файла
+template <typename Visit>
+static void decodePageRange(const std::string& path, int begin, int end, Visit& visit) {
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 7)
+    cv::ImageCollection pages(path, cv::IMREAD_ANYDEPTH);
+    for (int page = begin; page < end; ++page) {
+        cv::Mat img;
+        try {
+            img = pages.at(page);
+        } catch (const cv::Exception&) {
+        }
+        visit(page, img);
+        pages.releaseCache(page);
+    }
+#else
+    // Без ImageCollection страницы читаются пачками: переход к странице с начала файла — раз на пачку
+    constexpr int kPageBatch = 32;
+    std::vector<cv::Mat> batch;
+    for (int first = begin; first < end; first += kPageBatch) {
+        const int count = std::min(kPageBatch, end - first);
+        batch.clear();
+        if (!cv::imreadmulti(path, batch, first, count, cv::IMREAD_ANYDEPTH)) batch.clear();
+        for (int i = 0; i < count; ++i) {
+            visit(first + i, i < static_cast<int>(batch.size()) ? batch[i] : cv::Mat());
+            if (i < static_cast<int>(batch.size())) batch[i].release();
+        }
+    }
+#endif
+}
+
+/**
+ * Декодирует все срезы параллельно и передаёт каждый в visit(index, img); пустая
+ * матрица — срез не читается. Файлы папки делятся между потоками поштучно, страницы
+ * TIFF — непрерывными диапазонами, каждый из которых читается за один проход по файлу.
+ */
+template <typename Visit>
+static void decodeAllSources(const std::vector<SliceSource>& sources, Visit visit) {
+    const int count = static_cast<int>(sources.size());
+    if (count == 0) return;
+    if (sources[0].page < 0) {
+        cv::parallel_for_(cv::Range(0, count), [&](const cv::Range& range) {
+            for (int i = range.start; i < range.end; ++i) visit(i, decodeSource(sources[i]));
+        });
+        return;
+    }
+    const std::string& path = sources[0].path;
+    cv::parallel_for_(cv::Range(0, count), [&](const cv::Range& range) {
+        decodePageRange(path, range.start, range.end, visit);
+    }, std::max(1, cv::getNumThreads()));
+}
+
+template <typename T>
+static void binarizeRows(const cv::Mat& src, double threshold, cv::Mat& dst) {
+    for (int y = 0; y < src.rows; ++y) {
+        const T* in = src.ptr<T>(y);
+        uchar* out = dst.ptr<uchar>(y);
+        for (int x = 0; x < src.cols; ++x) {
+            out[x] = in[x] > threshold ? 255 : 0;
+        }
+    }
+}
+
+static bool binarizeInto(const cv::Mat& src, double threshold, cv::Mat& dst) {
+    dst.create(src.rows, src.cols, CV_8UC1);
+    switch (src.depth()) {
+        case CV_8U: binarizeRows<uchar>(src, threshold, dst); return true;
+        case CV_16U: binarizeRows<ushort>(src, threshold, dst); return true;
+        case CV_32F: binarizeRows<float>(src, threshold, dst); return true;
+        default: return false;
+    }
+}
+
+int otsuThreshold(const std::vector<uint64_t>& histogram) {
+    double total = 0.0;
+    double sum = 0.0;
+    for (size_t i = 0; i < histogram.size(); ++i) {
+        total += histogram[i];
+        sum += static_cast<double>(i) * histogram[i];
+    }
+
+    double weight_low = 0.0;
+    double sum_low = 0.0;
+    double best_variance = -1.0;
+    int best = 0;
+    for (size_t t = 0; t < histogram.size(); ++t) {
+        weight_low += histogram[t];
+        if (weight_low == 0.0) continue;
+        double weight_high = total - weight_low;
+        if (weight_high == 0.0) break;
+
+        sum_low += static_cast<double>(t) * histogram[t];
+        double mean_low = sum_low / weight_low;
+        double mean_high = (sum - sum_low) / weight_high;
+        double variance = weight_low * weight_high * (mean_low - mean_high) * (mean_low - mean_high);
+        if (variance > best_variance) {
+            best_variance = variance;
+            best = static_cast<int>(t);
+        }
+    }
+    return best;
+}
+
+// Первый проход для порога Оцу: гистограмма по всем срезам, срезы после подсчёта освобождаются
+static bool volumeHistogram(const std::vector<SliceSource>& sources, std::vector<uint64_t>& histogram) {
+    histogram.assign(65536, 0);
+    std::mutex merge_mutex;
+    bool ok = true;
+
+    decodeAllSources(sources, [&](int, const cv::Mat& img) {
+        if (img.empty() || (img.depth() != CV_8U && img.depth() != CV_16U)) {
+            std::lock_guard<std::mutex> lock(merge_mutex);
+            ok = false;
+            return;
+        }
+        std::vector<uint64_t> local(img.depth() == CV_8U ? 256 : 65536, 0);
+        for (int y = 0; y < img.rows; ++y) {
+            if (img.depth() == CV_8U) {
+                const uchar* row = img.ptr<uchar>(y);
+                for (int x = 0; x < img.cols; ++x) local[row[x]]++;
+            } else {
+                const ushort* row = img.ptr<ushort>(y);
+                for (int x = 0; x < img.cols; ++x) local[row[x]]++;
+            }
+        }
+        std::lock_guard<std::mutex> lock(merge_mutex);
+        for (size_t v = 0; v < local.size(); ++v) histogram[v] += local[v];
+    });
+
+    return ok;
+}
+
+// Режим и порог бинаризации: срезы больше 8 бит без явного порога бинаризуются по Оцу
+static bool resolveThreshold(const std::vector<SliceSource>& sources, const StackLoadOptions& options,
+                             const std::string& path, ThresholdMode& mode, double& threshold) {
+    mode = options.threshold_mode;
+    threshold = options.threshold;
+
+    if (mode != ThresholdMode::Fixed) {
+        cv::Mat probe = decodeSource(sources[0]);
+        // Гистограмма для Оцу строится только по целым 8- и 16-битным значениям
+        if (!probe.empty() && probe.depth() != CV_8U && probe.depth() != CV_16U) {
+            std::cerr << "Error: slices of " << path << " are neither 8- nor 16-bit integers; "
+                      << "set an explicit --threshold T" << std::endl;
+            return false;
+        }
+        if (mode == ThresholdMode::None && !probe.empty() && probe.depth() == CV_16U) {
+            std::cout << "Срезы 16-битные, порог не задан — используется порог Оцу" << std::endl;
+            mode = ThresholdMode::Otsu;
+        }
+    }
+
+    if (mode == ThresholdMode::Otsu) {
+        std::vector<uint64_t> histogram;
+        if (!volumeHistogram(sources, histogram)) {
+            std::cerr << "Error: failed to build histogram for " << path << std::endl;
+            return false;
+        }
+        threshold = otsuThreshold(histogram);
+        std::cout << "Порог Оцу по объёму: " << threshold << std::endl;
+    }
+    return true;
+}
+
+bool openSliceStack(const std::string& path, const StackLoadOptions& options, SliceStack& stack) {
+    stack.sources = enumerateSources(path);
+    if (stack.sources.empty()) {
+        std::cerr << "No valid slices found in folder: " << path << std::endl;
+        return false;
+    }
+    return resolveThreshold(stack.sources, options, path, stack.mode, stack.threshold);
+}
+
+// Срез стопки после бинаризации; пустая матрица, если срез не читается
+static cv::Mat binarizeForStack(const SliceStack& stack, const cv::Mat& img) {
+    if (img.empty() || stack.mode == ThresholdMode::None) {
+        return img;
+    }
+    cv::Mat binary;
+    if (!binarizeInto(img, stack.threshold, binary)) {
+        return cv::Mat();
+    }
+    return binary;
+}
+
+cv::Mat readStackSlice(const SliceStack& stack, size_t index) {
+    return binarizeForStack(stack, decodeSource(stack.sources[index]));
+}
+
+std::vector<cv::Mat> loadStack(const std::string& path, const StackLoadOptions& options) {
+    SliceStack stack;
+    if (!openSliceStack(path, options, stack)) {
+        return {};
+    }
+
+    std::vector<cv::Mat> slices(stack.size());
+    std::vector<uchar> failed(stack.size(), 0);
+
+    decodeAllSources(stack.sources, [&](int i, const cv::Mat& img) {
+        slices[i] = binarizeForStack(stack, img);
+        failed[i] = slices[i].empty();
+    });
+
+    // Нечитаемые срезы пропускаются, как и раньше
+    std::vector<cv::Mat> loaded;
+    std::vector<size_t> indices;
+    loaded.reserve(slices.size());
+    for (size_t i = 0; i < slices.size(); ++i) {
+        if (!failed[i]) {
+            loaded.push_back(std::move(slices[i]));
+            indices.push_back(i);
+        }
+    }
+
+    if (loaded.empty()) {
+        std::cerr << "No valid slices found in folder: " << path << std::endl;
+        return {};
+    }
+
+    // Проверяем размеры всех изображений
+    cv::Size first_size = loaded[0].size();
+    for (size_t i = 0; i < loaded.size(); ++i) {
+        if (loaded[i].size() != first_size) {
+            std::cerr << "Error: Slice " << indices[i] << " has different size" << std::endl;
+            return {};
+        }
+    }
+
+    std::cout << "Загрузка " << loaded.size() << " срезов из " << path
+              << " (размер: " << first_size.height << "×" << first_size.width << ")" << std::endl;
+
+    return loaded;
+}
+
+BrickVolume loadStackBricked(const std::string& path, const StackLoadOptions& options) {
+    SliceStack stack;
+    stack.sources = enumerateSources(path);
+    cv::Mat probe = stack.sources.empty() ? cv::Mat() : decodeSource(stack.sources[0]);
+    if (probe.empty()) {
+        std::cerr << "No valid slices found in folder: " << path << std::endl;
+        return {};
+    }
+    if (!resolveThreshold(stack.sources, options, path, stack.mode, stack.threshold)) {
+        return {};
+    }
+    const std::vector<SliceSource>& sources = stack.sources;
+
+    BrickVolume bricks = makeBrickVolume(static_cast<int>(sources.size()), probe.rows, probe.cols);
+    std::vector<uchar> failed(sources.size(), 0);
+
+    // Каждый срез пишет только свои ячейки, поэтому срезы раскладываются по кирпичам параллельно
+    decodeAllSources(sources, [&](int i, const cv::Mat& img) {
+        cv::Mat binary = binarizeForStack(stack, img);
+        if (binary.empty() || binary.size() != probe.size()) {
+            failed[i] = 1;
+            return;
+        }
+        for (int y = 0; y < binary.rows; ++y) {
+            storeBrickRow(bricks, i, y, binary.ptr<uchar>(y));
+        }
+    });
+
+    // Пропустить срез, как loadStack, нельзя: размер объёма в кирпичах уже задан
+    auto bad = std::find(failed.begin(), failed.end(), 1);
+    if (bad != failed.end()) {
+        std::cerr << "Error: Slice " << bad - failed.begin() << " is unreadable or has different size" << std::endl;
+        return {};
+    }
+
+    std::cout << "Загрузка " << sources.size() << " срезов в кирпичи 8³ из " << path
+              << " (размер: " << probe.rows << "×" << probe.cols << ")" << std::endl;
+    return bricks;
+}
+
+std::vector<cv::Mat> loadSlices(const std::string& folder) {
+    return loadStack(folder, StackLoadOptions{});
+}
@@ -0,0 +1,89 @@
+#ifndef STACK_LOADER_H
+#define STACK_LOADER_H
+
+#include "brick_volume.h"
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Бинаризация при декодировании: тело — воксели со значением строго больше порога
+enum class ThresholdMode {
+    None,  // 8-битные срезы загружаются как есть, остальные бинаризуются по Оцу
+    Fixed,
+    Otsu   // общий порог Оцу по гистограмме всего объёма
+};
+
+struct StackLoadOptions {
+    ThresholdMode threshold_mode = ThresholdMode::None;
+    double threshold = 0.0;
+};
+
+// Источник одного среза: отдельный файл (page < 0) или страница многостраничного TIFF
+struct SliceSource {
+    std::string path;
+    int page;
+};
+
+// Стопка, открытая для чтения отдельных срезов: источники и уже определённый порог бинаризации
+struct SliceStack {
+    std::vector<SliceSource> sources;
+    ThresholdMode mode = ThresholdMode::None;
+    double threshold = 0.0;
+
+    size_t size() const { return sources.size(); }
+};
+
+// Разбирает значение опции --threshold: число или "otsu"
+bool parseThreshold(const std::string& text, StackLoadOptions& options);
+
+// Пути к файлам slice_N.png / slice_N.tif(f) в папке, упорядоченные по N
+std::vector<std::string> listSliceFiles(const std::string& folder);
+
+// Файлы, из которых состоит стопка: срезы папки или сам многостраничный TIFF
+std::vector<std::string> listStackFiles(const std::string& path);
+
+/**
+ * @brief Открывает стопку для выборочного чтения срезов
+ *
+ * Перечисляет срезы папки или страницы TIFF и определяет режим и порог
+ * бинаризации так же, как loadStack; для порога Оцу весь объём один раз
+ * читается ради гистограммы.
+ * @return false, если срезов нет или порог определить не удалось
+ */
+bool openSliceStack(const std::string& path, const StackLoadOptions& options, SliceStack& stack);
+
+// Декодирует и бинаризует срез index, как loadStack; пустая матрица при ошибке
+cv::Mat readStackSlice(const SliceStack& stack, size_t index);
+
+/**
+ * @brief Загружает стопку срезов из папки или многостраничного TIFF
+ *
+ * Срезы декодируются параллельно с сохранением разрядности (8 или 16 бит) и сразу
+ * бинаризуются в 8-битную маску (тело — 255, фон — 0), так что 16-битная копия
+ * объёма целиком в памяти не хранится. Для порога Оцу сначала выполняется
+ * параллельный проход, собирающий гистограмму по всему объёму.
+ *
+ * @param path Папка со срезами slice_N.* или путь к многостраничному TIFF
+ * @return Пустой вектор при ошибке (сообщение выводится в std::cerr)
+ */
+std::vector<cv::Mat> loadStack(const std::string& path, const StackLoadOptions& options);
+
+/**
+ * @brief Загружает стопку сразу в кирпичи 8³ (brick_volume.h)
+ *
+ * Срезы декодируются и бинаризуются так же, как в loadStack, и параллельно
+ * раскладываются по кирпичам; полная копия объёма в виде срезов не создаётся.
+ * Нечитаемый срез или срез другого размера — ошибка.
+ *
+ * @return Пустой объём (depth == 0) при ошибке
+ */
+BrickVolume loadStackBricked(const std::string& path, const StackLoadOptions& options);
+
+// Загрузка 8-битных срезов без бинаризации
+std::vector<cv::Mat> loadSlices(const std::string& folder);
+
+// Порог Оцу по гистограмме: значения больше порога относятся к верхнему классу
+int otsuThreshold(const std::vector<uint64_t>& histogram);
+
+#endif
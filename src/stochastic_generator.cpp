@@ -0,0 +1,493 @@
+#include "stochastic_generator.h"
+#include "connectivity_checker.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <stdexcept>
+
+namespace {
+
+constexpr uchar kBody = 255;
+constexpr uchar kPore = 0;
+constexpr int kNone = -1;
+constexpr int kMaxPlacementFailures = 200;
+constexpr double kPi = 3.14159265358979323846;
+
+// SplitMix64: быстрый генератор с одинаковым результатом на всех платформах
+class Random {
+public:
+    explicit Random(uint64_t seed) : state_(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state_ += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+    double uniform(double lo, double hi) { return lo + (hi - lo) * uniform(); }
+    int integer(int lo, int hi) { return lo + static_cast<int>(next() % static_cast<uint64_t>(hi - lo + 1)); }
+
+private:
+    uint64_t state_;
+};
+
+/**
+ * Пора или полость. Для сфер и камней радиусы хранятся квадратами в целых, так что
+ * воксель относится к объекту по точному целочисленному сравнению, а одинаковые
+ * объекты дают одинаковые наборы вокселей.
+ */
+struct Object {
+    int cx = 0, cy = 0, cz = 0;
+    double reach = 0.0;    // радиус ограничивающей сферы
+    int outer2 = 0;        // сфера / полость
+    int inner2 = -1;       // камень внутри полости
+    double axes[3] = {};   // полуоси эллипсоида
+    double rotation[9] = {}; // строки — оси эллипсоида
+};
+
+// Значение вокселя со смещением (dx, dy, dz) от центра объекта; kNone — воксель не принадлежит объекту
+int objectVoxel(const Object& object, StochasticMode mode, int dx, int dy, int dz) {
+    if (mode == StochasticMode::EllipsoidPores) {
+        double sum = 0.0;
+        for (int k = 0; k < 3; ++k) {
+            const double* row = object.rotation + 3 * k;
+            double u = (row[0] * dx + row[1] * dy + row[2] * dz) / object.axes[k];
+            sum += u * u;
+        }
+        return sum <= 1.0 ? kPore : kNone;
+    }
+    int d2 = dx * dx + dy * dy + dz * dz;
+    if (d2 <= object.inner2) return kBody;
+    return d2 <= object.outer2 ? kPore : kNone;
+}
+
+double objectVolume(const Object& object, StochasticMode mode) {
+    if (mode == StochasticMode::EllipsoidPores) {
+        return 4.0 / 3.0 * kPi * object.axes[0] * object.axes[1] * object.axes[2];
+    }
+    double outer = std::pow(object.outer2, 1.5);
+    double inner = object.inner2 >= 0 ? std::pow(object.inner2, 1.5) : 0.0;
+    return 4.0 / 3.0 * kPi * (outer - inner);
+}
+
+Object randomObject(Random& rng, const StochasticOptions& options) {
+    Object object;
+    switch (options.mode) {
+        case StochasticMode::SpherePacking: {
+            double r = rng.uniform(options.min_radius, options.max_radius);
+            object.outer2 = static_cast<int>(r * r);
+            break;
+        }
+        case StochasticMode::FloatingStones: {
+            // Между камнем и стенкой полости не меньше двух вокселей пустоты
+            double outer = rng.uniform(std::max(options.min_radius, 4.0), options.max_radius);
+            double inner = rng.uniform(2.0, outer - 2.0);
+            object.outer2 = static_cast<int>(outer * outer);
+            object.inner2 = static_cast<int>(inner * inner);
+            break;
+        }
+        case StochasticMode::EllipsoidPores: {
+            double reach = 0.0;
+            for (double& axis : object.axes) {
+                axis = rng.uniform(options.min_radius, options.max_radius);
+                reach = std::max(reach, axis);
+            }
+            object.reach = reach;
+
+            // Равномерно распределённый поворот через единичный кватернион
+            double u1 = rng.uniform(), u2 = rng.uniform(), u3 = rng.uniform();
+            double a = std::sqrt(1.0 - u1), b = std::sqrt(u1);
+            double qx = a * std::sin(2 * kPi * u2), qy = a * std::cos(2 * kPi * u2);
+            double qz = b * std::sin(2 * kPi * u3), qw = b * std::cos(2 * kPi * u3);
+            double* m = object.rotation;
+            m[0] = 1 - 2 * (qy * qy + qz * qz); m[1] = 2 * (qx * qy - qz * qw); m[2] = 2 * (qx * qz + qy * qw);
+            m[3] = 2 * (qx * qy + qz * qw); m[4] = 1 - 2 * (qx * qx + qz * qz); m[5] = 2 * (qy * qz - qx * qw);
+            m[6] = 2 * (qx * qz - qy * qw); m[7] = 2 * (qy * qz + qx * qw); m[8] = 1 - 2 * (qx * qx + qy * qy);
+            return object;
+        }
+        case StochasticMode::FracturedSlabs:
+            break;
+    }
+    object.reach = std::sqrt(static_cast<double>(object.outer2));
+    return object;
+}
+
+// Ячейки для параллельной расстановки: объекты ячеек одного цвета не могут конфликтовать
+struct TileGrid {
+    int size;
+    int nx, ny, nz;
+
+    int index(int tx, int ty, int tz) const { return (tz * ny + ty) * nx + tx; }
+};
+
+void placeInTile(const StochasticOptions& options, const TileGrid& grid, int tx, int ty, int tz,
+                 std::vector<std::vector<Object>>& tiles) {
+    const int tile_index = grid.index(tx, ty, tz);
+    Random rng(options.seed ^ (0x9E3779B97F4A7C15ull * static_cast<uint64_t>(tile_index + 1)));
+    std::vector<Object>& placed = tiles[tile_index];
+
+    const int x0 = tx * grid.size, y0 = ty * grid.size, z0 = tz * grid.size;
+    const int x1 = std::min(x0 + grid.size, options.width);
+    const int y1 = std::min(y0 + grid.size, options.height);
+    const int z1 = std::min(z0 + grid.size, options.depth);
+    const double target = options.density * (x1 - x0) * (y1 - y0) * (z1 - z0);
+
+    double volume = 0.0;
+    int failures = 0;
+    while (volume < target && failures < kMaxPlacementFailures) {
+        Object candidate = randomObject(rng, options);
+        const int r = static_cast<int>(std::ceil(candidate.reach));
+
+        // Центр внутри ячейки, объект не ближе одного вокселя к границе объёма
+        int lx = std::max(x0, r + 1), hx = std::min(x1 - 1, options.width - 2 - r);
+        int ly = std::max(y0, r + 1), hy = std::min(y1 - 1, options.height - 2 - r);
+        int lz = std::max(z0, r + 1), hz = std::min(z1 - 1, options.depth - 2 - r);
+        if (lx > hx || ly > hy || lz > hz) {
+            failures++;
+            continue;
+        }
+        candidate.cx = rng.integer(lx, hx);
+        candidate.cy = rng.integer(ly, hy);
+        candidate.cz = rng.integer(lz, hz);
+
+        // Зазор в два вокселя между ограничивающими сферами исключает 26-соседство объектов
+        bool conflict = false;
+        for (int nz = std::max(0, tz - 1); nz <= std::min(grid.nz - 1, tz + 1) && !conflict; ++nz) {
+            for (int ny = std::max(0, ty - 1); ny <= std::min(grid.ny - 1, ty + 1) && !conflict; ++ny) {
+                for (int nx = std::max(0, tx - 1); nx <= std::min(grid.nx - 1, tx + 1) && !conflict; ++nx) {
+                    for (const Object& other : tiles[grid.index(nx, ny, nz)]) {
+                        double dx = candidate.cx - other.cx, dy = candidate.cy - other.cy, dz = candidate.cz - other.cz;
+                        double gap = candidate.reach + other.reach + 2.0;
+                        if (dx * dx + dy * dy + dz * dz < gap * gap) {
+                            conflict = true;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+        if (conflict) {
+            failures++;
+            continue;
+        }
+        placed.push_back(candidate);
+        volume += objectVolume(candidate, options.mode);
+        failures = 0;
+    }
+}
+
+std::vector<Object> placeObjects(const StochasticOptions& options) {
+    TileGrid grid;
+    grid.size = std::max(16, static_cast<int>(std::ceil(2 * options.max_radius)) + 2);
+    grid.nx = (options.width + grid.size - 1) / grid.size;
+    grid.ny = (options.height + grid.size - 1) / grid.size;
+    grid.nz = (options.depth + grid.size - 1) / grid.size;
+    std::vector<std::vector<Object>> tiles(static_cast<size_t>(grid.nx) * grid.ny * grid.nz);
+
+    // Восемь цветов по чётности координат ячейки; соседние ячейки всегда разного цвета
+    for (int color = 0; color < 8; ++color) {
+        std::vector<cv::Point3i> batch;
+        for (int tz = color >> 2 & 1; tz < grid.nz; tz += 2) {
+            for (int ty = color >> 1 & 1; ty < grid.ny; ty += 2) {
+                for (int tx = color & 1; tx < grid.nx; tx += 2) {
+                    batch.emplace_back(tx, ty, tz);
+                }
+            }
+        }
+        cv::parallel_for_(cv::Range(0, static_cast<int>(batch.size())), [&](const cv::Range& range) {
+            for (int i = range.start; i < range.end; ++i) {
+                placeInTile(options, grid, batch[i].x, batch[i].y, batch[i].z, tiles);
+            }
+        });
+    }
+
+    std::vector<Object> objects;
+    for (auto& tile : tiles) {
+        objects.insert(objects.end(), tile.begin(), tile.end());
+    }
+    return objects;
+}
+
+struct ObjectTruth {
+    int pores = 0;
+    int floating = 0;
+};
+
+// Поры (26-связность) и висячие камни (6-связность) одного объекта по его вокселям
+ObjectTruth measureObject(const Object& object, StochasticMode mode) {
+    const int r = static_cast<int>(std::ceil(object.reach));
+    const int n = 2 * r + 3;
+    std::vector<cv::Mat> pores, stones;
+    for (int z = 0; z < n; ++z) {
+        pores.emplace_back(n, n, CV_8UC1, cv::Scalar(kBody));
+        stones.emplace_back(n, n, CV_8UC1, cv::Scalar(0));
+    }
+    for (int z = 0; z < n; ++z) {
+        for (int y = 0; y < n; ++y) {
+            for (int x = 0; x < n; ++x) {
+                int value = objectVoxel(object, mode, x - r - 1, y - r - 1, z - r - 1);
+                if (value == kPore) pores[z].at<uchar>(y, x) = kPore;
+                else if (value == kBody) stones[z].at<uchar>(y, x) = kBody;
+            }
+        }
+    }
+
+    ObjectTruth truth;
+    truth.pores = static_cast<int>(labelComponents3D(pores, kPore, Connectivity::TwentySix).size());
+    if (object.inner2 >= 0) {
+        truth.floating = countFloatingComponents(labelComponents3D(stones, kBody, Connectivity::Six),
+                                                 kFloatingMinVoxels);
+    }
+    return truth;
+}
+
+void measureObjects(const std::vector<Object>& objects, StochasticMode mode, GroundTruth& truth) {
+    std::vector<ObjectTruth> measured(objects.size());
+    if (mode == StochasticMode::EllipsoidPores) {
+        cv::parallel_for_(cv::Range(0, static_cast<int>(objects.size())), [&](const cv::Range& range) {
+            for (int i = range.start; i < range.end; ++i) {
+                measured[i] = measureObject(objects[i], mode);
+            }
+        });
+    } else {
+        // Сферы и полости с одинаковыми радиусами совпадают по вокселям — каждая форма считается один раз
+        std::map<std::pair<int, int>, size_t> shapes;
+        std::vector<const Object*> samples;
+        for (const Object& object : objects) {
+            if (shapes.emplace(std::make_pair(object.outer2, object.inner2), samples.size()).second) {
+                samples.push_back(&object);
+            }
+        }
+        std::vector<ObjectTruth> shape_truth(samples.size());
+        cv::parallel_for_(cv::Range(0, static_cast<int>(samples.size())), [&](const cv::Range& range) {
+            for (int i = range.start; i < range.end; ++i) {
+                shape_truth[i] = measureObject(*samples[i], mode);
+            }
+        });
+        for (size_t i = 0; i < objects.size(); ++i) {
+            measured[i] = shape_truth[shapes[{objects[i].outer2, objects[i].inner2}]];
+        }
+    }
+
+    for (const ObjectTruth& object : measured) {
+        truth.internal_pores += object.pores;
+        truth.floating_parts += object.floating;
+    }
+}
+
+std::vector<cv::Mat> rasterizeObjects(const StochasticOptions& options, const std::vector<Object>& objects,
+                                      std::vector<uint64_t>& pore_voxels) {
+    std::vector<cv::Mat> slices(options.depth);
+    int max_reach = 0;
+    std::vector<std::vector<uint32_t>> by_z(options.depth);
+    for (size_t i = 0; i < objects.size(); ++i) {
+        by_z[objects[i].cz].push_back(static_cast<uint32_t>(i));
+        max_reach = std::max(max_reach, static_cast<int>(std::ceil(objects[i].reach)));
+    }
+
+    cv::parallel_for_(cv::Range(0, options.depth), [&](const cv::Range& range) {
+        for (int z = range.start; z < range.end; ++z) {
+            cv::Mat slice(options.height, options.width, CV_8UC1, cv::Scalar(kBody));
+            for (int cz = std::max(0, z - max_reach); cz <= std::min(options.depth - 1, z + max_reach); ++cz) {
+                for (uint32_t index : by_z[cz]) {
+                    const Object& object = objects[index];
+                    const int r = static_cast<int>(std::ceil(object.reach));
+                    const int dz = z - object.cz;
+                    if (std::abs(dz) > r) continue;
+                    for (int y = object.cy - r; y <= object.cy + r; ++y) {
+                        uchar* row = slice.ptr<uchar>(y);
+                        for (int x = object.cx - r; x <= object.cx + r; ++x) {
+                            if (objectVoxel(object, options.mode, x - object.cx, y - object.cy, dz) == kPore) {
+                                row[x] = kPore;
+                            }
+                        }
+                    }
+                }
+            }
+            pore_voxels[z] = slice.total() - cv::countNonZero(slice);
+            slices[z] = slice;
+        }
+    });
+    return slices;
+}
+
+struct Fracture {
+    double height, slope_x, slope_y;
+};
+
+// Нижний воксель трещины в столбце (x, y); трещина занимает thickness вокселей вверх
+int fractureBottom(const Fracture& fracture, const StochasticOptions& options, int x, int y) {
+    double h = fracture.height + fracture.slope_x * (x - options.width / 2.0) +
+               fracture.slope_y * (y - options.height / 2.0);
+    return static_cast<int>(std::lround(h - options.fracture_thickness / 2.0));
+}
+
+/**
+ * Трещины с наклоном не больше 0.5 и толщиной от 2 вокселей: в соседних столбцах
+ * их серии вокселей перекрываются, поэтому плиты по разные стороны трещины не
+ * соприкасаются гранями, а каждая плита остаётся связной.
+ */
+std::vector<Fracture> placeFractures(const StochasticOptions& options) {
+    const int count = options.fractures;
+    const int t = options.fracture_thickness;
+    const double spacing = static_cast<double>(options.depth) / (count + 1);
+    const double max_slope = std::clamp((spacing / 2.0 - t - 3.0) / (options.width + options.height), 0.0, 0.5);
+
+    Random rng(options.seed);
+    std::vector<Fracture> fractures;
+    for (int i = 0; i < count; ++i) {
+        fractures.push_back({spacing * (i + 1) + rng.uniform(-spacing / 4, spacing / 4),
+                             rng.uniform(-max_slope, max_slope), rng.uniform(-max_slope, max_slope)});
+    }
+
+    // Экстремумы плоскости — в углах объёма; между трещинами и у границ остаётся тело
+    int previous_top = -1;
+    for (const auto& fracture : fractures) {
+        int bottom = options.depth, top = -1;
+        for (int x : {0, options.width - 1}) {
+            for (int y : {0, options.height - 1}) {
+                int b = fractureBottom(fracture, options, x, y);
+                bottom = std::min(bottom, b);
+                top = std::max(top, b + t - 1);
+            }
+        }
+        if (bottom < previous_top + 3) {
+            throw std::invalid_argument("слишком много трещин для глубины объёма");
+        }
+        previous_top = top;
+    }
+    if (previous_top > options.depth - 2) {
+        throw std::invalid_argument("слишком много трещин для глубины объёма");
+    }
+    return fractures;
+}
+
+std::vector<cv::Mat> rasterizeFractures(const StochasticOptions& options, const std::vector<Fracture>& fractures,
+                                        std::vector<uint64_t>& pore_voxels) {
+    std::vector<cv::Mat> slices(options.depth);
+    cv::parallel_for_(cv::Range(0, options.depth), [&](const cv::Range& range) {
+        for (int z = range.start; z < range.end; ++z) {
+            cv::Mat slice(options.height, options.width, CV_8UC1, cv::Scalar(kBody));
+            for (int y = 0; y < options.height; ++y) {
+                uchar* row = slice.ptr<uchar>(y);
+                for (int x = 0; x < options.width; ++x) {
+                    for (const auto& fracture : fractures) {
+                        int bottom = fractureBottom(fracture, options, x, y);
+                        if (z >= bottom && z < bottom + options.fracture_thickness) {
+                            row[x] = kPore;
+                            break;
+                        }
+                    }
+                }
+            }
+            pore_voxels[z] = slice.total() - cv::countNonZero(slice);
+            slices[z] = slice;
+        }
+    });
+    return slices;
+}
+
+void validateOptions(const StochasticOptions& options) {
+    if (options.depth < 4 || options.height < 4 || options.width < 4) {
+        throw std::invalid_argument("размер объёма должен быть не меньше 4 по каждой оси");
+    }
+    if (options.min_radius < 1.0 || options.max_radius < options.min_radius) {
+        throw std::invalid_argument("радиусы должны удовлетворять 1 <= min <= max");
+    }
+    if (options.density < 0.0 || options.density > 1.0) {
+        throw std::invalid_argument("плотность должна быть в [0, 1]");
+    }
+    if (options.mode == StochasticMode::FloatingStones && options.max_radius < 4.0) {
+        throw std::invalid_argument("для висячих камней максимальный радиус полости должен быть не меньше 4");
+    }
+    if (options.mode == StochasticMode::FracturedSlabs &&
+        (options.fractures < 0 || options.fracture_thickness < 2)) {
+        throw std::invalid_argument("число трещин должно быть >= 0, толщина трещины — >= 2");
+    }
+}
+
+} // namespace
+
+bool parseStochasticMode(const std::string& text, StochasticMode& mode) {
+    if (text == "spheres") mode = StochasticMode::SpherePacking;
+    else if (text == "ellipsoids") mode = StochasticMode::EllipsoidPores;
+    else if (text == "stones") mode = StochasticMode::FloatingStones;
+    else if (text == "slabs") mode = StochasticMode::FracturedSlabs;
+    else return false;
+    return true;
+}
+
+const char* stochasticModeName(StochasticMode mode) {
+    switch (mode) {
+        case StochasticMode::SpherePacking: return "spheres";
+        case StochasticMode::EllipsoidPores: return "ellipsoids";
+        case StochasticMode::FloatingStones: return "stones";
+        case StochasticMode::FracturedSlabs: return "slabs";
+    }
+    return "unknown";
+}
+
+StochasticVolume generateStochasticVolume(const StochasticOptions& options) {
+    validateOptions(options);
+    auto start = std::chrono::steady_clock::now();
+
+    StochasticVolume volume;
+    GroundTruth& truth = volume.truth;
+    std::vector<uint64_t> pore_voxels(options.depth, 0);
+
+    if (options.mode == StochasticMode::FracturedSlabs) {
+        std::vector<Fracture> fractures = placeFractures(options);
+        volume.slices = rasterizeFractures(options, fractures, pore_voxels);
+        // Трещины выходят на границу объёма и не считаются внутренними порами;
+        // каждая плита выше нижней — висячее тело
+        truth.objects = fractures.size();
+        truth.connected = fractures.empty();
+        truth.floating_parts = static_cast<int>(fractures.size());
+    } else {
+        std::vector<Object> objects = placeObjects(options);
+        volume.slices = rasterizeObjects(options, objects, pore_voxels);
+        measureObjects(objects, options.mode, truth);
+        truth.objects = objects.size();
+        // Поры не соприкасаются и не касаются границ, так что тело вокруг них связно
+        truth.connected = true;
+    }
+
+    for (uint64_t count : pore_voxels) {
+        truth.pore_voxels += count;
+    }
+    truth.porosity = static_cast<double>(truth.pore_voxels) /
+                     (static_cast<double>(options.depth) * options.height * options.width);
+    truth.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return volume;
+}
+
+nlohmann::json groundTruthToJson(const GroundTruth& truth, const StochasticOptions& options) {
+    nlohmann::json parameters = {
+            {"mode", stochasticModeName(options.mode)},
+            {"seed", options.seed},
+            {"size", {options.depth, options.height, options.width}}
+    };
+    if (options.mode == StochasticMode::FracturedSlabs) {
+        parameters["fractures"] = options.fractures;
+        parameters["fracture_thickness"] = options.fracture_thickness;
+    } else {
+        parameters["density"] = options.density;
+        parameters["radius"] = {options.min_radius, options.max_radius};
+    }
+
+    return {
+            {"parameters", parameters},
+            {"connectivity", 6},
+            {"pore_connectivity", 26},
+            {"objects", truth.objects},
+            {"connected", truth.connected},
+            {"porosity", truth.porosity},
+            {"pore_voxels", truth.pore_voxels},
+            {"internal_pores", truth.internal_pores},
+            {"floating_parts", truth.floating_parts},
+            {"seconds", truth.seconds}
+    };
+}
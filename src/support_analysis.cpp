@@ -0,0 +1,203 @@
+#include "support_analysis.h"
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+// Биты источников на ячейках дополненной маски; маска отмечается вместе с соседями по граням
+void markAnchorSources(const PaddedMask& mask, const std::vector<AnchorSource>& sources,
+                       ScratchVector<uchar>& anchors) {
+    const std::ptrdiff_t neighbors[] = {
+            -static_cast<std::ptrdiff_t>(mask.plane), static_cast<std::ptrdiff_t>(mask.plane),
+            -static_cast<std::ptrdiff_t>(mask.row), static_cast<std::ptrdiff_t>(mask.row), -1, 1
+    };
+
+    for (size_t s = 0; s < sources.size(); ++s) {
+        const uchar bit = static_cast<uchar>(1u << s);
+        const AnchorSource& source = sources[s];
+
+        for (int z = 0; z < static_cast<int>(source.mask.size()); ++z) {
+            for (int y = 0; y < mask.height; ++y) {
+                const uchar* src = source.mask[z].ptr<uchar>(y);
+                uchar* dst = &anchors[mask.index(z, y, 0)];
+                for (int x = 0; x < mask.width; ++x) {
+                    if (src[x] == 0) continue;
+                    dst[x] |= bit;
+                    for (std::ptrdiff_t offset : neighbors) dst[x + offset] |= bit;
+                }
+            }
+        }
+
+        for (const cv::Point3i& seed : source.seeds) {
+            if (seed.z < 0 || seed.z >= mask.depth || seed.y < 0 || seed.y >= mask.height ||
+                seed.x < 0 || seed.x >= mask.width) {
+                continue;
+            }
+            anchors[mask.index(seed.z, seed.y, seed.x)] |= bit;
+        }
+    }
+}
+
+template <int N>
+std::vector<SupportComponent> labelSupportImpl(const std::vector<cv::Mat>& volume, uchar body_value,
+                                               const std::vector<AnchorSource>& sources) {
+    ScratchArena::Scope scratch;
+    // Маска, байты источников и стек обхода — в одном блоке арены
+    const size_t plane = static_cast<size_t>(volume[0].rows + 2) * (volume[0].cols + 2);
+    const size_t cells = plane * (volume.size() + 2);
+    ScratchArena::local().reserve((sources.empty() ? 1 : 2) * cells + 2 * plane * sizeof(size_t) + 4096);
+
+    PaddedMask mask = buildPaddedMask(volume, [body_value](uchar v) { return v == body_value; });
+    ScratchVector<uchar> anchors;
+    if (!sources.empty()) {
+        anchors.assign(mask.cells.size(), 0);
+        markAnchorSources(mask, sources, anchors);
+    }
+    ScratchVector<size_t> stack;
+    stack.reserve(mask.plane);
+    std::vector<SupportComponent> components;
+
+    for (int z = 0; z < mask.depth; ++z) {
+        for (int y = 0; y < mask.height; ++y) {
+            for (int x = 0; x < mask.width; ++x) {
+                size_t idx = mask.index(z, y, x);
+                if (mask.cells[idx] != kCellTarget) continue;
+
+                uchar contacts = 0;
+                FillResult fill;
+                if (anchors.empty()) {
+                    fill = floodFill<N>(mask, idx, stack);
+                } else {
+                    const uchar* bits = anchors.data();
+                    fill = floodFill<N>(mask, idx, stack, [&](size_t cell) { contacts |= bits[cell]; });
+                }
+                components.push_back({fill.voxels, fill.faces, contacts});
+            }
+        }
+    }
+    return components;
+}
+
+bool parseFaces(const std::string& item, uchar& faces) {
+    static const std::pair<const char*, uchar> names[] = {
+            {"z0", kFaceZ0}, {"z1", kFaceZ1}, {"y0", kFaceY0},
+            {"y1", kFaceY1}, {"x0", kFaceX0}, {"x1", kFaceX1}, {"all", kAllFaces}
+    };
+    for (const auto& [name, bits] : names) {
+        if (item == name) {
+            faces |= bits;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool addSource(std::vector<AnchorSource>& sources, AnchorSource source, uchar& bits) {
+    if (!source.mask_path.empty()) {
+        for (size_t i = 0; i < sources.size(); ++i) {
+            if (sources[i].mask_path == source.mask_path) {
+                bits |= static_cast<uchar>(1u << i);
+                return true;
+            }
+        }
+    }
+    if (sources.size() >= kMaxAnchorSources) {
+        std::cerr << "Ошибка: источников опоры больше " << kMaxAnchorSources << std::endl;
+        return false;
+    }
+    bits |= static_cast<uchar>(1u << sources.size());
+    sources.push_back(std::move(source));
+    return true;
+}
+
+} // namespace
+
+std::vector<SupportComponent> labelSupport(const std::vector<cv::Mat>& volume, uchar body_value,
+                                           const std::vector<AnchorSource>& sources, Connectivity connectivity) {
+    if (volume.empty()) return {};
+    if (sources.size() > kMaxAnchorSources) {
+        throw std::invalid_argument("слишком много источников опоры");
+    }
+    for (const AnchorSource& source : sources) {
+        if (source.mask.empty()) continue;
+        if (source.mask.size() != volume.size() || source.mask[0].size() != volume[0].size()) {
+            throw std::invalid_argument("размер маски опоры " + source.mask_path + " не совпадает с объёмом");
+        }
+    }
+
+    return dispatchConnectivity(connectivity, [&](auto n) {
+        return labelSupportImpl<decltype(n)::value>(volume, body_value, sources);
+    });
+}
+
+SupportSummary evaluateSupport(const std::vector<SupportComponent>& components, const SupportDefinition& definition,
+                               int min_voxels) {
+    SupportSummary summary;
+    summary.name = definition.name;
+    for (size_t i = 0; i < components.size(); ++i) {
+        const SupportComponent& component = components[i];
+        if ((component.faces & definition.faces) || (component.sources & definition.sources)) {
+            summary.supported++;
+        } else if (component.voxels >= static_cast<size_t>(min_voxels)) {
+            summary.unsupported++;
+            summary.unsupported_voxels += component.voxels;
+            summary.unsupported_ids.push_back(static_cast<int>(i + 1));
+        }
+    }
+    return summary;
+}
+
+bool parseSupportDefinition(const std::string& text, SupportDefinition& definition,
+                            std::vector<AnchorSource>& sources) {
+    definition = {};
+    definition.name = text;
+
+    std::stringstream stream(text);
+    for (std::string item; std::getline(stream, item, '+');) {
+        if (parseFaces(item, definition.faces)) continue;
+
+        AnchorSource source;
+        if (item.rfind("mask=", 0) == 0 && item.size() > 5) {
+            source.mask_path = item.substr(5);
+        } else if (item.rfind("seeds=", 0) == 0) {
+            std::stringstream seeds(item.substr(6));
+            for (std::string voxel; std::getline(seeds, voxel, ';');) {
+                cv::Point3i point;
+                if (std::sscanf(voxel.c_str(), "%d,%d,%d", &point.z, &point.y, &point.x) != 3) {
+                    std::cerr << "Ошибка: некорректная затравка " << voxel << " (ожидается Z,Y,X)" << std::endl;
+                    return false;
+                }
+                source.seeds.push_back(point);
+            }
+            if (source.seeds.empty()) {
+                std::cerr << "Ошибка: не указаны затравки в " << item << std::endl;
+                return false;
+            }
+        } else {
+            std::cerr << "Ошибка: неизвестная опора " << item
+                      << " (z0, z1, y0, y1, x0, x1, all, mask=ПУТЬ, seeds=Z,Y,X;...)" << std::endl;
+            return false;
+        }
+        if (!addSource(sources, std::move(source), definition.sources)) return false;
+    }
+    return definition.faces != 0 || definition.sources != 0;
+}
+
+nlohmann::json supportSummariesToJson(const std::vector<SupportSummary>& summaries, int min_voxels) {
+    nlohmann::json definitions = nlohmann::json::array();
+    for (const auto& summary : summaries) {
+        definitions.push_back({
+                {"name", summary.name},
+                {"supported", summary.supported},
+                {"unsupported", summary.unsupported},
+                {"unsupported_voxels", summary.unsupported_voxels},
+                {"unsupported_ids", summary.unsupported_ids}
+        });
+    }
+    return {
+            {"min_voxels", min_voxels},
+            {"definitions", definitions}
+    };
+}
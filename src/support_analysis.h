@@ -0,0 +1,72 @@
+#ifndef SUPPORT_ANALYSIS_H
+#define SUPPORT_ANALYSIS_H
+
+#include "neighborhood.h"
+#include "padded_mask.h"
+#include <opencv2/opencv.hpp>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+// Источник опоры помимо граней: маска (ненулевые воксели) или список вокселей-затравок
+struct AnchorSource {
+    std::string mask_path;             // откуда загружена маска (для повторного использования)
+    std::vector<cv::Mat> mask;         // тех же размеров, что и объём; пусто — нет маски
+    std::vector<cv::Point3i> seeds;    // координаты (z, y, x)
+};
+
+// Определение опоры: компонента опирается, если касается хотя бы одной грани из faces
+// или хотя бы одного источника из sources (бит i — AnchorSource с индексом i)
+struct SupportDefinition {
+    std::string name;
+    uchar faces = 0;
+    uchar sources = 0;
+};
+
+constexpr int kMaxAnchorSources = 8;
+
+// Контакты компоненты тела, накопленные при разметке
+struct SupportComponent {
+    size_t voxels = 0;
+    uchar faces = 0;
+    uchar sources = 0;
+};
+
+struct SupportSummary {
+    std::string name;
+    int supported = 0;
+    int unsupported = 0;               // неопорных компонент не меньше min_voxels
+    size_t unsupported_voxels = 0;
+    std::vector<int> unsupported_ids;  // номера компонент (индекс в таблице + 1)
+};
+
+/**
+ * @brief Размечает компоненты тела и для каждой накапливает биты контактов
+ *
+ * Грани определяются по соседям вне объёма прямо в обходе, источники — по
+ * байту битов, выставленному заранее на вокселях масок (и их соседях по граням,
+ * чтобы опорой считалось и прилегание к маске) и на затравках. Один проход
+ * разметки даёт данные для любого числа определений опоры.
+ *
+ * @throw std::invalid_argument если источников больше kMaxAnchorSources или маска другого размера
+ */
+std::vector<SupportComponent> labelSupport(const std::vector<cv::Mat>& volume, uchar body_value,
+                                           const std::vector<AnchorSource>& sources,
+                                           Connectivity connectivity = Connectivity::Six);
+
+SupportSummary evaluateSupport(const std::vector<SupportComponent>& components, const SupportDefinition& definition,
+                               int min_voxels);
+
+/**
+ * @brief Разбирает определение вида z0+x0+x1, all, mask=ПУТЬ, seeds=Z,Y,X;Z,Y,X
+ *
+ * Источники масок с одинаковым путём переиспользуются; маски только
+ * регистрируются (mask_path), загружает их вызывающая сторона.
+ * @return false, если определение некорректно
+ */
+bool parseSupportDefinition(const std::string& text, SupportDefinition& definition,
+                            std::vector<AnchorSource>& sources);
+
+nlohmann::json supportSummariesToJson(const std::vector<SupportSummary>& summaries, int min_voxels);
+
+#endif
@@ -0,0 +1,373 @@
+#include "surface_mesher.h"
+#include "binary_io.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+static constexpr int kBrickLayers = 16;
+
+bool meshFormatFromPath(const std::string& path, MeshFormat& format) {
+    std::string extension = fs::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    if (extension == ".ply") format = MeshFormat::Ply;
+    else if (extension == ".stl") format = MeshFormat::Stl;
+    else return false;
+    return true;
+}
+
+// Заполнение объёма: тело или поры исходных срезов
+struct SliceOccupancy {
+    const std::vector<cv::Mat>& volume;
+    uchar body_value;
+    bool pores;
+
+    bool operator()(int z, int y, int x) const {
+        return (volume[z].ptr<uchar>(y)[x] == body_value) != pores;
+    }
+};
+
+// Заполнение объёма: выбранные компоненты объёма меток
+struct LabelOccupancy {
+    const LabelVolume& labels;
+    const std::vector<uchar>& selected;
+
+    bool operator()(int z, int y, int x) const {
+        return selected[labels.at(z, y, x)];
+    }
+};
+
+// Рёбра ячейки 2×2×2: пары углов, отличающиеся одним битом (бит угла = dz * 4 + dy * 2 + dx)
+static const std::array<std::pair<int, int>, 12> kCellEdges = {{
+        {0, 1}, {2, 3}, {4, 5}, {6, 7},
+        {0, 2}, {1, 3}, {4, 6}, {5, 7},
+        {0, 4}, {1, 5}, {2, 6}, {3, 7}
+}};
+
+struct CellVertex {
+    int64_t id = -1;
+    float x = 0, y = 0, z = 0;
+};
+
+// Один слой ячеек и два слоя вокселей с рамкой; ячейка (cy, cx) лежит между вокселями cy..cy+1, cx..cx+1
+template <typename Occupancy>
+class LayerBuilder {
+public:
+    LayerBuilder(const Occupancy& occupancy, int depth, int height, int width)
+            : occupancy_(occupancy), depth_(depth), height_(height), width_(width),
+              row_(width + 2), lower_((height + 2) * row_), upper_((height + 2) * row_) {}
+
+    // Воксели слоёв cz и cz + 1; за пределами объёма — пусто
+    void load(int cz) {
+        fillVoxels(cz, lower_);
+        fillVoxels(cz + 1, upper_);
+    }
+
+    uchar voxel(int layer, int y, int x) const {
+        return (layer == 0 ? lower_ : upper_)[(y + 1) * row_ + (x + 1)];
+    }
+
+    int cornerMask(int cy, int cx) const {
+        int mask = 0;
+        for (int corner = 0; corner < 8; ++corner) {
+            if (voxel(corner >> 2, cy + ((corner >> 1) & 1), cx + (corner & 1))) mask |= 1 << corner;
+        }
+        return mask;
+    }
+
+private:
+    void fillVoxels(int z, std::vector<uchar>& layer) const {
+        std::fill(layer.begin(), layer.end(), 0);
+        if (z < 0 || z >= depth_) return;
+        for (int y = 0; y < height_; ++y) {
+            uchar* dst = &layer[(y + 1) * row_ + 1];
+            for (int x = 0; x < width_; ++x) {
+                dst[x] = occupancy_(z, y, x);
+            }
+        }
+    }
+
+    const Occupancy& occupancy_;
+    int depth_, height_, width_;
+    size_t row_;
+    std::vector<uchar> lower_, upper_;
+};
+
+// Число вершин и граней слоя ячеек cz; грани слоя — рёбра вокселей z = cz по всем осям
+template <typename Occupancy>
+static std::pair<uint64_t, uint64_t> countLayer(LayerBuilder<Occupancy>& builder, int cz, int depth,
+                                                int height, int width) {
+    builder.load(cz);
+    uint64_t vertices = 0, faces = 0;
+    for (int cy = -1; cy < height; ++cy) {
+        for (int cx = -1; cx < width; ++cx) {
+            int mask = builder.cornerMask(cy, cx);
+            vertices += mask != 0 && mask != 255;
+        }
+    }
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            faces += builder.voxel(0, y, x) != builder.voxel(1, y, x);
+        }
+    }
+    if (cz >= 0 && cz < depth) {
+        for (int y = 0; y < height; ++y) {
+            for (int x = -1; x < width; ++x) {
+                faces += builder.voxel(0, y, x) != builder.voxel(0, y, x + 1);
+            }
+        }
+        for (int y = -1; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                faces += builder.voxel(0, y, x) != builder.voxel(0, y + 1, x);
+            }
+        }
+    }
+    return {vertices, faces};
+}
+
+// Вершины и грани одного блока слоёв, готовые к записи
+struct BrickMesh {
+    std::vector<float> vertices;
+    std::vector<uint32_t> quads;
+    std::vector<float> triangles; // для STL: нормаль и три вершины на треугольник
+};
+
+template <typename Occupancy>
+class BrickMesher {
+public:
+    BrickMesher(const Occupancy& occupancy, int depth, int height, int width,
+                const std::vector<uint64_t>& layer_vertices, MeshFormat format)
+            : builder_(occupancy, depth, height, width), depth_(depth), height_(height), width_(width),
+              cells_row_(width + 1), layer_vertices_(layer_vertices), format_(format),
+              previous_((height + 1) * cells_row_), current_((height + 1) * cells_row_) {}
+
+    BrickMesh build(int first_layer, int end_layer) {
+        BrickMesh mesh;
+        if (first_layer > -1) {
+            fillCache(first_layer - 1, current_, nullptr);
+        }
+        for (int cz = first_layer; cz < end_layer; ++cz) {
+            std::swap(previous_, current_);
+            fillCache(cz, current_, &mesh);
+            emitFaces(cz, mesh);
+        }
+        return mesh;
+    }
+
+private:
+    const CellVertex& cell(int layer_cz, int cz, int cy, int cx) const {
+        const std::vector<CellVertex>& cache = layer_cz == cz ? current_ : previous_;
+        return cache[(cy + 1) * cells_row_ + (cx + 1)];
+    }
+
+    // Вершины слоя нумеруются по порядку обхода начиная со смещения слоя
+    void fillCache(int cz, std::vector<CellVertex>& cache, BrickMesh* mesh) {
+        builder_.load(cz);
+        int64_t next_id = layer_vertices_[cz + 1];
+        for (int cy = -1; cy < height_; ++cy) {
+            for (int cx = -1; cx < width_; ++cx) {
+                CellVertex& vertex = cache[(cy + 1) * cells_row_ + (cx + 1)];
+                int mask = builder_.cornerMask(cy, cx);
+                if (mask == 0 || mask == 255) {
+                    vertex.id = -1;
+                    continue;
+                }
+
+                // Вершина — среднее середин рёбер ячейки, на которых меняется заполнение
+                float sx = 0, sy = 0, sz = 0;
+                int crossings = 0;
+                for (const auto& [a, b] : kCellEdges) {
+                    if (((mask >> a) & 1) == ((mask >> b) & 1)) continue;
+                    sx += ((a & 1) + (b & 1)) * 0.5f;
+                    sy += (((a >> 1) & 1) + ((b >> 1) & 1)) * 0.5f;
+                    sz += ((a >> 2) + (b >> 2)) * 0.5f;
+                    crossings++;
+                }
+                vertex.id = next_id++;
+                vertex.x = cx + sx / crossings;
+                vertex.y = cy + sy / crossings;
+                vertex.z = cz + sz / crossings;
+                if (mesh && format_ == MeshFormat::Ply) {
+                    mesh->vertices.insert(mesh->vertices.end(), {vertex.x, vertex.y, vertex.z});
+                }
+            }
+        }
+    }
+
+    void emitQuad(BrickMesh& mesh, bool flip, const CellVertex& a, const CellVertex& b,
+                  const CellVertex& c, const CellVertex& d) {
+        std::array<const CellVertex*, 4> quad = {&a, &b, &c, &d};
+        if (flip) std::swap(quad[1], quad[3]);
+
+        if (format_ == MeshFormat::Ply) {
+            for (const CellVertex* v : quad) mesh.quads.push_back(static_cast<uint32_t>(v->id));
+            return;
+        }
+        for (const auto& tri : {std::array<int, 3>{0, 1, 2}, std::array<int, 3>{0, 2, 3}}) {
+            const CellVertex& p0 = *quad[tri[0]];
+            const CellVertex& p1 = *quad[tri[1]];
+            const CellVertex& p2 = *quad[tri[2]];
+            float ux = p1.x - p0.x, uy = p1.y - p0.y, uz = p1.z - p0.z;
+            float vx = p2.x - p0.x, vy = p2.y - p0.y, vz = p2.z - p0.z;
+            float nx = uy * vz - uz * vy, ny = uz * vx - ux * vz, nz = ux * vy - uy * vx;
+            float length = std::sqrt(nx * nx + ny * ny + nz * nz);
+            if (length > 0) {
+                nx /= length;
+                ny /= length;
+                nz /= length;
+            }
+            mesh.triangles.insert(mesh.triangles.end(),
+                                  {nx, ny, nz, p0.x, p0.y, p0.z, p1.x, p1.y, p1.z, p2.x, p2.y, p2.z});
+        }
+    }
+
+    // Грань на каждое ребро между вокселем внутри и вокселем снаружи; порядок вершин
+    // выбран так, чтобы нормаль смотрела наружу
+    void emitFaces(int cz, BrickMesh& mesh) {
+        const int z = cz; // слои вокселей cz и cz + 1 уже загружены при заполнении кэша
+        for (int y = 0; y < height_; ++y) {
+            for (int x = 0; x < width_; ++x) {
+                uchar inside = builder_.voxel(0, y, x);
+                if (inside == builder_.voxel(1, y, x)) continue;
+                emitQuad(mesh, !inside, cell(cz, z, y - 1, x - 1), cell(cz, z, y - 1, x),
+                         cell(cz, z, y, x), cell(cz, z, y, x - 1));
+            }
+        }
+        if (z < 0 || z >= depth_) return;
+
+        for (int y = 0; y < height_; ++y) {
+            for (int x = -1; x < width_; ++x) {
+                uchar inside = builder_.voxel(0, y, x);
+                if (inside == builder_.voxel(0, y, x + 1)) continue;
+                emitQuad(mesh, !inside, cell(cz, z - 1, y - 1, x), cell(cz, z - 1, y, x),
+                         cell(cz, z, y, x), cell(cz, z, y - 1, x));
+            }
+        }
+        for (int y = -1; y < height_; ++y) {
+            for (int x = 0; x < width_; ++x) {
+                uchar inside = builder_.voxel(0, y, x);
+                if (inside == builder_.voxel(0, y + 1, x)) continue;
+                emitQuad(mesh, !inside, cell(cz, z - 1, y, x - 1), cell(cz, z, y, x - 1),
+                         cell(cz, z, y, x), cell(cz, z - 1, y, x));
+            }
+        }
+    }
+
+    LayerBuilder<Occupancy> builder_;
+    int depth_, height_, width_;
+    size_t cells_row_;
+    const std::vector<uint64_t>& layer_vertices_;
+    MeshFormat format_;
+    std::vector<CellVertex> previous_, current_;
+};
+
+template <typename Occupancy>
+static bool writeMesh(const Occupancy& occupancy, int depth, int height, int width,
+                      const std::string& path, MeshStats& stats) {
+    MeshFormat format;
+    if (!meshFormatFromPath(path, format)) {
+        std::cerr << "❌ Неизвестный формат сетки (ожидается .ply или .stl): " << path << std::endl;
+        return false;
+    }
+
+    // Первый проход: вершины и грани каждого слоя ячеек cz = -1 .. depth - 1
+    const int layers = depth + 1;
+    std::vector<uint64_t> layer_vertices(layers + 1, 0), layer_faces(layers + 1, 0);
+    cv::parallel_for_(cv::Range(0, layers), [&](const cv::Range& range) {
+        LayerBuilder<Occupancy> builder(occupancy, depth, height, width);
+        for (int layer = range.start; layer < range.end; ++layer) {
+            auto [vertices, faces] = countLayer(builder, layer - 1, depth, height, width);
+            layer_vertices[layer + 1] = vertices;
+            layer_faces[layer + 1] = faces;
+        }
+    });
+    for (int layer = 0; layer < layers; ++layer) {
+        layer_vertices[layer + 1] += layer_vertices[layer];
+        layer_faces[layer + 1] += layer_faces[layer];
+    }
+    stats.vertices = layer_vertices[layers];
+    stats.faces = layer_faces[layers];
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        std::cerr << "❌ Не удалось открыть файл для записи сетки: " << path << std::endl;
+        return false;
+    }
+
+    // Заголовок с точными количествами известен до генерации геометрии
+    const size_t vertex_bytes = 3 * sizeof(float);
+    const size_t face_bytes = 1 + 4 * sizeof(uint32_t);
+    const size_t triangle_bytes = 12 * sizeof(float) + sizeof(uint16_t);
+    std::streamoff data_start;
+    if (format == MeshFormat::Ply) {
+        out << "ply\nformat binary_little_endian 1.0\n"
+            << "element vertex " << stats.vertices << "\n"
+            << "property float x\nproperty float y\nproperty float z\n"
+            << "element face " << stats.faces << "\n"
+            << "property list uchar uint vertex_indices\nend_header\n";
+    } else {
+        char header[80] = "volume_analyzer surface mesh";
+        out.write(header, sizeof(header));
+        writeValue<uint32_t>(out, static_cast<uint32_t>(2 * stats.faces));
+    }
+    data_start = out.tellp();
+    const std::streamoff faces_start = data_start + static_cast<std::streamoff>(stats.vertices * vertex_bytes);
+
+    // Блоки слоёв строятся параллельно партиями и записываются по заранее известным смещениям
+    const int bricks = (layers + kBrickLayers - 1) / kBrickLayers;
+    const int batch = std::max(1, 2 * cv::getNumThreads());
+    for (int first = 0; first < bricks; first += batch) {
+        const int count = std::min(batch, bricks - first);
+        std::vector<BrickMesh> meshes(count);
+        cv::parallel_for_(cv::Range(0, count), [&](const cv::Range& range) {
+            BrickMesher<Occupancy> mesher(occupancy, depth, height, width, layer_vertices, format);
+            for (int i = range.start; i < range.end; ++i) {
+                int brick_first = (first + i) * kBrickLayers;
+                int brick_end = std::min(brick_first + kBrickLayers, layers);
+                meshes[i] = mesher.build(brick_first - 1, brick_end - 1);
+            }
+        });
+
+        for (int i = 0; i < count; ++i) {
+            const int brick_first = (first + i) * kBrickLayers;
+            const BrickMesh& mesh = meshes[i];
+            if (format == MeshFormat::Ply) {
+                out.seekp(data_start + static_cast<std::streamoff>(layer_vertices[brick_first] * vertex_bytes));
+                out.write(reinterpret_cast<const char*>(mesh.vertices.data()), mesh.vertices.size() * sizeof(float));
+                out.seekp(faces_start + static_cast<std::streamoff>(layer_faces[brick_first] * face_bytes));
+                for (size_t q = 0; q < mesh.quads.size(); q += 4) {
+                    writeValue<uint8_t>(out, 4);
+                    out.write(reinterpret_cast<const char*>(&mesh.quads[q]), 4 * sizeof(uint32_t));
+                }
+            } else {
+                out.seekp(data_start + static_cast<std::streamoff>(2 * layer_faces[brick_first] * triangle_bytes));
+                for (size_t t = 0; t < mesh.triangles.size(); t += 12) {
+                    out.write(reinterpret_cast<const char*>(&mesh.triangles[t]), 12 * sizeof(float));
+                    writeValue<uint16_t>(out, 0);
+                }
+            }
+        }
+    }
+    return static_cast<bool>(out);
+}
+
+bool writeSurfaceMesh(const std::vector<cv::Mat>& volume, uchar body_value, bool pores,
+                      const std::string& path, MeshStats& stats) {
+    if (volume.empty()) return false;
+    SliceOccupancy occupancy{volume, body_value, pores};
+    return writeMesh(occupancy, volume.size(), volume[0].rows, volume[0].cols, path, stats);
+}
+
+bool writeLabelSurfaceMesh(const LabelVolume& labels, const std::vector<uint32_t>& ids,
+                           const std::string& path, MeshStats& stats) {
+    std::vector<uchar> selected(labels.components.size() + 1, 0);
+    for (uint32_t id : ids) {
+        if (id >= 1 && id < selected.size()) selected[id] = 1;
+    }
+    LabelOccupancy occupancy{labels, selected};
+    return writeMesh(occupancy, labels.depth, labels.height, labels.width, path, stats);
+}
@@ -0,0 +1,41 @@
+#ifndef SURFACE_MESHER_H
+#define SURFACE_MESHER_H
+
+#include "label_volume.h"
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class MeshFormat {
+    Ply, // вершины общие для соседних граней, грани — четырёхугольники
+    Stl  // независимые треугольники
+};
+
+// Формат по расширению файла (.ply или .stl)
+bool meshFormatFromPath(const std::string& path, MeshFormat& format);
+
+struct MeshStats {
+    uint64_t vertices = 0;
+    uint64_t faces = 0;
+};
+
+/**
+ * @brief Строит поверхность тела (или пор) методом surface nets и сразу пишет её в файл
+ *
+ * Объём разбивается на блоки слоёв, блоки обрабатываются параллельно партиями.
+ * Первый проход считает вершины и грани каждого слоя, поэтому заголовок и
+ * смещения блоков в файле известны заранее и в памяти держится только текущая
+ * партия блоков. Вершина ячейки хранится в кэше слоя и переиспользуется всеми
+ * гранями, которые её касаются.
+ *
+ * @param pores true — поверхность пустого пространства вместо тела
+ */
+bool writeSurfaceMesh(const std::vector<cv::Mat>& volume, uchar body_value, bool pores,
+                      const std::string& path, MeshStats& stats);
+
+// Поверхность только выбранных компонент объёма меток
+bool writeLabelSurfaceMesh(const LabelVolume& labels, const std::vector<uint32_t>& ids,
+                           const std::string& path, MeshStats& stats);
+
+#endif
@@ -0,0 +1,145 @@
+#include "task_graph.h"
+#include <algorithm>
+#include <exception>
+
+TaskScheduler::TaskScheduler(int threads) {
+    if (threads <= 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    workers_.reserve(threads);
+    for (int i = 0; i < threads; ++i) {
+        workers_.emplace_back([this] { work(); });
+    }
+}
+
+TaskScheduler::~TaskScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    ready_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void TaskScheduler::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    ready_.notify_one();
+}
+
+void TaskScheduler::work() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            ready_.wait(lock, [&] { return stopping_ || !tasks_.empty(); });
+            if (tasks_.empty()) return;
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
+
+size_t TaskGraph::add(const std::string& name, Stage stage, const std::vector<size_t>& dependencies) {
+    size_t index = nodes_.size();
+    Node& node = nodes_.emplace_back();
+    node.name = name;
+    node.stage = std::move(stage);
+    node.pending = dependencies.size();
+    for (size_t dependency : dependencies) {
+        nodes_[dependency].dependents.push_back(index);
+    }
+    return index;
+}
+
+void TaskGraph::start(TaskScheduler& scheduler) {
+    scheduler_ = &scheduler;
+    started_ = finished_at_ = std::chrono::steady_clock::now();
+    // Корни собираются заранее: запущенные этапы сразу начинают уменьшать pending
+    std::vector<size_t> roots;
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+        if (nodes_[i].pending == 0) roots.push_back(i);
+    }
+    for (size_t root : roots) {
+        launch(root);
+    }
+}
+
+void TaskGraph::launch(size_t index) {
+    scheduler_->submit([this, index] {
+        Node& node = nodes_[index];
+        if (node.skipped) {
+            node.log << "Этап «" << node.name << "» пропущен: предыдущий этап завершился ошибкой" << std::endl;
+        } else {
+            auto start = std::chrono::steady_clock::now();
+            try {
+                node.stage(node.log);
+            } catch (const std::exception& e) {
+                node.log << "❌ Ошибка на этапе «" << node.name << "»: " << e.what() << std::endl;
+                node.failed = true;
+            }
+            node.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        finish(index);
+    });
+}
+
+void TaskGraph::finish(size_t index) {
+    std::vector<size_t> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const Node& node = nodes_[index];
+        for (size_t dependent : node.dependents) {
+            Node& next = nodes_[dependent];
+            next.skipped = next.skipped || node.failed || node.skipped;
+            if (--next.pending == 0) ready.push_back(dependent);
+        }
+        // После последнего этапа граф может быть разрушен ожидающим потоком,
+        // поэтому здесь к нему больше не обращаемся
+        if (++finished_ == nodes_.size()) {
+            finished_at_ = std::chrono::steady_clock::now();
+            done_.notify_all();
+        }
+    }
+    for (size_t next : ready) {
+        launch(next);
+    }
+}
+
+void TaskGraph::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [&] { return finished_ == nodes_.size(); });
+}
+
+double TaskGraph::seconds() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::chrono::duration<double>(finished_at_ - started_).count();
+}
+
+bool TaskGraph::failed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::any_of(nodes_.begin(), nodes_.end(), [](const Node& node) { return node.failed || node.skipped; });
+}
+
+void TaskGraph::printLogs(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const Node& node : nodes_) {
+        out << node.log.str();
+    }
+    out.flush();
+}
+
+std::vector<std::pair<std::string, double>> TaskGraph::timings() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::pair<std::string, double>> result;
+    result.reserve(nodes_.size());
+    for (const Node& node : nodes_) {
+        result.emplace_back(node.name, node.seconds);
+    }
+    return result;
+}
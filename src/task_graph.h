@@ -0,0 +1,149 @@
+#ifndef TASK_GRAPH_H
+#define TASK_GRAPH_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Пул потоков, общий для всех графов задач процесса
+ *
+ * Задачи выполняются в порядке поступления; задачи можно добавлять из самих задач.
+ * Деструктор дожидается выполнения всех поставленных задач.
+ */
+class TaskScheduler {
+public:
+    // threads <= 0 — по числу аппаратных потоков
+    explicit TaskScheduler(int threads = 0);
+    ~TaskScheduler();
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    void submit(std::function<void()> task);
+
+    int threads() const { return static_cast<int>(workers_.size()); }
+
+private:
+    void work();
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    bool stopping_ = false;
+};
+
+/**
+ * @brief Очередь ограниченной ёмкости между этапами конвейера
+ *
+ * push блокируется, пока очередь заполнена, pop — пока она пуста. После close
+ * новые элементы не принимаются, а pop возвращает false, когда очередь опустеет.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(capacity > 0 ? capacity : 1) {}
+
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [&] { return closed_ || items_.size() < capacity_; });
+        if (closed_) return false;
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+        return true;
+    }
+
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [&] { return closed_ || !items_.empty(); });
+        if (items_.empty()) return false;
+        item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_full_.notify_all();
+        not_empty_.notify_all();
+    }
+
+private:
+    size_t capacity_;
+    std::deque<T> items_;
+    std::mutex mutex_;
+    std::condition_variable not_full_, not_empty_;
+    bool closed_ = false;
+};
+
+/**
+ * @brief Граф этапов обработки одного образца
+ *
+ * Этап запускается в пуле, как только завершились все этапы, от которых он
+ * зависит; независимые этапы выполняются одновременно. Каждый этап пишет в свой
+ * журнал, и журналы выводятся в порядке добавления этапов, так что вывод не
+ * перемешивается. Если этап завершился исключением, зависящие от него этапы
+ * пропускаются.
+ */
+class TaskGraph {
+public:
+    using Stage = std::function<void(std::ostream& log)>;
+
+    TaskGraph() = default;
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+
+    // Добавляет этап; возвращает его номер для списков зависимостей
+    size_t add(const std::string& name, Stage stage, const std::vector<size_t>& dependencies = {});
+
+    // Ставит в пул этапы без зависимостей и сразу возвращает управление
+    void start(TaskScheduler& scheduler);
+
+    // Ждёт завершения всех этапов; нельзя вызывать из задачи того же пула
+    void wait();
+
+    bool failed() const;
+
+    void printLogs(std::ostream& out) const;
+
+    // Время от запуска графа до завершения последнего этапа
+    double seconds() const;
+
+    // Время выполнения этапов в порядке добавления
+    std::vector<std::pair<std::string, double>> timings() const;
+
+private:
+    struct Node {
+        std::string name;
+        Stage stage;
+        std::vector<size_t> dependents;
+        size_t pending = 0;   // незавершённые зависимости
+        bool skipped = false; // одна из зависимостей завершилась ошибкой
+        bool failed = false;
+        double seconds = 0.0;
+        std::ostringstream log;
+    };
+
+    void launch(size_t index);
+    void finish(size_t index);
+
+    TaskScheduler* scheduler_ = nullptr;
+    std::chrono::steady_clock::time_point started_, finished_at_;
+    std::deque<Node> nodes_;
+    size_t finished_ = 0;
+    mutable std::mutex mutex_;
+    std::condition_variable done_;
+};
+
+#endif
@@ -0,0 +1,293 @@
+#include "volume_diff.h"
+#include "padded_mask.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Сравнение строк без ветвлений: компилятор разворачивает цикл в векторные сравнения
+void countRowChanges(const uchar* before, const uchar* after, int width, uchar body_value, uint64_t& added,
+                     uint64_t& removed) {
+    uint32_t row_added = 0, row_removed = 0;
+    for (int x = 0; x < width; ++x) {
+        const uint32_t was = before[x] == body_value;
+        const uint32_t now = after[x] == body_value;
+        row_added += now & (was ^ 1u);
+        row_removed += was & (now ^ 1u);
+    }
+    added += row_added;
+    removed += row_removed;
+}
+
+uint64_t pairKey(uint32_t before, uint32_t after) {
+    return static_cast<uint64_t>(before) << 32 | after;
+}
+
+// Обходит компоненты маски в порядке z → y → x и передаёт каждую ячейку компоненты в visit(id, cell);
+// возвращает размеры компонент, voxels[id - 1]
+template <int N, typename Visitor>
+std::vector<uint64_t> forEachComponent(PaddedMask& mask, const AnalysisControl& control, Visitor visit) {
+    std::vector<uint64_t> voxels;
+    ScratchVector<size_t> stack;
+    stack.reserve(mask.plane);
+
+    for (int z = 0; z < mask.depth; ++z) {
+        control.check();
+        for (int y = 0; y < mask.height; ++y) {
+            for (int x = 0; x < mask.width; ++x) {
+                size_t idx = mask.index(z, y, x);
+                if (mask.cells[idx] != kCellTarget) continue;
+
+                const uint32_t id = static_cast<uint32_t>(voxels.size() + 1);
+                FillResult fill = floodFill<N>(mask, idx, stack, [&](size_t cell) { visit(id, cell); });
+                voxels.push_back(fill.voxels);
+            }
+        }
+    }
+    return voxels;
+}
+
+template <int N>
+void matchComponents(const std::vector<cv::Mat>& before, const std::vector<cv::Mat>& after, uchar body_value,
+                     const AnalysisControl& control, VolumeDiff& diff) {
+    auto is_body = [body_value](uchar v) { return v == body_value; };
+    PaddedMask first = buildPaddedMask(before, is_body);
+    ScratchVector<uint32_t> labels(first.cells.size(), 0);
+    std::vector<uint64_t> before_voxels =
+            forEachComponent<N>(first, control, [&](uint32_t id, size_t cell) { labels[cell] = id; });
+
+    // Компоненты второго скана не размечаются отдельно: при обходе сразу считается пересечение
+    // с метками первого скана (разметка дополненных масок совпадает). Соседние ячейки обхода
+    // обычно лежат в одной компоненте первого скана, поэтому в таблицу попадают серии.
+    std::unordered_map<uint64_t, uint64_t> overlaps;
+    uint64_t key = 0, run = 0;
+    PaddedMask second = buildPaddedMask(after, is_body);
+    std::vector<uint64_t> after_voxels = forEachComponent<N>(second, control, [&](uint32_t id, size_t cell) {
+        const uint32_t label = labels[cell];
+        if (label == 0) return;
+        const uint64_t current = pairKey(label, id);
+        if (current != key && run != 0) {
+            overlaps[key] += run;
+            run = 0;
+        }
+        key = current;
+        run++;
+    });
+    if (run != 0) overlaps[key] += run;
+
+    const uint32_t before_bodies = static_cast<uint32_t>(before_voxels.size());
+    const uint32_t after_bodies = static_cast<uint32_t>(after_voxels.size());
+    diff.components_before = before_bodies;
+    diff.components_after = after_bodies;
+
+    std::vector<std::vector<uint32_t>> successors(before_bodies + 1), predecessors(after_bodies + 1);
+    for (const auto& [pair, voxels] : overlaps) {
+        const uint32_t a = static_cast<uint32_t>(pair >> 32), b = static_cast<uint32_t>(pair);
+        successors[a].push_back(b);
+        predecessors[b].push_back(a);
+    }
+
+    auto voxelsOf = [](const std::vector<uint64_t>& sizes, const std::vector<uint32_t>& ids) {
+        uint64_t voxels = 0;
+        for (uint32_t id : ids) voxels += sizes[id - 1];
+        return voxels;
+    };
+    auto addEvent = [&](ComponentChange change, std::vector<uint32_t> from, std::vector<uint32_t> to) {
+        std::sort(from.begin(), from.end());
+        std::sort(to.begin(), to.end());
+        ComponentEvent event;
+        event.change = change;
+        event.voxels_before = voxelsOf(before_voxels, from);
+        event.voxels_after = voxelsOf(after_voxels, to);
+        event.before = std::move(from);
+        event.after = std::move(to);
+        diff.events.push_back(std::move(event));
+    };
+
+    for (uint32_t a = 1; a <= before_bodies; ++a) {
+        if (successors[a].empty()) addEvent(ComponentChange::Vanished, {a}, {});
+        else if (successors[a].size() > 1) addEvent(ComponentChange::Split, {a}, successors[a]);
+        else if (predecessors[successors[a][0]].size() == 1) diff.components_matched++;
+    }
+    for (uint32_t b = 1; b <= after_bodies; ++b) {
+        if (predecessors[b].empty()) addEvent(ComponentChange::Appeared, {}, {b});
+        else if (predecessors[b].size() > 1) addEvent(ComponentChange::Merged, predecessors[b], {b});
+    }
+}
+
+} // namespace
+
+std::string componentChangeName(ComponentChange change) {
+    switch (change) {
+        case ComponentChange::Appeared: return "appeared";
+        case ComponentChange::Vanished: return "vanished";
+        case ComponentChange::Merged: return "merged";
+        case ComponentChange::Split: return "split";
+    }
+    return "unknown";
+}
+
+std::vector<int> VolumeDiff::changedSlices() const {
+    std::vector<int> slices;
+    for (int z = 0; z < depth; ++z) {
+        if (added[z] != 0 || removed[z] != 0) slices.push_back(z);
+    }
+    return slices;
+}
+
+VolumeDiff diffVolumes(const std::vector<cv::Mat>& before, const std::vector<cv::Mat>& after, uchar body_value,
+                       Connectivity connectivity, int slab_size, const AnalysisControl& control) {
+    if (before.size() != after.size() || before.empty() || before[0].size() != after[0].size()) {
+        throw std::invalid_argument("размеры сканов различаются");
+    }
+
+    VolumeDiff diff;
+    diff.depth = static_cast<int>(before.size());
+    diff.height = before[0].rows;
+    diff.width = before[0].cols;
+    diff.slab_size = std::max(1, slab_size);
+    diff.slabs = (diff.depth + diff.slab_size - 1) / diff.slab_size;
+    diff.added.assign(diff.depth, 0);
+    diff.removed.assign(diff.depth, 0);
+
+    // Пачки независимы и сравниваются параллельно, по порции пачек между проверками отмены.
+    // Одинаковые строки отсеиваются memcmp, и только различающиеся сравниваются по вокселям;
+    // каждый байт обоих сканов читается один раз, без хеширования
+    std::vector<uchar> skipped(diff.slabs, 0);
+    const int chunk = std::max(1, 2 * cv::getNumThreads());
+    for (int first = 0; first < diff.slabs; first += chunk) {
+        const int count = std::min(chunk, diff.slabs - first);
+        cv::parallel_for_(cv::Range(first, first + count), [&](const cv::Range& range) {
+            for (int slab = range.start; slab < range.end; ++slab) {
+                const int z_begin = slab * diff.slab_size;
+                const int z_end = std::min(diff.depth, z_begin + diff.slab_size);
+                bool identical = true;
+                for (int z = z_begin; z < z_end; ++z) {
+                    for (int y = 0; y < diff.height; ++y) {
+                        const uchar* was = before[z].ptr<uchar>(y);
+                        const uchar* now = after[z].ptr<uchar>(y);
+                        if (std::memcmp(was, now, diff.width) == 0) continue;
+                        identical = false;
+                        countRowChanges(was, now, diff.width, body_value, diff.added[z], diff.removed[z]);
+                    }
+                }
+                skipped[slab] = identical;
+            }
+        });
+        control.report({"сравнение", std::min(diff.depth, (first + count) * diff.slab_size), diff.depth});
+    }
+
+    for (int z = 0; z < diff.depth; ++z) {
+        diff.total_added += diff.added[z];
+        diff.total_removed += diff.removed[z];
+    }
+    diff.slabs_skipped = static_cast<int>(std::count(skipped.begin(), skipped.end(), 1));
+
+    // Без изменений тела компоненты совпадают, и разметка не нужна
+    if (diff.total_added == 0 && diff.total_removed == 0) return diff;
+
+    ScratchArena::Scope scratch;
+    dispatchConnectivity(connectivity, [&](auto n) {
+        matchComponents<decltype(n)::value>(before, after, body_value, control, diff);
+    });
+    diff.components_labeled = true;
+    return diff;
+}
+
+std::vector<int> collageSlices(const VolumeDiff& diff, int max_slices) {
+    std::vector<int> slices = diff.changedSlices();
+    if (static_cast<int>(slices.size()) > max_slices) {
+        std::nth_element(slices.begin(), slices.begin() + max_slices, slices.end(), [&](int a, int b) {
+            return diff.added[a] + diff.removed[a] > diff.added[b] + diff.removed[b];
+        });
+        slices.resize(max_slices);
+        std::sort(slices.begin(), slices.end());
+    }
+    return slices;
+}
+
+cv::Mat renderChangeCollage(const std::vector<cv::Mat>& before, const std::vector<cv::Mat>& after,
+                            const std::vector<int>& slices, uchar body_value) {
+    if (slices.empty()) return {};
+
+    const int cols = std::min<int>(10, slices.size());
+    const int border_size = 1;
+    const int slice_height = after[0].rows;
+    const int slice_width = after[0].cols;
+
+    int rows = (slices.size() + cols - 1) / cols;
+    int collage_width = cols * (slice_width + border_size) - border_size;
+    int collage_height = rows * (slice_height + border_size) - border_size;
+    cv::Mat collage(collage_height, collage_width, CV_8UC3, cv::Scalar(0, 0, 0));
+
+    const cv::Vec3b body_color(160, 160, 160), pore_color(255, 255, 255);
+    const cv::Vec3b added_color(0, 200, 0), removed_color(0, 0, 255);
+
+    cv::parallel_for_(cv::Range(0, static_cast<int>(slices.size())), [&](const cv::Range& range) {
+        for (int i = range.start; i < range.end; ++i) {
+            const int z = slices[i];
+            const int top = i / cols * (slice_height + border_size);
+            const int left = i % cols * (slice_width + border_size);
+            for (int y = 0; y < slice_height; ++y) {
+                const uchar* was = before[z].ptr<uchar>(y);
+                const uchar* now = after[z].ptr<uchar>(y);
+                cv::Vec3b* dst = collage.ptr<cv::Vec3b>(top + y) + left;
+                for (int x = 0; x < slice_width; ++x) {
+                    const bool was_body = was[x] == body_value, is_body = now[x] == body_value;
+                    dst[x] = was_body == is_body ? (is_body ? body_color : pore_color)
+                                                 : (is_body ? added_color : removed_color);
+                }
+            }
+        }
+    });
+    return collage;
+}
+
+std::string saveChangeCollage(const cv::Mat& collage, const std::string& folder_name,
+                              const std::string& project_root) {
+    std::string out_dir = project_root + "/data/output/collages/";
+    fs::create_directories(out_dir);
+    std::string output_path = out_dir + folder_name + "_diff_collage.png";
+    cv::imwrite(output_path, collage);
+    return output_path;
+}
+
+nlohmann::json volumeDiffToJson(const VolumeDiff& diff) {
+    nlohmann::json slices = nlohmann::json::array();
+    for (int z : diff.changedSlices()) {
+        slices.push_back({{"slice", z}, {"added", diff.added[z]}, {"removed", diff.removed[z]}});
+    }
+
+    nlohmann::json events = nlohmann::json::array();
+    for (const ComponentEvent& event : diff.events) {
+        events.push_back({
+                {"change", componentChangeName(event.change)},
+                {"before", event.before},
+                {"after", event.after},
+                {"voxels_before", event.voxels_before},
+                {"voxels_after", event.voxels_after}
+        });
+    }
+
+    nlohmann::json result = {
+            {"size", {diff.depth, diff.height, diff.width}},
+            {"slab_size", diff.slab_size},
+            {"slabs", diff.slabs},
+            {"slabs_skipped", diff.slabs_skipped},
+            {"added", diff.total_added},
+            {"removed", diff.total_removed},
+            {"changed_slices", slices}
+    };
+    if (diff.components_labeled) {
+        result["components_before"] = diff.components_before;
+        result["components_after"] = diff.components_after;
+        result["components_matched"] = diff.components_matched;
+        result["events"] = events;
+    }
+    return result;
+}
@@ -0,0 +1,80 @@
+#ifndef VOLUME_DIFF_H
+#define VOLUME_DIFF_H
+
+#include "analysis_progress.h"
+#include "neighborhood.h"
+#include <opencv2/opencv.hpp>
+#include <nlohmann/json.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class ComponentChange {
+    Appeared, // компонента второго скана не пересекается с телом первого
+    Vanished, // компонента первого скана не пересекается с телом второго
+    Merged,   // компонента второго скана пересекается с несколькими компонентами первого
+    Split     // компонента первого скана пересекается с несколькими компонентами второго
+};
+
+std::string componentChangeName(ComponentChange change);
+
+// Изменение компонент тела; номера — порядок компонент в разметке своего скана, с 1
+struct ComponentEvent {
+    ComponentChange change = ComponentChange::Appeared;
+    std::vector<uint32_t> before;
+    std::vector<uint32_t> after;
+    uint64_t voxels_before = 0;
+    uint64_t voxels_after = 0;
+};
+
+struct VolumeDiff {
+    int depth = 0, height = 0, width = 0;
+    int slab_size = 0;
+    int slabs = 0;
+    int slabs_skipped = 0;            // пачки срезов, побайтно совпавшие в обоих сканах
+    std::vector<uint64_t> added;      // по срезам: воксели, ставшие телом
+    std::vector<uint64_t> removed;    // по срезам: воксели, переставшие быть телом
+    uint64_t total_added = 0;
+    uint64_t total_removed = 0;
+    bool components_labeled = false;  // компоненты размечаются, только если тело изменилось
+    size_t components_before = 0;
+    size_t components_after = 0;
+    size_t components_matched = 0;    // пары компонент, пересекающихся только друг с другом
+    std::vector<ComponentEvent> events;
+
+    std::vector<int> changedSlices() const;
+};
+
+/**
+ * @brief Сравнивает два скана одного образца
+ *
+ * Объёмы делятся на пачки по slab_size срезов, которые сравниваются параллельно.
+ * Побайтно совпадающие строки отсеиваются memcmp, в остальных маски тела
+ * сравниваются по вокселям (цикл без ветвлений векторизуется компилятором). Если
+ * изменения есть, компоненты тела обоих сканов размечаются и сопоставляются по
+ * пересечению вокселей.
+ * @param body_value Значение тела; остальные воксели считаются порами
+ * @throws std::invalid_argument если размеры сканов различаются
+ */
+VolumeDiff diffVolumes(const std::vector<cv::Mat>& before, const std::vector<cv::Mat>& after, uchar body_value,
+                       Connectivity connectivity = Connectivity::Six, int slab_size = 16,
+                       const AnalysisControl& control = {});
+
+// Изменившиеся срезы для коллажа: не более max_slices с наибольшим числом изменений, по возрастанию z
+std::vector<int> collageSlices(const VolumeDiff& diff, int max_slices = 100);
+
+/**
+ * @brief Коллаж срезов slices, BGR
+ *
+ * Тело второго скана — серое, появившиеся воксели — зелёные, исчезнувшие — красные.
+ */
+cv::Mat renderChangeCollage(const std::vector<cv::Mat>& before, const std::vector<cv::Mat>& after,
+                            const std::vector<int>& slices, uchar body_value);
+
+// Кодирует коллаж изменений в PNG в data/output/collages/ и возвращает путь к файлу
+std::string saveChangeCollage(const cv::Mat& collage, const std::string& folder_name,
+                              const std::string& project_root);
+
+nlohmann::json volumeDiffToJson(const VolumeDiff& diff);
+
+#endif
@@ -5,6 +5,7 @@
 #include <nlohmann/json.hpp>
 #include <fstream>
 #include "connectivity_checker.h"
+#include "project_paths.h"
 
 
 
@@ -215,7 +216,7 @@ std::vector<cv::Mat> VolumeGenerator::generateCube(
     }
 
     // Путь к JSON
-    std::string json_path = "../src/reference_metrics.json";
+    std::string json_path = projectPath("src/reference_metrics.json");
 
     // Загружаем текущий JSON
     nlohmann::json j;
@@ -240,10 +241,17 @@ std::vector<cv::Mat> VolumeGenerator::generateCube(
 bool VolumeGenerator::saveSlices(const std::vector<cv::Mat>& slices, const std::string& folder) {
     fs::create_directories(folder);
 
+    // PNG кодируются параллельно: для больших случайных объёмов запись срезов — самый долгий этап
+    std::vector<uchar> saved(slices.size(), 0);
+    cv::parallel_for_(cv::Range(0, static_cast<int>(slices.size())), [&](const cv::Range& range) {
+        for (int i = range.start; i < range.end; ++i) {
+            saved[i] = cv::imwrite(folder + "/slice_" + std::to_string(i) + ".png", slices[i]);
+        }
+    });
+
     for (size_t i = 0; i < slices.size(); ++i) {
-        std::string filename = folder + "/slice_" + std::to_string(i) + ".png";
-        if (!cv::imwrite(filename, slices[i])) {
-            std::cerr << "Failed to save " << filename << std::endl;
+        if (!saved[i]) {
+            std::cerr << "Failed to save " << folder << "/slice_" << i << ".png" << std::endl;
             return false;
         }
     }
@@ -0,0 +1,153 @@
+#include "volume_pyramid.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+bool parseReductionRule(const std::string& text, ReductionRule& rule) {
+    if (text == "majority") rule = ReductionRule::Majority;
+    else if (text == "any") rule = ReductionRule::Any;
+    else if (text == "all") rule = ReductionRule::All;
+    else return false;
+    return true;
+}
+
+std::string reductionRuleName(ReductionRule rule) {
+    switch (rule) {
+        case ReductionRule::Any: return "any";
+        case ReductionRule::All: return "all";
+        default: return "majority";
+    }
+}
+
+std::vector<cv::Mat> downsampleVolume(const std::vector<cv::Mat>& volume, uchar body_value, ReductionRule rule) {
+    if (volume.empty()) return {};
+
+    const int depth = volume.size();
+    const int height = volume[0].rows;
+    const int width = volume[0].cols;
+    const int out_depth = (depth + 1) / 2;
+    const int out_height = (height + 1) / 2;
+    const int out_width = (width + 1) / 2;
+    const uchar other_value = body_value == 0 ? 255 : 0;
+
+    std::vector<cv::Mat> result(out_depth);
+
+    cv::parallel_for_(cv::Range(0, out_depth), [&](const cv::Range& range) {
+        for (int oz = range.start; oz < range.end; ++oz) {
+            cv::Mat out(out_height, out_width, CV_8UC1);
+            const int z0 = 2 * oz;
+            const int z1 = std::min(z0 + 2, depth);
+
+            for (int oy = 0; oy < out_height; ++oy) {
+                const int y0 = 2 * oy;
+                const int y1 = std::min(y0 + 2, height);
+                uchar* dst = out.ptr<uchar>(oy);
+
+                for (int ox = 0; ox < out_width; ++ox) {
+                    const int x0 = 2 * ox;
+                    const int x1 = std::min(x0 + 2, width);
+
+                    int body = 0;
+                    int total = 0;
+                    for (int z = z0; z < z1; ++z) {
+                        for (int y = y0; y < y1; ++y) {
+                            const uchar* src = volume[z].ptr<uchar>(y);
+                            for (int x = x0; x < x1; ++x) {
+                                body += src[x] == body_value;
+                                total++;
+                            }
+                        }
+                    }
+
+                    bool is_body;
+                    switch (rule) {
+                        case ReductionRule::Any: is_body = body > 0; break;
+                        case ReductionRule::All: is_body = body == total; break;
+                        default: is_body = 2 * body >= total; break;
+                    }
+                    dst[ox] = is_body ? body_value : other_value;
+                }
+            }
+            result[oz] = out;
+        }
+    });
+
+    return result;
+}
+
+std::vector<std::vector<cv::Mat>> buildVolumePyramid(const std::vector<cv::Mat>& volume, int levels,
+                                                     uchar body_value, ReductionRule rule) {
+    std::vector<std::vector<cv::Mat>> pyramid;
+    pyramid.reserve(levels);
+    const std::vector<cv::Mat>* previous = &volume;
+    for (int level = 1; level <= levels; ++level) {
+        pyramid.push_back(downsampleVolume(*previous, body_value, rule));
+        previous = &pyramid.back();
+    }
+    return pyramid;
+}
+
+std::vector<cv::Mat> upsampleVolume(const std::vector<cv::Mat>& volume, int factor) {
+    if (volume.empty() || factor <= 1) return volume;
+
+    std::vector<cv::Mat> result(volume.size() * factor);
+
+    cv::parallel_for_(cv::Range(0, static_cast<int>(volume.size())), [&](const cv::Range& range) {
+        for (int z = range.start; z < range.end; ++z) {
+            cv::Mat scaled;
+            cv::resize(volume[z], scaled, cv::Size(volume[z].cols * factor, volume[z].rows * factor), 0, 0,
+                       cv::INTER_NEAREST);
+            for (int k = 0; k < factor; ++k) {
+                result[z * factor + k] = k == 0 ? scaled : scaled.clone();
+            }
+        }
+    });
+    return result;
+}
+
+std::string pyramidLevelFolder(const std::string& folder, int level, ReductionRule rule) {
+    fs::path base(folder);
+    // Для многостраничного TIFF уровни кладутся рядом с файлом
+    if (!fs::is_directory(base)) base = base.parent_path() / (base.stem().string() + "_pyramid_" + reductionRuleName(rule));
+    else base /= "pyramid_" + reductionRuleName(rule);
+    return (base / ("level_" + std::to_string(level))).string();
+}
+
+static std::string pyramidKeyPath(const std::string& out_dir) {
+    return (fs::path(out_dir) / "key").string();
+}
+
+bool savePyramidLevel(const std::vector<cv::Mat>& level_slices, const std::string& folder, int level,
+                      ReductionRule rule, const std::string& key) {
+    std::string out_dir = pyramidLevelFolder(folder, level, rule);
+    std::error_code ec;
+    fs::remove_all(out_dir, ec);
+    if (!ec) fs::create_directories(out_dir, ec);
+    if (ec) {
+        std::cerr << "Failed to create " << out_dir << ": " << ec.message() << std::endl;
+        return false;
+    }
+
+    for (size_t i = 0; i < level_slices.size(); ++i) {
+        std::string filename = out_dir + "/slice_" + std::to_string(i) + ".png";
+        if (!cv::imwrite(filename, level_slices[i])) {
+            std::cerr << "Failed to save " << filename << std::endl;
+            return false;
+        }
+    }
+    std::ofstream out(pyramidKeyPath(out_dir));
+    out << key;
+    if (!out) {
+        std::cerr << "Failed to save " << pyramidKeyPath(out_dir) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool pyramidLevelIsCurrent(const std::string& folder, int level, ReductionRule rule, const std::string& key) {
+    std::ifstream in(pyramidKeyPath(pyramidLevelFolder(folder, level, rule)));
+    std::string stored;
+    return !key.empty() && in && std::getline(in, stored) && stored == key;
+}
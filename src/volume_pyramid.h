@@ -0,0 +1,57 @@
+#ifndef VOLUME_PYRAMID_H
+#define VOLUME_PYRAMID_H
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+// Правило свёртки блока 2×2×2 в один воксель уменьшенного уровня
+enum class ReductionRule {
+    Majority, // тело, если не менее половины вокселей блока — тело
+    Any,      // тело, если хотя бы один воксель блока — тело
+    All       // тело, только если все воксели блока — тело
+};
+
+bool parseReductionRule(const std::string& text, ReductionRule& rule);
+std::string reductionRuleName(ReductionRule rule);
+
+/**
+ * @brief Уменьшает объём вдвое по каждой оси; срезы обрабатываются параллельно
+ * @param volume Исходные срезы (нечётные размеры дополняются частичными блоками)
+ * @param body_value Значение тела; остальные воксели считаются порами
+ * @return Срезы уровня, тело записано как body_value, поры — как противоположное значение
+ */
+std::vector<cv::Mat> downsampleVolume(const std::vector<cv::Mat>& volume, uchar body_value, ReductionRule rule);
+
+/**
+ * @brief Строит пирамиду уровней 1..levels (масштабы 2, 4, 8, ...)
+ * @return pyramid[0] — уровень 1 (2x), pyramid[levels - 1] — самый грубый
+ */
+std::vector<std::vector<cv::Mat>> buildVolumePyramid(const std::vector<cv::Mat>& volume, int levels,
+                                                     uchar body_value, ReductionRule rule);
+
+/**
+ * @brief Увеличивает объём в factor раз по каждой оси повторением вокселей
+ *
+ * Связность тела, число пор и пористость при таком увеличении сохраняются,
+ * поэтому увеличенные объёмы проверяются по тем же эталонным метрикам.
+ */
+std::vector<cv::Mat> upsampleVolume(const std::vector<cv::Mat>& volume, int factor);
+
+// Папка уровня пирамиды: внутри папки срезов или, для многостраничного TIFF, рядом с файлом
+std::string pyramidLevelFolder(const std::string& folder, int level, ReductionRule rule);
+
+/**
+ * @brief Сохраняет уровень пирамиды и ключ, по которому он был построен
+ *
+ * Прежнее содержимое папки уровня удаляется; ключ записывается последним, так что
+ * прерванное сохранение не выглядит действительным.
+ * @return false при ошибке (сообщение выводится в std::cerr)
+ */
+bool savePyramidLevel(const std::vector<cv::Mat>& level_slices, const std::string& folder, int level,
+                      ReductionRule rule, const std::string& key);
+
+// true, если уровень сохранён с тем же непустым ключом (срезы и параметры не изменились)
+bool pyramidLevelIsCurrent(const std::string& folder, int level, ReductionRule rule, const std::string& key);
+
+#endif
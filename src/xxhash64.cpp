@@ -0,0 +1,142 @@
+#include "xxhash64.h"
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+static constexpr uint64_t kPrime1 = 11400714785074694791ULL;
+static constexpr uint64_t kPrime2 = 14029467366897019727ULL;
+static constexpr uint64_t kPrime3 = 1609587929392839161ULL;
+static constexpr uint64_t kPrime4 = 9650029242287828579ULL;
+static constexpr uint64_t kPrime5 = 2870177450012600261ULL;
+
+static inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// Чтение little-endian слов независимо от выравнивания
+static inline uint64_t read64(const unsigned char* p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; --i) v = (v << 8) | p[i];
+    return v;
+}
+
+static inline uint32_t read32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static inline uint64_t round(uint64_t acc, uint64_t input) {
+    acc += input * kPrime2;
+    acc = rotl(acc, 31);
+    return acc * kPrime1;
+}
+
+static inline uint64_t mergeRound(uint64_t acc, uint64_t value) {
+    acc ^= round(0, value);
+    return acc * kPrime1 + kPrime4;
+}
+
+XXHash64::XXHash64(uint64_t seed) : seed_(seed) {
+    acc_[0] = seed + kPrime1 + kPrime2;
+    acc_[1] = seed + kPrime2;
+    acc_[2] = seed;
+    acc_[3] = seed - kPrime1;
+}
+
+void XXHash64::update(const void* data, size_t length) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    total_length_ += length;
+
+    if (buffered_ + length < 32) {
+        std::memcpy(buffer_ + buffered_, p, length);
+        buffered_ += length;
+        return;
+    }
+
+    if (buffered_ > 0) {
+        size_t fill = 32 - buffered_;
+        std::memcpy(buffer_ + buffered_, p, fill);
+        for (int i = 0; i < 4; ++i) acc_[i] = round(acc_[i], read64(buffer_ + 8 * i));
+        p += fill;
+        length -= fill;
+        buffered_ = 0;
+    }
+
+    while (length >= 32) {
+        for (int i = 0; i < 4; ++i) acc_[i] = round(acc_[i], read64(p + 8 * i));
+        p += 32;
+        length -= 32;
+    }
+
+    std::memcpy(buffer_, p, length);
+    buffered_ = length;
+}
+
+uint64_t XXHash64::digest() const {
+    uint64_t h;
+    if (total_length_ >= 32) {
+        h = rotl(acc_[0], 1) + rotl(acc_[1], 7) + rotl(acc_[2], 12) + rotl(acc_[3], 18);
+        for (int i = 0; i < 4; ++i) h = mergeRound(h, acc_[i]);
+    } else {
+        h = seed_ + kPrime5;
+    }
+    h += total_length_;
+
+    const unsigned char* p = buffer_;
+    size_t remaining = buffered_;
+    while (remaining >= 8) {
+        h ^= round(0, read64(p));
+        h = rotl(h, 27) * kPrime1 + kPrime4;
+        p += 8;
+        remaining -= 8;
+    }
+    if (remaining >= 4) {
+        h ^= static_cast<uint64_t>(read32(p)) * kPrime1;
+        h = rotl(h, 23) * kPrime2 + kPrime3;
+        p += 4;
+        remaining -= 4;
+    }
+    while (remaining > 0) {
+        h ^= (*p) * kPrime5;
+        h = rotl(h, 11) * kPrime1;
+        p++;
+        remaining--;
+    }
+
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t XXHash64::hash(const void* data, size_t length, uint64_t seed) {
+    XXHash64 state(seed);
+    state.update(data, length);
+    return state.digest();
+}
+
+bool hashFile(const std::string& path, uint64_t& hash) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+
+    XXHash64 state;
+    std::vector<char> chunk(1 << 16);
+    while (in) {
+        in.read(chunk.data(), chunk.size());
+        state.update(chunk.data(), static_cast<size_t>(in.gcount()));
+    }
+    hash = state.digest();
+    return true;
+}
+
+std::string hashToHex(uint64_t hash) {
+    static const char digits[] = "0123456789abcdef";
+    std::string hex(16, '0');
+    for (int i = 15; i >= 0; --i) {
+        hex[i] = digits[hash & 0xF];
+        hash >>= 4;
+    }
+    return hex;
+}
@@ -0,0 +1,31 @@
+#ifndef XXHASH64_H
+#define XXHASH64_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Потоковая реализация хеша XXH64 (совместима с эталонной xxHash)
+class XXHash64 {
+public:
+    explicit XXHash64(uint64_t seed = 0);
+
+    void update(const void* data, size_t length);
+    uint64_t digest() const;
+
+    static uint64_t hash(const void* data, size_t length, uint64_t seed = 0);
+
+private:
+    uint64_t acc_[4];
+    uint64_t seed_;
+    uint64_t total_length_ = 0;
+    unsigned char buffer_[32];
+    size_t buffered_ = 0;
+};
+
+// Хеш содержимого файла; false, если файл не удалось прочитать
+bool hashFile(const std::string& path, uint64_t& hash);
+
+std::string hashToHex(uint64_t hash);
+
+#endif